@@ -0,0 +1,405 @@
+// bench_main.cpp
+// omniforge_bench: times the CPU pipeline per mode, stage, input size and
+// thread count, writes the results as JSON and optionally compares them
+// against a stored baseline. Exits with 1 if anything regressed past the
+// tolerance, so it can gate CI. The quantized neural cases also report
+// their PSNR against the FP32 model's output.
+
+#include "engines/neural_engine.h"
+#include "pipeline/fsr_cpu.h"
+#include "pipeline/tiling.h"
+#include "pipeline/upscaler.h"
+#include "utils/cpu_features.h"
+#include "utils/frame_pool.h"
+#include "utils/thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Resolution {
+  const char *name;
+  int width, height;
+};
+
+constexpr Resolution kResolutions[] = {
+    {"540p", 960, 540},
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"1440p", 2560, 1440},
+};
+
+// Everything --cases accepts, in the default order.
+constexpr const char *kCases[] = {"easu",   "rcas",        "fsr",
+                                  "neural", "hybrid",      "neural-fp16",
+                                  "neural-int8"};
+
+struct Options {
+  std::vector<std::string> resolutions;
+  std::vector<unsigned> threads;
+  std::vector<std::string> cases{std::begin(kCases), std::end(kCases)};
+  double minMs = 500.0; // per measurement
+  int minIterations = 5;
+  std::string out;
+  std::string baseline;
+  double tolerance = 0.10;
+};
+
+struct Result {
+  std::string name; // case/resolution/threads, the baseline key
+  std::string kind;
+  std::string resolution;
+  unsigned threads = 0;
+  int iterations = 0;
+  double nsPerFrame = 0.0; // median
+  double nsMin = 0.0;
+  double mpixPerSec = 0.0;  // output megapixels per second
+  double bytesPerPixel = 0.0; // modelled DRAM traffic per output pixel
+  double psnrDb = 0.0;        // vs. the FP32 model; 0 = not measured
+};
+
+std::vector<std::string> split(const std::string &s) {
+  std::vector<std::string> parts;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    if (!item.empty())
+      parts.push_back(item);
+  return parts;
+}
+
+void usage() {
+  std::cerr
+      << "usage: omniforge_bench [options]\n"
+         "  --res LIST        540p,720p,1080p,1440p (default all)\n"
+         "  --threads LIST    thread counts (default 1, half and all cores)\n"
+         "  --cases LIST      easu,rcas,fsr,neural,hybrid,neural-fp16,\n"
+         "                    neural-int8 (default all)\n"
+         "  --time-ms N       minimum time per measurement (default 500)\n"
+         "  --out FILE        write JSON results to FILE (default stdout)\n"
+         "  --baseline FILE   compare against an earlier --out file\n"
+         "  --tolerance F     allowed slowdown vs. baseline (default 0.10)\n";
+}
+
+bool parseArgs(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc)
+      return false;
+    const std::string value = argv[++i];
+    if (arg == "--res") {
+      opt.resolutions = split(value);
+    } else if (arg == "--threads") {
+      opt.threads.clear();
+      for (const std::string &t : split(value))
+        opt.threads.push_back(static_cast<unsigned>(std::atoi(t.c_str())));
+    } else if (arg == "--cases") {
+      opt.cases = split(value);
+      // Anything else would be timed as HYBRID under the wrong name.
+      for (const std::string &kind : opt.cases) {
+        if (std::find(std::begin(kCases), std::end(kCases), kind) ==
+            std::end(kCases)) {
+          std::cerr << "unknown case: " << kind << "\n";
+          return false;
+        }
+      }
+    } else if (arg == "--time-ms") {
+      opt.minMs = std::atof(value.c_str());
+    } else if (arg == "--out") {
+      opt.out = value;
+    } else if (arg == "--baseline") {
+      opt.baseline = value;
+    } else if (arg == "--tolerance") {
+      opt.tolerance = std::atof(value.c_str());
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Smooth gradients plus hard edges, so EASU's edge paths get exercised.
+void fillTestPattern(const FrameView &f) {
+  for (int y = 0; y < f.height; ++y) {
+    uint32_t *row = f.row(y);
+    for (int x = 0; x < f.width; ++x) {
+      const uint32_t r = (x * 255) / f.width;
+      const uint32_t g = (y * 255) / f.height;
+      const uint32_t b = ((x / 7) ^ (y / 5)) & 1 ? 230 : 20;
+      row[x] = r | g << 8 | b << 16 | 0xff000000u;
+    }
+  }
+}
+
+FrameView viewOf(const FramePool::Handle &h) {
+  return FrameView{h.data(), h.shape().width, h.shape().height, h.stride()};
+}
+
+// PSNR of the RGB channels of `a` against `b`, capped at 99 dB.
+double psnr(const FrameView &a, const FrameView &b) {
+  double sse = 0.0;
+  for (int y = 0; y < a.height; ++y) {
+    const uint8_t *pa = reinterpret_cast<const uint8_t *>(a.row(y));
+    const uint8_t *pb = reinterpret_cast<const uint8_t *>(b.row(y));
+    for (int x = 0; x < a.width * 4; ++x) {
+      if ((x & 3) == 3)
+        continue;
+      const double d = double(pa[x]) - pb[x];
+      sse += d * d;
+    }
+  }
+  const double mse = sse / (double(a.width) * a.height * 3);
+  return mse > 0.0 ? std::min(99.0, 10.0 * std::log10(255.0 * 255.0 / mse))
+                   : 99.0;
+}
+
+constexpr int kMaxIterations = 1000;
+
+// Runs `fn` until both the time and iteration minimums are met (or for
+// kMaxIterations); returns the per-iteration times in ns.
+template <typename Fn>
+std::vector<double> measure(const Options &opt, Fn &&fn) {
+  using Clock = std::chrono::steady_clock;
+  fn(); // warm-up: first-touch, context setup
+  std::vector<double> samples;
+  double total = 0.0;
+  while ((total < opt.minMs * 1e6 &&
+          static_cast<int>(samples.size()) < kMaxIterations) ||
+         static_cast<int>(samples.size()) < opt.minIterations) {
+    const Clock::time_point t0 = Clock::now();
+    fn();
+    const double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    samples.push_back(ns);
+    total += ns;
+  }
+  return samples;
+}
+
+// Compulsory memory traffic per output pixel for a 2x upscale of RGBA8:
+// the input is a quarter of the output, and every pass reads and writes
+// its whole frame once.
+double modelledBytesPerPixel(const std::string &kind) {
+  const double in = 4.0 / 4.0, out = 4.0;
+  if (kind == "easu" || kind == "fsr" || kind.compare(0, 6, "neural") == 0)
+    return in + out;
+  if (kind == "rcas")
+    return out + out;
+  if (kind == "hybrid")
+    return 2.0 * (in + out);
+  return 0.0;
+}
+
+// False if the case cannot run here (no ncnn or no such model, or the
+// frame path fails).
+bool runCase(const Options &opt, const std::string &kind,
+             const Resolution &res, unsigned threads, Result &r) {
+  ThreadPool pool(threads);
+  FramePool &buffers = FramePool::shared();
+  FramePool::Handle in = buffers.acquire({res.width, res.height, 4, 0});
+  FramePool::Handle out =
+      buffers.acquire({res.width * 2, res.height * 2, 4, 0});
+  FramePool::Handle mid =
+      buffers.acquire({res.width * 2, res.height * 2, 4, 0});
+  const FrameView input = viewOf(in), output = viewOf(out),
+                  upscaled = viewOf(mid);
+  fillTestPattern(input);
+
+  FsrConstants consts;
+  setupFSR(consts, input.width, input.height, output.width, output.height);
+  const TileGrid grid = makeTileGrid(output.width, output.height, input.width,
+                                     input.height, 0, pool.concurrency());
+  UpscaleContext ctx(&pool);
+  // The pattern never changes, so dirty tracking would skip every frame
+  // after the first and time nothing.
+  ctx.setDirtyTracking(false);
+
+  std::vector<double> samples;
+  NeuralPrecision precision = NeuralPrecision::FP32;
+  double quality = 0.0;
+  if (kind.compare(0, 7, "neural-") == 0 &&
+      parsePrecision(kind.substr(7), precision)) {
+    // The FP32 output is the quality reference.
+    if (!runNcnnInferenceCpu(input, upscaled, pool, NeuralPrecision::FP32) ||
+        !runNcnnInferenceCpu(input, output, pool, precision))
+      return false;
+    quality = psnr(output, upscaled);
+    samples = measure(
+        opt, [&] { runNcnnInferenceCpu(input, output, pool, precision); });
+  } else if (kind == "easu") {
+    samples = measure(opt, [&] {
+      pool.parallelFor(grid.count(), [&](size_t i) {
+        const Tile t = grid.tile(static_cast<int>(i));
+        fsrEasu(consts, input, output, t.x0, t.y0, t.x1, t.y1);
+      });
+    });
+  } else if (kind == "rcas") {
+    fsrEasu(consts, input, upscaled);
+    samples = measure(opt, [&] {
+      pool.parallelFor(grid.count(), [&](size_t i) {
+        const Tile t = grid.tile(static_cast<int>(i));
+        fsrRcas(consts, upscaled, output, t.x0, t.y0, t.x1, t.y1);
+      });
+    });
+  } else {
+    const UpscaleMode mode = kind == "fsr"      ? UpscaleMode::FSR_ONLY
+                             : kind == "neural" ? UpscaleMode::NEURAL_ONLY
+                                                : UpscaleMode::HYBRID;
+    // Without a model NEURAL_ONLY fails at once and HYBRID quietly runs
+    // as EASU; neither would time what the case is named after.
+    if (mode != UpscaleMode::FSR_ONLY && !waitNeuralReady(NeuralBackend::Cpu))
+      return false;
+    if (!processFrame(ctx, input, output, mode))
+      return false;
+    samples = measure(opt, [&] { processFrame(ctx, input, output, mode); });
+  }
+
+  r = Result();
+  r.kind = kind;
+  r.resolution = res.name;
+  r.threads = pool.concurrency();
+  r.name = kind + "/" + res.name + "/t" + std::to_string(r.threads);
+  r.iterations = static_cast<int>(samples.size());
+  std::sort(samples.begin(), samples.end());
+  r.nsPerFrame = samples[samples.size() / 2];
+  r.nsMin = samples.front();
+  r.mpixPerSec = double(output.width) * output.height / r.nsPerFrame * 1e3;
+  r.bytesPerPixel = modelledBytesPerPixel(kind);
+  r.psnrDb = quality;
+  return true;
+}
+
+void writeJson(std::ostream &os, const std::vector<Result> &results) {
+  const CpuFeatures &cpu = cpuFeatures();
+  os << "{\n  \"cpu\": {\"logicalCores\": " << cpu.logicalCores
+     << ", \"avx2\": " << (cpu.avx2 ? "true" : "false")
+     << ", \"sse41\": " << (cpu.sse41 ? "true" : "false")
+     << ", \"l2Bytes\": " << cpu.l2Bytes << "},\n  \"results\": [\n";
+  // One result per line; loadBaseline() relies on that.
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    char quality[32] = "";
+    if (r.psnrDb > 0.0)
+      std::snprintf(quality, sizeof(quality), ", \"psnrDb\": %.2f", r.psnrDb);
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "    {\"name\": \"%s\", \"case\": \"%s\", \"resolution\": "
+                  "\"%s\", \"threads\": %u, \"iterations\": %d, "
+                  "\"nsPerFrame\": %.0f, \"nsMin\": %.0f, \"mpixPerSec\": "
+                  "%.2f, \"bytesPerPixel\": %.2f%s}%s\n",
+                  r.name.c_str(), r.kind.c_str(), r.resolution.c_str(),
+                  r.threads, r.iterations, r.nsPerFrame, r.nsMin,
+                  r.mpixPerSec, r.bytesPerPixel, quality,
+                  i + 1 < results.size() ? "," : "");
+    os << line;
+  }
+  os << "  ]\n}\n";
+}
+
+// Reads name -> nsPerFrame from a file written by writeJson().
+std::map<std::string, double> loadBaseline(const std::string &path) {
+  std::map<std::string, double> values;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    const size_t name = line.find("\"name\": \"");
+    const size_t ns = line.find("\"nsPerFrame\": ");
+    if (name == std::string::npos || ns == std::string::npos)
+      continue;
+    const size_t begin = name + 9;
+    const size_t end = line.find('"', begin);
+    values[line.substr(begin, end - begin)] =
+        std::atof(line.c_str() + ns + 14);
+  }
+  return values;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    usage();
+    return 2;
+  }
+  if (opt.resolutions.empty())
+    for (const Resolution &r : kResolutions)
+      opt.resolutions.push_back(r.name);
+  if (opt.threads.empty()) {
+    const unsigned all = cpuFeatures().logicalCores;
+    opt.threads = {1u, std::max(1u, all / 2), all};
+  }
+  std::sort(opt.threads.begin(), opt.threads.end());
+  opt.threads.erase(std::unique(opt.threads.begin(), opt.threads.end()),
+                    opt.threads.end());
+
+  std::vector<Result> results;
+  for (const std::string &resName : opt.resolutions) {
+    const Resolution *res = nullptr;
+    for (const Resolution &r : kResolutions)
+      if (resName == r.name)
+        res = &r;
+    if (!res) {
+      std::cerr << "omniforge_bench: unknown resolution " << resName << "\n";
+      return 2;
+    }
+    for (unsigned threads : opt.threads) {
+      for (const std::string &kind : opt.cases) {
+        Result r;
+        if (!runCase(opt, kind, *res, threads, r)) {
+          std::cerr << kind << "/" << res->name << ": skipped (unavailable)\n";
+          continue;
+        }
+        std::cerr << r.name << ": " << r.nsPerFrame / 1e6 << " ms/frame, "
+                  << r.mpixPerSec << " MPix/s";
+        if (r.psnrDb > 0.0)
+          std::cerr << ", " << r.psnrDb << " dB";
+        std::cerr << "\n";
+        results.push_back(r);
+      }
+    }
+  }
+
+  if (opt.out.empty()) {
+    writeJson(std::cout, results);
+  } else {
+    std::ofstream os(opt.out);
+    writeJson(os, results);
+  }
+
+  if (opt.baseline.empty())
+    return 0;
+  const std::map<std::string, double> baseline = loadBaseline(opt.baseline);
+  if (baseline.empty()) {
+    std::cerr << "omniforge_bench: no results in " << opt.baseline << "\n";
+    return 2;
+  }
+  int regressions = 0;
+  for (const Result &r : results) {
+    const auto it = baseline.find(r.name);
+    if (it == baseline.end() || it->second <= 0.0)
+      continue;
+    const double change = r.nsPerFrame / it->second - 1.0;
+    if (change > opt.tolerance) {
+      ++regressions;
+      std::cerr << "REGRESSION " << r.name << ": " << it->second / 1e6
+                << " -> " << r.nsPerFrame / 1e6 << " ms (+"
+                << change * 100.0 << "%)\n";
+    }
+  }
+  std::cerr << "omniforge_bench: " << regressions << " regression(s) vs. "
+            << opt.baseline << "\n";
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,302 @@
+// batch_main.cpp
+// omniforge_batch: streams Y4M or raw RGBA8 video through processFrame so
+// it can sit between two ffmpeg processes, e.g.
+//
+//   ffmpeg -i in.mkv -f yuv4mpegpipe - | omniforge_batch |
+//     ffmpeg -f yuv4mpegpipe -i - out.mkv
+//
+// Decode, upscale and encode run on their own threads joined by bounded
+// queues, so memory stays constant however long the input is: at most
+// `--queue` frames (exactly that many, not rounded up) wait between two
+// stages and every buffer is recycled through the frame pool.
+
+#include "../pipeline/upscaler.h"
+#include "../utils/frame_pool.h"
+#include "../utils/latency_queue.h"
+#include "../utils/metrics.h"
+#include "../utils/thread_pool.h"
+#include "../utils/trace.h"
+#include "video_io.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+struct Options {
+  std::string input = "-";
+  std::string output = "-";
+  int rawWidth = 0; // raw RGBA8 input when set
+  int rawHeight = 0;
+  UpscaleMode mode = UpscaleMode::FSR_ONLY;
+  double scale = 2.0;
+  size_t queue = 3;
+  std::string trace; // Chrome trace JSON written at exit when set
+};
+
+// One frame moving down the pipeline; `last` marks end of stream.
+struct Job {
+  FramePool::Handle frame;
+  bool last = false;
+};
+
+constexpr size_t kIoBuffer = size_t(1) << 20;
+
+void usage() {
+  std::cerr
+      << "usage: omniforge_batch [options]\n"
+         "  -i, --input PATH    Y4M (or raw with --raw) input, '-' = stdin\n"
+         "  -o, --output PATH   output in the input's format, '-' = stdout\n"
+         "  --raw WxH           input is packed RGBA8 frames of this size\n"
+         "  --mode MODE         fsr (default), neural or hybrid\n"
+         "  --scale S           output size over input size (default 2;\n"
+         "                      neural needs 2, hybrid runs as fsr\n"
+         "                      at other scales)\n"
+         "  --queue N           frames buffered between stages (default 3)\n"
+         "  --trace PATH        write a Chrome/Perfetto trace of the run\n";
+}
+
+bool parseArgs(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if ((arg == "-i" || arg == "--input") && hasValue) {
+      opt.input = argv[++i];
+    } else if ((arg == "-o" || arg == "--output") && hasValue) {
+      opt.output = argv[++i];
+    } else if (arg == "--raw" && hasValue) {
+      if (std::sscanf(argv[++i], "%dx%d", &opt.rawWidth, &opt.rawHeight) != 2 ||
+          opt.rawWidth <= 0 || opt.rawHeight <= 0)
+        return false;
+    } else if (arg == "--mode" && hasValue) {
+      const std::string m = argv[++i];
+      if (m == "fsr")
+        opt.mode = UpscaleMode::FSR_ONLY;
+      else if (m == "neural")
+        opt.mode = UpscaleMode::NEURAL_ONLY;
+      else if (m == "hybrid")
+        opt.mode = UpscaleMode::HYBRID;
+      else
+        return false;
+    } else if (arg == "--scale" && hasValue) {
+      opt.scale = std::atof(argv[++i]);
+      if (!(opt.scale >= 1.0))
+        return false;
+    } else if (arg == "--queue" && hasValue) {
+      const int n = std::atoi(argv[++i]);
+      if (n < 1)
+        return false;
+      opt.queue = static_cast<size_t>(n);
+    } else if (arg == "--trace" && hasValue) {
+      opt.trace = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::FILE *openStream(const std::string &path, bool write) {
+  if (path == "-") {
+    std::FILE *f = write ? stdout : stdin;
+#ifdef _WIN32
+    _setmode(_fileno(f), _O_BINARY);
+#endif
+    return f;
+  }
+  return std::fopen(path.c_str(), write ? "wb" : "rb");
+}
+
+FrameView viewOf(const FramePool::Handle &h) {
+  return FrameView{h.data(), h.shape().width, h.shape().height, h.stride()};
+}
+
+void printStats(size_t frames, double seconds) {
+  std::cerr << "omniforge_batch: " << frames << " frames in " << seconds
+            << " s (" << (seconds > 0.0 ? frames / seconds : 0.0)
+            << " fps)\n";
+  for (int s = 0; s < static_cast<int>(Stage::Count); ++s) {
+    const LatencyStats st = Metrics::shared().stageStats(static_cast<Stage>(s));
+    if (st.count == 0)
+      continue;
+    std::cerr << "  " << stageName(static_cast<Stage>(s)) << ": mean "
+              << st.meanMs << " ms, p95 " << st.p95Ms << " ms, max "
+              << st.maxMs << " ms\n";
+  }
+  const TileCounts tiles = Metrics::shared().tileCounts();
+  if (tiles.total > 0)
+    std::cerr << "  unchanged tiles skipped: " << tiles.skipped << " of "
+              << tiles.total << "\n";
+  if (tiles.neural > 0)
+    std::cerr << "  hybrid tiles sent to the network: " << tiles.neural
+              << " of " << tiles.total << "\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    usage();
+    return 2;
+  }
+  if (opt.mode == UpscaleMode::NEURAL_ONLY && opt.scale != 2.0) {
+    std::cerr << "omniforge_batch: the neural mode only upscales by 2"
+              << std::endl;
+    return 2;
+  }
+  if (!opt.trace.empty())
+    Tracer::shared().setEnabled(true);
+
+  std::FILE *in = openStream(opt.input, false);
+  std::FILE *out = openStream(opt.output, true);
+  if (!in || !out) {
+    std::cerr << "omniforge_batch: cannot open "
+              << (!in ? opt.input : opt.output) << std::endl;
+    return 1;
+  }
+  std::setvbuf(in, nullptr, _IOFBF, kIoBuffer);
+  std::setvbuf(out, nullptr, _IOFBF, kIoBuffer);
+
+  StreamInfo inInfo;
+  if (opt.rawWidth > 0) {
+    inInfo.format = StreamFormat::RawRGBA;
+    inInfo.width = opt.rawWidth;
+    inInfo.height = opt.rawHeight;
+  } else {
+    std::string error;
+    if (!readY4mHeader(in, inInfo, error)) {
+      std::cerr << "omniforge_batch: " << error << std::endl;
+      return 1;
+    }
+  }
+  StreamInfo outInfo = inInfo;
+  outInfo.width = static_cast<int>(std::lround(inInfo.width * opt.scale));
+  outInfo.height = static_cast<int>(std::lround(inInfo.height * opt.scale));
+  if (outInfo.format == StreamFormat::Y4M && !writeY4mHeader(out, outInfo)) {
+    std::cerr << "omniforge_batch: write failed" << std::endl;
+    return 1;
+  }
+
+  FramePool &buffers = FramePool::shared();
+  ThreadPool &pool = ThreadPool::shared();
+  const FramePool::Shape inShape{inInfo.width, inInfo.height, 4, 0};
+  const FramePool::Shape outShape{outInfo.width, outInfo.height, 4, 0};
+
+  LatencyQueue<Job> decoded(opt.queue);
+  LatencyQueue<Job> upscaled(opt.queue);
+  std::atomic<bool> failed{false};
+  size_t frames = 0;
+  const auto start = std::chrono::steady_clock::now();
+
+  // Upscale stage. processFrame fans each frame out over the shared pool.
+  // Stages keep draining until the end marker even after a failure, so
+  // nobody stays blocked on a full queue.
+  std::thread upscaler([&] {
+    Tracer::setThreadName("upscale");
+    UpscaleContext ctx;
+    for (;;) {
+      Job job = decoded.pop();
+      if (job.last) {
+        upscaled.push(std::move(job));
+        return;
+      }
+      if (failed)
+        continue;
+      Job result;
+      result.frame = buffers.acquire(outShape);
+      if (!result.frame ||
+          !processFrame(ctx, viewOf(job.frame), viewOf(result.frame),
+                        opt.mode)) {
+        std::cerr << "omniforge_batch: upscale failed" << std::endl;
+        failed = true;
+        continue;
+      }
+      job.frame.reset(); // back to the pool before the next decode needs it
+      upscaled.push(std::move(result));
+    }
+  });
+
+  // Encode stage.
+  std::thread encoder([&] {
+    Tracer::setThreadName("encode");
+    FramePool::Handle payload;
+    if (outInfo.format == StreamFormat::Y4M) {
+      payload = buffers.acquireBytes(payloadBytes(outInfo));
+      if (!payload) {
+        std::cerr << "omniforge_batch: out of memory" << std::endl;
+        failed = true;
+      }
+    }
+    for (;;) {
+      Job job = upscaled.pop();
+      if (job.last)
+        return;
+      if (failed)
+        continue;
+      OMNIFORGE_TRACE_SCOPE("encode");
+      StageTimer timer(Metrics::shared(), Stage::Present);
+      if (!writeFrame(out, outInfo, payload.data(), viewOf(job.frame), pool)) {
+        std::cerr << "omniforge_batch: write failed" << std::endl;
+        failed = true;
+      } else {
+        ++frames;
+      }
+    }
+  });
+
+  // Decode stage on this thread.
+  {
+    Tracer::setThreadName("decode");
+    FramePool::Handle payload;
+    if (inInfo.format == StreamFormat::Y4M) {
+      payload = buffers.acquireBytes(payloadBytes(inInfo));
+      if (!payload) {
+        std::cerr << "omniforge_batch: out of memory" << std::endl;
+        failed = true;
+      }
+    }
+    while (!failed) {
+      Job job;
+      job.frame = buffers.acquire(inShape);
+      if (!job.frame) {
+        std::cerr << "omniforge_batch: out of memory" << std::endl;
+        failed = true;
+        break;
+      }
+      {
+        OMNIFORGE_TRACE_SCOPE("decode");
+        StageTimer timer(Metrics::shared(), Stage::Capture);
+        if (!readFrame(in, inInfo, payload.data(), viewOf(job.frame), pool))
+          break;
+      }
+      decoded.push(std::move(job));
+    }
+    decoded.push(Job{FramePool::Handle(), true});
+  }
+
+  upscaler.join();
+  encoder.join();
+  std::fflush(out);
+
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  printStats(frames, seconds);
+  if (!opt.trace.empty()) {
+    Tracer::shared().flushAsync(opt.trace);
+    Tracer::shared().waitFlushed();
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+// calibrate_main.cpp
+// omniforge_calibrate: builds the INT8 calibration table for the cunet
+// model from a directory of sample frames (Y4M files), e.g.
+//
+//   omniforge_calibrate --frames samples/ -o cunet-noise0.table
+//   ncnn2int8 cunet-noise0.param cunet-noise0.bin
+//     cunet-noise0-int8.param cunet-noise0-int8.bin cunet-noise0.table
+//   echo int8 > cunet-noise0.precision
+//
+// Frames are cut into tiles and prepared exactly as runNcnnInferenceCpu
+// does. The FP32 model runs over every tile twice: once for each
+// convolution input's range, then to histogram it for the KL threshold.
+
+#include "../engines/int8_calibration.h"
+#include "../engines/neural_engine.h"
+#include "../utils/frame_pool.h"
+#include "../utils/thread_pool.h"
+#include "video_io.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef OMNIFORGE_HAVE_NCNN
+#include <ncnn/layer.h>
+#include <ncnn/layer/convolution.h>
+#include <ncnn/net.h>
+#endif
+
+namespace {
+
+struct Options {
+  std::string frames;
+  std::string output = "-";
+  int maxFrames = 200;
+  int tilesPerFrame = 4;
+};
+
+constexpr int kTile = 128; // input pixels, before prepadding
+
+void usage() {
+  std::cerr
+      << "usage: omniforge_calibrate --frames DIR [options]\n"
+         "  --frames DIR        directory of .y4m sample clips\n"
+         "  -o, --output PATH   calibration table, '-' = stdout\n"
+         "  --max-frames N      frames to sample in total (default 200)\n"
+         "  --tiles N           128x128 tiles per frame (default 4)\n"
+         "The model is read from OMNIFORGE_MODEL_DIR like at runtime.\n";
+}
+
+bool parseArgs(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--frames" && hasValue) {
+      opt.frames = argv[++i];
+    } else if ((arg == "-o" || arg == "--output") && hasValue) {
+      opt.output = argv[++i];
+    } else if (arg == "--max-frames" && hasValue) {
+      opt.maxFrames = std::atoi(argv[++i]);
+    } else if (arg == "--tiles" && hasValue) {
+      opt.tilesPerFrame = std::atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return !opt.frames.empty() && opt.maxFrames > 0 && opt.tilesPerFrame > 0;
+}
+
+FrameView viewOf(const FramePool::Handle &h) {
+  return FrameView{h.data(), h.shape().width, h.shape().height, h.stride()};
+}
+
+// Calls `fn` for up to `tilesPerFrame` evenly spread tiles of each of the
+// first `maxFrames` frames found in the directory. Returns the number of
+// frames used.
+int forEachTile(const Options &opt,
+                const std::function<void(const FrameView &)> &fn) {
+  std::vector<std::filesystem::path> clips;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(opt.frames, ec))
+    if (entry.path().extension() == ".y4m")
+      clips.push_back(entry.path());
+  std::sort(clips.begin(), clips.end());
+
+  ThreadPool &pool = ThreadPool::shared();
+  int frames = 0;
+  for (const auto &clip : clips) {
+    std::FILE *in = std::fopen(clip.string().c_str(), "rb");
+    if (!in)
+      continue;
+    StreamInfo info;
+    std::string error;
+    if (!readY4mHeader(in, info, error)) {
+      std::cerr << "omniforge_calibrate: " << clip << ": " << error << "\n";
+      std::fclose(in);
+      continue;
+    }
+    FramePool &buffers = FramePool::shared();
+    FramePool::Handle payload = buffers.acquireBytes(payloadBytes(info));
+    FramePool::Handle frame = buffers.acquire({info.width, info.height, 4, 0});
+    const FrameView view = viewOf(frame);
+    while (frames < opt.maxFrames &&
+           readFrame(in, info, payload.data(), view, pool)) {
+      const int tw = std::min(kTile, view.width);
+      const int th = std::min(kTile, view.height);
+      const int steps = std::max(1, opt.tilesPerFrame - 1);
+      for (int t = 0; t < opt.tilesPerFrame; ++t) {
+        // x advances evenly, y is scrambled, so the tiles do not all sit
+        // on one diagonal.
+        const int x = (view.width - tw) * t / steps;
+        const int y = (view.height - th) * ((t * 3) % (steps + 1)) / steps;
+        fn(FrameView{view.data + size_t(y) * view.stride + size_t(x) * 4, tw,
+                     th, view.stride});
+      }
+      ++frames;
+    }
+    std::fclose(in);
+    if (frames >= opt.maxFrames)
+      break;
+  }
+  return frames;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    usage();
+    return 2;
+  }
+
+#ifdef OMNIFORGE_HAVE_NCNN
+  const std::string base = neuralModelBase();
+  ncnn::Net net;
+  net.opt.use_vulkan_compute = false;
+  net.opt.num_threads = static_cast<int>(ThreadPool::shared().concurrency());
+  // Keep the weights (lightmode releases them once pipelines are built)
+  // and calibrate the plain FP32 graph.
+  net.opt.lightmode = false;
+  net.opt.use_fp16_storage = false;
+  net.opt.use_fp16_packed = false;
+  net.opt.use_fp16_arithmetic = false;
+  net.opt.use_bf16_storage = false;
+  net.opt.use_int8_inference = false;
+  if (net.load_param((base + ".param").c_str()) != 0 ||
+      net.load_model((base + ".bin").c_str()) != 0) {
+    std::cerr << "omniforge_calibrate: cannot load " << base << std::endl;
+    return 1;
+  }
+
+  // The layers ncnn2int8 quantizes, and the blobs feeding them.
+  struct Target {
+    const ncnn::Convolution *layer;
+    std::string blob;
+    ActivationHistogram histogram;
+  };
+  std::vector<Target> targets;
+  for (const ncnn::Layer *layer : net.layers()) {
+    if (layer->type != "Convolution" || layer->bottoms.empty())
+      continue;
+    targets.push_back({static_cast<const ncnn::Convolution *>(layer),
+                       net.blobs()[layer->bottoms[0]].name, {}});
+  }
+  if (targets.empty()) {
+    std::cerr << "omniforge_calibrate: no convolution layers in " << base
+              << std::endl;
+    return 1;
+  }
+
+  for (int pass = 0; pass < 2; ++pass) {
+    const int frames = forEachTile(opt, [&](const FrameView &tile) {
+      ncnn::Mat input;
+      makeCunetInput(tile, input, net.opt);
+      ncnn::Extractor ex = net.create_extractor();
+      ex.set_light_mode(false);
+      ex.input("Input1", input);
+      for (Target &t : targets) {
+        ncnn::Mat blob;
+        if (ex.extract(t.blob.c_str(), blob) != 0)
+          continue;
+        for (int q = 0; q < blob.c; ++q) {
+          const float *data = blob.channel(q);
+          const size_t count = size_t(blob.w) * blob.h * blob.d;
+          if (pass == 0)
+            t.histogram.observe(data, count);
+          else
+            t.histogram.accumulate(data, count);
+        }
+      }
+    });
+    if (frames == 0) {
+      std::cerr << "omniforge_calibrate: no frames in " << opt.frames
+                << std::endl;
+      return 1;
+    }
+    std::cerr << "omniforge_calibrate: pass " << pass + 1 << ": " << frames
+              << " frames" << std::endl;
+  }
+
+  std::FILE *out =
+      opt.output == "-" ? stdout : std::fopen(opt.output.c_str(), "w");
+  if (!out) {
+    std::cerr << "omniforge_calibrate: cannot open " << opt.output
+              << std::endl;
+    return 1;
+  }
+  // ncnn2table layout: all weight scales, then all input scales.
+  for (const Target &t : targets) {
+    const ncnn::Convolution &conv = *t.layer;
+    const std::vector<float> scales =
+        weightScales(conv.weight_data, conv.num_output,
+                     size_t(conv.weight_data_size) / conv.num_output);
+    std::fprintf(out, "%s_param_0", conv.name.c_str());
+    for (float s : scales)
+      std::fprintf(out, " %f", s);
+    std::fprintf(out, "\n");
+  }
+  for (const Target &t : targets)
+    std::fprintf(out, "%s %f\n", t.layer->name.c_str(), t.histogram.scale());
+  if (out != stdout)
+    std::fclose(out);
+  return 0;
+#else
+  (void)forEachTile;
+  std::cerr << "omniforge_calibrate: built without ncnn" << std::endl;
+  return 1;
+#endif
+}
@@ -0,0 +1,136 @@
+// telemetry_main.cpp
+// omniforge_telemetry: prints the live stats of a hooked process from its
+// shared-memory telemetry segment, e.g.
+//
+//   omniforge_telemetry 4242
+//   omniforge_telemetry 4242 --frames     (one line per presented frame)
+//
+// Only reads the segment, so it can come and go while the game runs.
+
+#include "../pipeline/hybrid_mode.h"
+#include "../utils/telemetry.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+  uint32_t pid = 0;
+  bool frames = false;
+  int intervalMs = 1000;
+};
+
+void usage() {
+  std::cerr << "usage: omniforge_telemetry PID [options]\n"
+               "  --frames            print every frame instead of a summary\n"
+               "  --interval MS       summary period (default 1000)\n";
+}
+
+bool parseArgs(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--frames") {
+      opt.frames = true;
+    } else if (arg == "--interval" && hasValue) {
+      opt.intervalMs = std::atoi(argv[++i]);
+      if (opt.intervalMs < 1)
+        return false;
+    } else if (opt.pid == 0 && std::atol(arg.c_str()) > 0) {
+      opt.pid = static_cast<uint32_t>(std::atol(arg.c_str()));
+    } else {
+      return false;
+    }
+  }
+  return opt.pid != 0;
+}
+
+const char *modeName(uint32_t mode) {
+  switch (static_cast<UpscaleMode>(mode)) {
+  case UpscaleMode::FSR_ONLY:
+    return "fsr";
+  case UpscaleMode::NEURAL_ONLY:
+    return "neural";
+  case UpscaleMode::HYBRID:
+    return "hybrid";
+  }
+  return "?";
+}
+
+void printSummary(const StatsSample &s) {
+  std::printf("%.1f fps  frame p50 %.2f p95 %.2f p99 %.2f ms  1%% low %.1f "
+              "fps\n",
+              s.fps, s.frames.p50Ms, s.frames.p95Ms, s.frames.p99Ms,
+              s.frames.low1PctFps);
+  for (int i = 0; i < static_cast<int>(Stage::Count); ++i) {
+    const LatencyStats &st = s.stages[i];
+    if (st.count == 0)
+      continue;
+    std::printf("  %-8s mean %.3f p95 %.3f max %.3f ms\n",
+                stageName(static_cast<Stage>(i)), st.meanMs, st.p95Ms,
+                st.maxMs);
+  }
+  if (s.tiles.total > 0)
+    std::printf("  tiles: %llu skipped, %llu neural of %llu\n",
+                static_cast<unsigned long long>(s.tiles.skipped),
+                static_cast<unsigned long long>(s.tiles.neural),
+                static_cast<unsigned long long>(s.tiles.total));
+  std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    usage();
+    return 2;
+  }
+
+  TelemetryReader reader;
+  if (!reader.open(opt.pid)) {
+    std::cerr << "omniforge_telemetry: no telemetry from process " << opt.pid
+              << " (not hooked yet, or OMNIFORGE_TELEMETRY=0)" << std::endl;
+    return 1;
+  }
+
+  std::vector<FrameSample> frames(kTelemetryFrames);
+  uint64_t next = reader.frameCount();
+  uint64_t lastStats = 0;
+  // The writer republishes stats several times a second while it lives.
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point lastChange = Clock::now();
+  const std::chrono::milliseconds sleep(opt.frames ? 16 : opt.intervalMs);
+  for (;;) {
+    StatsSample stats;
+    const bool fresh = reader.readStats(stats) && stats.timeNs != lastStats;
+    if (fresh) {
+      lastStats = stats.timeNs;
+      lastChange = Clock::now();
+    } else if (Clock::now() - lastChange > std::chrono::seconds(3)) {
+      std::cerr << "omniforge_telemetry: process " << opt.pid
+                << " stopped reporting" << std::endl;
+      return 0;
+    }
+
+    if (opt.frames) {
+      const size_t n = reader.readFrames(next, frames.data(), frames.size());
+      for (size_t i = 0; i < n; ++i) {
+        const FrameSample &f = frames[i];
+        std::printf("%llu  %.3f ms  upscale %.3f ms  %s x%.2f\n",
+                    static_cast<unsigned long long>(f.frame), f.frameMs,
+                    f.upscaleMs, modeName(f.mode), f.inputScale);
+        next = f.frame + 1;
+      }
+      std::fflush(stdout);
+    } else if (fresh) {
+      printSummary(stats);
+    }
+    std::this_thread::sleep_for(sleep);
+  }
+}
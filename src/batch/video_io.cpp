@@ -0,0 +1,243 @@
+// video_io.cpp
+// Y4M parsing and YCbCr <-> RGBA8 conversion for the batch tool.
+
+#include "video_io.h"
+#include "../utils/thread_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kMaxHeader = 4096;
+constexpr int kRowsPerTask = 16; // even, so 4:2:0 row pairs stay together
+
+// Reads one '\n'-terminated header line (without the newline).
+bool readLine(std::FILE *in, std::string &line) {
+  line.clear();
+  for (;;) {
+    const int c = std::fgetc(in);
+    if (c == EOF)
+      return false;
+    if (c == '\n')
+      return true;
+    if (line.size() == kMaxHeader)
+      return false;
+    line.push_back(static_cast<char>(c));
+  }
+}
+
+uint8_t clamp8(int v) {
+  return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// BT.601 limited range in 16.16 fixed point.
+inline uint32_t yuvToPixel(int y, int u, int v) {
+  const int c = (y - 16) * 76309;
+  const int d = u - 128;
+  const int e = v - 128;
+  const int r = (c + 104597 * e + 32768) >> 16;
+  const int g = (c - 25675 * d - 53279 * e + 32768) >> 16;
+  const int b = (c + 132201 * d + 32768) >> 16;
+  return uint32_t(clamp8(r)) | uint32_t(clamp8(g)) << 8 |
+         uint32_t(clamp8(b)) << 16 | 0xff000000u;
+}
+
+inline uint8_t lumaOf(int r, int g, int b) {
+  return clamp8(((16829 * r + 33039 * g + 6416 * b + 32768) >> 16) + 16);
+}
+inline uint8_t cbOf(int r, int g, int b) {
+  return clamp8(((-9714 * r - 19070 * g + 28784 * b + 32768) >> 16) + 128);
+}
+inline uint8_t crOf(int r, int g, int b) {
+  return clamp8(((28784 * r - 24103 * g - 4681 * b + 32768) >> 16) + 128);
+}
+
+size_t chromaWidth(const StreamInfo &info) {
+  return info.chroma420 ? size_t(info.width + 1) / 2 : size_t(info.width);
+}
+size_t chromaHeight(const StreamInfo &info) {
+  return info.chroma420 ? size_t(info.height + 1) / 2 : size_t(info.height);
+}
+
+template <typename Fn>
+void forRowBands(ThreadPool &pool, int height, Fn &&fn) {
+  const int bands = (height + kRowsPerTask - 1) / kRowsPerTask;
+  pool.parallelFor(static_cast<size_t>(bands), [&](size_t i) {
+    const int y0 = static_cast<int>(i) * kRowsPerTask;
+    fn(y0, std::min(height, y0 + kRowsPerTask));
+  });
+}
+
+void decodeYuv(const StreamInfo &info, const uint8_t *payload,
+               const FrameView &frame, ThreadPool &pool) {
+  const size_t lumaBytes = size_t(info.width) * info.height;
+  const size_t cw = chromaWidth(info);
+  const uint8_t *yPlane = payload;
+  const uint8_t *uPlane = payload + lumaBytes;
+  const uint8_t *vPlane = uPlane + cw * chromaHeight(info);
+  const int shift = info.chroma420 ? 1 : 0;
+
+  forRowBands(pool, info.height, [&](int y0, int y1) {
+    for (int y = y0; y < y1; ++y) {
+      const uint8_t *yr = yPlane + size_t(y) * info.width;
+      const uint8_t *ur = uPlane + size_t(y >> shift) * cw;
+      const uint8_t *vr = vPlane + size_t(y >> shift) * cw;
+      uint32_t *dst = frame.row(y);
+      for (int x = 0; x < info.width; ++x)
+        dst[x] = yuvToPixel(yr[x], ur[x >> shift], vr[x >> shift]);
+    }
+  });
+}
+
+void encodeYuv(const StreamInfo &info, const FrameView &frame,
+               uint8_t *payload, ThreadPool &pool) {
+  const size_t lumaBytes = size_t(info.width) * info.height;
+  const size_t cw = chromaWidth(info);
+  uint8_t *yPlane = payload;
+  uint8_t *uPlane = payload + lumaBytes;
+  uint8_t *vPlane = uPlane + cw * chromaHeight(info);
+
+  forRowBands(pool, info.height, [&](int y0, int y1) {
+    for (int y = y0; y < y1; ++y) {
+      const uint8_t *src = reinterpret_cast<const uint8_t *>(frame.row(y));
+      uint8_t *yr = yPlane + size_t(y) * info.width;
+      for (int x = 0; x < info.width; ++x)
+        yr[x] = lumaOf(src[4 * x], src[4 * x + 1], src[4 * x + 2]);
+      if (!info.chroma420) {
+        uint8_t *ur = uPlane + size_t(y) * cw;
+        uint8_t *vr = vPlane + size_t(y) * cw;
+        for (int x = 0; x < info.width; ++x) {
+          const uint8_t *p = src + 4 * x;
+          ur[x] = cbOf(p[0], p[1], p[2]);
+          vr[x] = crOf(p[0], p[1], p[2]);
+        }
+      }
+    }
+    if (!info.chroma420)
+      return;
+    // Chroma from the 2x2 average; edge blocks reuse the last row/column.
+    for (int y = y0; y < y1; y += 2) {
+      const uint8_t *r0 = reinterpret_cast<const uint8_t *>(frame.row(y));
+      const uint8_t *r1 = reinterpret_cast<const uint8_t *>(
+          frame.row(std::min(y + 1, info.height - 1)));
+      uint8_t *ur = uPlane + size_t(y / 2) * cw;
+      uint8_t *vr = vPlane + size_t(y / 2) * cw;
+      for (size_t cx = 0; cx < cw; ++cx) {
+        const size_t x0 = 2 * cx;
+        const size_t x1 = std::min(x0 + 1, size_t(info.width) - 1);
+        int rgb[3];
+        for (int c = 0; c < 3; ++c)
+          rgb[c] = (r0[4 * x0 + c] + r0[4 * x1 + c] + r1[4 * x0 + c] +
+                    r1[4 * x1 + c] + 2) >> 2;
+        ur[cx] = cbOf(rgb[0], rgb[1], rgb[2]);
+        vr[cx] = crOf(rgb[0], rgb[1], rgb[2]);
+      }
+    }
+  });
+}
+
+} // namespace
+
+bool readY4mHeader(std::FILE *in, StreamInfo &info, std::string &error) {
+  std::string line;
+  if (!readLine(in, line) || line.compare(0, 10, "YUV4MPEG2 ") != 0) {
+    error = "not a YUV4MPEG2 stream";
+    return false;
+  }
+  info = StreamInfo();
+  info.format = StreamFormat::Y4M;
+  info.chromaTag = "420jpeg"; // the spec's default
+
+  size_t pos = 10;
+  while (pos < line.size()) {
+    size_t end = line.find(' ', pos);
+    if (end == std::string::npos)
+      end = line.size();
+    const std::string token = line.substr(pos, end - pos);
+    pos = end + 1;
+    if (token.empty())
+      continue;
+    switch (token[0]) {
+    case 'W':
+      info.width = std::atoi(token.c_str() + 1);
+      break;
+    case 'H':
+      info.height = std::atoi(token.c_str() + 1);
+      break;
+    case 'C':
+      info.chromaTag = token.substr(1);
+      break;
+    default:
+      info.params += ' ';
+      info.params += token;
+      break;
+    }
+  }
+
+  if (info.width <= 0 || info.height <= 0) {
+    error = "missing or invalid frame size";
+    return false;
+  }
+  const std::string &c = info.chromaTag;
+  if (c == "420jpeg" || c == "420mpeg2" || c == "420paldv" || c == "420") {
+    info.chroma420 = true;
+  } else if (c == "444") {
+    info.chroma420 = false;
+  } else {
+    error = "unsupported colourspace C" + c + " (8-bit 420 or 444 only)";
+    return false;
+  }
+  return true;
+}
+
+bool writeY4mHeader(std::FILE *out, const StreamInfo &info) {
+  return std::fprintf(out, "YUV4MPEG2 W%d H%d C%s%s\n", info.width,
+                      info.height, info.chromaTag.c_str(),
+                      info.params.c_str()) > 0;
+}
+
+size_t payloadBytes(const StreamInfo &info) {
+  if (info.format == StreamFormat::RawRGBA)
+    return size_t(info.width) * info.height * 4;
+  return size_t(info.width) * info.height +
+         2 * chromaWidth(info) * chromaHeight(info);
+}
+
+bool readFrame(std::FILE *in, const StreamInfo &info, uint8_t *payload,
+               const FrameView &frame, ThreadPool &pool) {
+  if (info.format == StreamFormat::RawRGBA) {
+    const size_t rowBytes = size_t(info.width) * 4;
+    if (frame.stride == rowBytes)
+      return std::fread(frame.data, rowBytes * info.height, 1, in) == 1;
+    for (int y = 0; y < info.height; ++y)
+      if (std::fread(frame.row(y), rowBytes, 1, in) != 1)
+        return false;
+    return true;
+  }
+
+  std::string line;
+  if (!readLine(in, line) || line.compare(0, 5, "FRAME") != 0)
+    return false;
+  if (std::fread(payload, payloadBytes(info), 1, in) != 1)
+    return false;
+  decodeYuv(info, payload, frame, pool);
+  return true;
+}
+
+bool writeFrame(std::FILE *out, const StreamInfo &info, uint8_t *payload,
+                const FrameView &frame, ThreadPool &pool) {
+  if (info.format == StreamFormat::RawRGBA) {
+    const size_t rowBytes = size_t(info.width) * 4;
+    if (frame.stride == rowBytes)
+      return std::fwrite(frame.data, rowBytes * info.height, 1, out) == 1;
+    for (int y = 0; y < info.height; ++y)
+      if (std::fwrite(frame.row(y), rowBytes, 1, out) != 1)
+        return false;
+    return true;
+  }
+
+  encodeYuv(info, frame, payload, pool);
+  return std::fputs("FRAME\n", out) >= 0 &&
+         std::fwrite(payload, payloadBytes(info), 1, out) == 1;
+}
@@ -0,0 +1,41 @@
+#pragma once
+// video_io.h
+// Y4M and raw RGBA8 frame streams for omniforge_batch.
+
+#include "../pipeline/frame.h"
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+class ThreadPool;
+
+enum class StreamFormat { Y4M, RawRGBA };
+
+// Layout of one stream. Y4M streams are 8-bit 4:2:0 or 4:4:4 YCbCr,
+// converted to and from RGBA8 with BT.601 limited-range coefficients (what
+// ffmpeg assumes for untagged yuv420p); raw streams are packed RGBA8.
+struct StreamInfo {
+  StreamFormat format = StreamFormat::Y4M;
+  int width = 0;
+  int height = 0;
+  bool chroma420 = true;
+  std::string chromaTag; // Y4M "C" parameter as read, echoed on output
+  std::string params;    // other Y4M header parameters, echoed on output
+};
+
+// Parses the stream header; `error` says why on failure.
+bool readY4mHeader(std::FILE *in, StreamInfo &info, std::string &error);
+bool writeY4mHeader(std::FILE *out, const StreamInfo &info);
+
+// Bytes of one frame's payload on the wire (without the FRAME line).
+size_t payloadBytes(const StreamInfo &info);
+
+// Reads the next frame into `frame`, which must match the stream extent.
+// Y4M frames are read into `payload` (payloadBytes() long) and converted
+// on `pool`; raw frames go straight into `frame`. False at end of stream.
+bool readFrame(std::FILE *in, const StreamInfo &info, uint8_t *payload,
+               const FrameView &frame, ThreadPool &pool);
+
+// Inverse of readFrame().
+bool writeFrame(std::FILE *out, const StreamInfo &info, uint8_t *payload,
+                const FrameView &frame, ThreadPool &pool);
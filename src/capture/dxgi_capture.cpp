@@ -1,9 +1,9 @@
 // dxgi_capture.cpp
 // Fallback DirectX capture stubs for DXGI swapchain Present interception.
 
+#include "../utils/log.h"
 #include <d3d11.h>
 #include <dxgi.h>
-#include <iostream>
 
 
 // Global pointer to the original function, to be set by MinHook
@@ -22,7 +22,8 @@ HRESULT WINAPI Detour_IDXGISwapChain_Present(IDXGISwapChain *pSwapChain,
   // pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&pBackBuffer);
 
   // For now, just log
-  // std::cout << "DXGI Present intercepted!" << std::endl;
+  OMNIFORGE_LOG_DEBUG("DXGI Present intercepted ({}, sync {})", pSwapChain,
+                      SyncInterval);
 
   // Call the original function
   IDXGISwapChain_Present_T original =
@@ -35,13 +36,12 @@ HRESULT WINAPI Detour_IDXGISwapChain_Present(IDXGISwapChain *pSwapChain,
 
 extern "C" {
 bool initializeCaptureDXGI() {
-  std::cerr
-      << "dxgi_capture: initializeCaptureDXGI() called. Hook setup required."
-      << std::endl;
+  OMNIFORGE_LOG_INFO(
+      "dxgi_capture: initializeCaptureDXGI() called. Hook setup required.");
   return true;
 }
 
 void shutdownCaptureDXGI() {
-  std::cerr << "dxgi_capture: shutdownCaptureDXGI() called." << std::endl;
+  OMNIFORGE_LOG_INFO("dxgi_capture: shutdownCaptureDXGI() called.");
 }
 }
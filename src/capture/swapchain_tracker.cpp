@@ -0,0 +1,271 @@
+// swapchain_tracker.cpp
+// Per-swapchain state and the present-time hand-off to the upscaler.
+
+#include "swapchain_tracker.h"
+
+#ifdef OMNIFORGE_HAVE_VULKAN
+#include "../pipeline/governor.h"
+#include "../pipeline/present_queue.h"
+#include "../pipeline/upscale_context.h"
+#include "../utils/log.h"
+#include "../utils/metrics.h"
+#include "../utils/snapshot_map.h"
+#include "../utils/telemetry.h"
+#include "../utils/trace.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Frame budget; OMNIFORGE_TARGET_FPS overrides the 60 fps default.
+double targetFrameMs() {
+  const char *env = std::getenv("OMNIFORGE_TARGET_FPS");
+  const double fps = env ? std::atof(env) : 0.0;
+  return 1000.0 / (fps > 0.0 ? fps : 60.0);
+}
+
+// Only the present call for a swapchain touches its entry (Vulkan requires
+// presents to one swapchain to be serialised); `extent` and `images` change
+// only while the entry is out of the map.
+struct SwapchainData {
+  VkExtent2D extent;
+  VkFormat format;
+  // The layout the upscaler works on; images of any other format are
+  // presented as they are.
+  PixelFormat pixels = PixelFormat::RGBA8;
+  bool upscalable = false;
+  std::vector<VkImage> images;
+  // PresentQueue ticket of the last upscale of each image; 0 = none.
+  std::vector<uint64_t> imageTickets;
+  UpscaleContext upscale;
+  // Fed by this swapchain's own presents, so multi-queue presents to
+  // different swapchains share no lock.
+  FrameGovernor governor{UpscaleMode::HYBRID, targetFrameMs()};
+  Clock::time_point lastPresent;
+};
+
+// Looked up lock-free on every present; written on swapchain setup.
+SnapshotMap<VkSwapchainKHR, SwapchainData> g_swapchains;
+// Serialises the setup hooks against each other.
+std::mutex g_captureMutex;
+// The last destroyed swapchain's state, kept for a create that does not
+// name it as oldSwapchain (e.g. some fullscreen toggles). At most one.
+// Guarded by g_captureMutex.
+std::unique_ptr<SwapchainData> g_parked;
+
+// Takes `swapchain` out of the registry and waits until no queued upscale
+// still uses its context, so its state can be reused or freed. Called with
+// g_captureMutex held.
+std::unique_ptr<SwapchainData> retireSwapchain(VkSwapchainKHR swapchain) {
+  std::unique_ptr<SwapchainData> data = g_swapchains.erase(swapchain);
+  if (data)
+    PresentQueue::shared().drain();
+  return data;
+}
+
+// A retired swapchain's upscale context and governor carry over when the
+// new images have the same extent (its tile layout, scratch and history
+// all still fit, and the measured costs still apply). Otherwise they are
+// dropped: the buffers go back to the FramePool, whose cache is bounded,
+// so repeated resizes do not add up.
+bool recycleInto(SwapchainData &next, std::unique_ptr<SwapchainData> old) {
+  if (!old || old->extent.width != next.extent.width ||
+      old->extent.height != next.extent.height)
+    return false;
+  next.upscale = std::move(old->upscale);
+  next.governor = old->governor;
+  return true;
+}
+
+// The swapchain formats the upscaler reads and writes in place. The sRGB
+// variants share the UNORM layouts; FSR works on the stored values either
+// way.
+bool pixelFormatOf(VkFormat format, PixelFormat &out) {
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+    out = PixelFormat::RGBA8;
+    return true;
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    out = PixelFormat::BGRA8;
+    return true;
+  case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    out = PixelFormat::RGB10A2;
+    return true;
+  case VK_FORMAT_R16G16B16A16_SFLOAT:
+    out = PixelFormat::RGBA16F;
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Upscale factor; OMNIFORGE_SCALE overrides the 2x default. 1.5, 2 and 3
+// have dedicated FSR kernels.
+double outputScale() {
+  static const double scale = [] {
+    const char *env = std::getenv("OMNIFORGE_SCALE");
+    const double s = env ? std::atof(env) : 0.0;
+    return s >= 1.0 ? s : 2.0;
+  }();
+  return scale;
+}
+
+} // namespace
+
+void onSwapchainCreated(const VkSwapchainCreateInfoKHR *info, VkResult result,
+                        VkSwapchainKHR swapchain) {
+  std::lock_guard<std::mutex> lock(g_captureMutex);
+  // oldSwapchain is retired by this call even if it failed. It may still
+  // present images it already handed out; those go through unscaled.
+  std::unique_ptr<SwapchainData> old;
+  if (info->oldSwapchain != VK_NULL_HANDLE)
+    old = retireSwapchain(info->oldSwapchain);
+  if (!old)
+    old = std::move(g_parked);
+
+  if (result == VK_SUCCESS) {
+    auto data = std::make_unique<SwapchainData>();
+    data->extent = info->imageExtent;
+    data->format = info->imageFormat;
+    const bool upscalable = pixelFormatOf(info->imageFormat, data->pixels);
+    data->upscalable = upscalable;
+    const bool recycled = recycleInto(*data, std::move(old));
+    g_swapchains.insert(swapchain, std::move(data));
+    OMNIFORGE_LOG_INFO("Captured Swapchain: {}x{}, format {}{}",
+                       info->imageExtent.width, info->imageExtent.height,
+                       info->imageFormat,
+                       recycled ? " (reusing upscale state)" : "");
+    if (!upscalable)
+      OMNIFORGE_LOG_WARN("Swapchain format {} is not supported; presenting "
+                         "without upscaling.",
+                         info->imageFormat);
+  }
+}
+
+void onSwapchainImages(VkSwapchainKHR swapchain, uint32_t count,
+                       const VkImage *images) {
+  std::lock_guard<std::mutex> lock(g_captureMutex);
+  // Take the entry out while its image list changes; presents in the
+  // meantime go through without upscaling.
+  std::unique_ptr<SwapchainData> data = g_swapchains.erase(swapchain);
+  if (data) {
+    // Upscales still queued may reference the old images.
+    PresentQueue::shared().drain();
+    data->images.assign(images, images + count);
+    data->imageTickets.assign(data->images.size(), 0);
+    g_swapchains.insert(swapchain, std::move(data));
+    OMNIFORGE_LOG_INFO("Captured {} swapchain images.", count);
+  }
+}
+
+void onSwapchainDestroyed(VkSwapchainKHR swapchain) {
+  if (swapchain == VK_NULL_HANDLE)
+    return;
+  std::lock_guard<std::mutex> lock(g_captureMutex);
+  // Before the images go away: nothing may be queued against them.
+  std::unique_ptr<SwapchainData> data = retireSwapchain(swapchain);
+  if (data) {
+    data->images.clear();
+    data->imageTickets.clear();
+    g_parked = std::move(data); // frees the previously parked state
+  }
+}
+
+void onQueuePresent(const VkPresentInfoKHR *info) {
+  OMNIFORGE_TRACE_SCOPE("capture");
+  StageTimer timer(Metrics::shared(), Stage::Capture);
+  PresentQueue &upscaler = PresentQueue::shared();
+  const double upscaleMs = upscaler.lastFrameMs();
+
+  for (uint32_t i = 0; i < info->swapchainCount; ++i) {
+    VkSwapchainKHR swapchain = info->pSwapchains[i];
+    uint32_t imageIndex = info->pImageIndices[i];
+
+    // Nothing below blocks inside a read section, where it would hold up
+    // a writer's synchronize(); the entry is looked up again to submit.
+    PresentJob job;
+    uint64_t previous = 0;
+    FrameSample sample;
+    const bool found = g_swapchains.with(swapchain, [&](SwapchainData &data) {
+      // Interval measured present-to-present, so it covers the game's own
+      // work plus ours; our cost is the upscale thread's latest frame.
+      const Clock::time_point now = Clock::now();
+      if (data.lastPresent != Clock::time_point()) {
+        const double frameMs =
+            std::chrono::duration<double, std::milli>(now - data.lastPresent)
+                .count();
+        data.governor.onFrame(frameMs, upscaleMs);
+        sample.frameMs = static_cast<float>(frameMs);
+      }
+      data.lastPresent = now;
+      const GovernorDecision decision = data.governor.decision();
+      sample.timeNs = static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              now.time_since_epoch())
+              .count());
+      sample.inputScale = decision.inputScale;
+      sample.mode = static_cast<uint32_t>(decision.mode);
+
+      if (imageIndex >= data.images.size() || !data.upscalable)
+        return;
+      previous = data.imageTickets[imageIndex];
+      job.ctx = &data.upscale;
+      job.image = (void *)data.images[imageIndex];
+      job.width = data.extent.width;
+      job.height = data.extent.height;
+      job.outWidth = static_cast<int>(std::lround(job.width * outputScale()));
+      job.outHeight =
+          static_cast<int>(std::lround(job.height * outputScale()));
+      job.format = data.pixels;
+      job.mode = decision.mode;
+      job.inputScale = decision.inputScale;
+    });
+    if (!found)
+      continue;
+    sample.upscaleMs = static_cast<float>(upscaleMs);
+    TelemetryWriter::shared().recordFrame(sample);
+    if (!job.ctx)
+      continue;
+
+    // The game got this image back, so its previous upscale must be done
+    // with it before the next one is queued. Ordering the upscale against
+    // this present on the GPU is the submitted work's job (it signals what
+    // the present waits on).
+    upscaler.wait(previous);
+    // Submitting inside the section means a writer that takes the entry
+    // out afterwards drains this job before it touches the context. If
+    // the images changed meanwhile, the frame goes through unscaled.
+    for (bool submitted = false, stale = false; !submitted && !stale;) {
+      upscaler.waitForRoom();
+      const bool present =
+          g_swapchains.with(swapchain, [&](SwapchainData &data) {
+            if (imageIndex >= data.images.size() ||
+                (void *)data.images[imageIndex] != job.image) {
+              stale = true;
+              return;
+            }
+            const uint64_t ticket = upscaler.trySubmit(job);
+            if (ticket) {
+              data.imageTickets[imageIndex] = ticket;
+              submitted = true;
+            }
+          });
+      stale = stale || !present;
+    }
+  }
+}
+
+void shutdownSwapchainTracking() {
+  PresentQueue::shared().drain();
+  std::lock_guard<std::mutex> lock(g_captureMutex);
+  g_parked.reset();
+}
+#endif
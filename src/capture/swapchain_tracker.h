@@ -0,0 +1,31 @@
+#pragma once
+// swapchain_tracker.h
+// Swapchain bookkeeping and frame hand-off shared by the capture backends:
+// the MinHook detours (vulkan_capture.cpp) and the Vulkan layer
+// (layer/vulkan_layer.cpp). A backend calls the next implementation itself
+// and reports to these functions around it.
+
+#ifdef OMNIFORGE_HAVE_VULKAN
+#include <vulkan/vulkan.h>
+
+// After vkCreateSwapchainKHR returned `result`; `swapchain` is only looked
+// at on success. Retires info->oldSwapchain either way.
+void onSwapchainCreated(const VkSwapchainCreateInfoKHR *info, VkResult result,
+                        VkSwapchainKHR swapchain);
+
+// After a vkGetSwapchainImagesKHR call that filled in `images`.
+void onSwapchainImages(VkSwapchainKHR swapchain, uint32_t count,
+                       const VkImage *images);
+
+// Before vkDestroySwapchainKHR: nothing may be queued against the images
+// once this returns.
+void onSwapchainDestroyed(VkSwapchainKHR swapchain);
+
+// Before vkQueuePresentKHR passes the frame on: queues the upscales. Only
+// waits when all frames in flight are taken.
+void onQueuePresent(const VkPresentInfoKHR *info);
+
+// Lets queued frames finish and frees kept state; the hooks must already
+// be off.
+void shutdownSwapchainTracking();
+#endif
@@ -1,27 +1,17 @@
 // vulkan_capture.cpp
 // Capture stubs for Vulkan-based frame interception.
 
-#include <iostream>
-#include <mutex>
-#include <unordered_map>
-#include <vector>
-
-
-#include "../pipeline/upscaler.h"
+#include "../engines/neural_engine.h"
+#include "../utils/log.h"
+#include "../utils/metrics.h"
+#include "../utils/telemetry.h"
+#include "../utils/trace.h"
+#include "swapchain_tracker.h"
 #include <MinHook.h>
 
 #ifdef OMNIFORGE_HAVE_VULKAN
 #include <vulkan/vulkan.h>
 
-// Global state tracking
-struct SwapchainData {
-  VkExtent2D extent;
-  std::vector<VkImage> images;
-};
-
-static std::unordered_map<VkSwapchainKHR, SwapchainData> g_swapchains;
-static std::mutex g_captureMutex;
-
 // Original function pointers
 typedef VkResult(VKAPI_PTR *PFN_vkQueuePresentKHR)(VkQueue,
                                                    const VkPresentInfoKHR *);
@@ -31,10 +21,13 @@ typedef VkResult(VKAPI_PTR *PFN_vkCreateSwapchainKHR)(
 typedef VkResult(VKAPI_PTR *PFN_vkGetSwapchainImagesKHR)(VkDevice,
                                                          VkSwapchainKHR,
                                                          uint32_t *, VkImage *);
+typedef void(VKAPI_PTR *PFN_vkDestroySwapchainKHR)(
+    VkDevice, VkSwapchainKHR, const VkAllocationCallbacks *);
 
 PFN_vkQueuePresentKHR Original_vkQueuePresentKHR = nullptr;
 PFN_vkCreateSwapchainKHR Original_vkCreateSwapchainKHR = nullptr;
 PFN_vkGetSwapchainImagesKHR Original_vkGetSwapchainImagesKHR = nullptr;
+PFN_vkDestroySwapchainKHR Original_vkDestroySwapchainKHR = nullptr;
 
 // Detours
 
@@ -43,13 +36,9 @@ VkResult VKAPI_PTR Detour_vkCreateSwapchainKHR(
     const VkAllocationCallbacks *pAllocator, VkSwapchainKHR *pSwapchain) {
   VkResult result = Original_vkCreateSwapchainKHR(device, pCreateInfo,
                                                   pAllocator, pSwapchain);
-
-  if (result == VK_SUCCESS && pSwapchain && pCreateInfo) {
-    std::lock_guard<std::mutex> lock(g_captureMutex);
-    g_swapchains[*pSwapchain].extent = pCreateInfo->imageExtent;
-    std::cerr << "Captured Swapchain: " << pCreateInfo->imageExtent.width << "x"
-              << pCreateInfo->imageExtent.height << std::endl;
-  }
+  if (pCreateInfo)
+    onSwapchainCreated(pCreateInfo, result,
+                       pSwapchain ? *pSwapchain : VK_NULL_HANDLE);
   return result;
 }
 
@@ -59,42 +48,33 @@ VkResult VKAPI_PTR Detour_vkGetSwapchainImagesKHR(
   VkResult result = Original_vkGetSwapchainImagesKHR(
       device, swapchain, pSwapchainImageCount, pSwapchainImages);
 
-  if (result == VK_SUCCESS && pSwapchainImages != nullptr) {
-    std::lock_guard<std::mutex> lock(g_captureMutex);
-    if (g_swapchains.find(swapchain) != g_swapchains.end()) {
-      std::vector<VkImage> images(pSwapchainImages,
-                                  pSwapchainImages + *pSwapchainImageCount);
-      g_swapchains[swapchain].images = images;
-      std::cerr << "Captured " << *pSwapchainImageCount << " swapchain images."
-                << std::endl;
-    }
-  }
+  if (result == VK_SUCCESS && pSwapchainImages != nullptr)
+    onSwapchainImages(swapchain, *pSwapchainImageCount, pSwapchainImages);
   return result;
 }
 
+void VKAPI_PTR Detour_vkDestroySwapchainKHR(
+    VkDevice device, VkSwapchainKHR swapchain,
+    const VkAllocationCallbacks *pAllocator) {
+  onSwapchainDestroyed(swapchain);
+  Original_vkDestroySwapchainKHR(device, swapchain, pAllocator);
+}
+
 VkResult VKAPI_PTR
 Detour_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
-  if (pPresentInfo) {
-    std::lock_guard<std::mutex> lock(g_captureMutex);
-    for (uint32_t i = 0; i < pPresentInfo->swapchainCount; ++i) {
-      VkSwapchainKHR swapchain = pPresentInfo->pSwapchains[i];
-      uint32_t imageIndex = pPresentInfo->pImageIndices[i];
-
-      if (g_swapchains.find(swapchain) != g_swapchains.end()) {
-        SwapchainData &data = g_swapchains[swapchain];
-        if (imageIndex < data.images.size()) {
-          VkImage image = data.images[imageIndex];
-          // Call the upscaler!
-          // For now, hardcode HYBRID mode
-          processFrame((void *)image, data.extent.width, data.extent.height,
-                       UpscaleMode::HYBRID);
-        }
-      }
-    }
-  }
+  Metrics &metrics = Metrics::shared();
+  if (pPresentInfo)
+    onQueuePresent(pPresentInfo);
 
   if (Original_vkQueuePresentKHR) {
-    return Original_vkQueuePresentKHR(queue, pPresentInfo);
+    VkResult result;
+    {
+      OMNIFORGE_TRACE_SCOPE("present");
+      StageTimer timer(metrics, Stage::Present);
+      result = Original_vkQueuePresentKHR(queue, pPresentInfo);
+    }
+    metrics.framePresented();
+    return result;
   }
   return VK_ERROR_INITIALIZATION_FAILED;
 }
@@ -103,7 +83,7 @@ Detour_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
 extern "C" {
 bool initializeCapture() {
 #ifdef OMNIFORGE_HAVE_VULKAN
-  std::cerr << "vulkan_capture: Initializing MinHook..." << std::endl;
+  OMNIFORGE_LOG_INFO("vulkan_capture: Initializing MinHook...");
 
   // We assume the game has loaded vulkan-1.dll.
   // In a robust injector, we might need to wait for the module or hook
@@ -114,8 +94,7 @@ bool initializeCapture() {
   }
 
   if (!hVulkan) {
-    std::cerr << "vulkan_capture: Failed to get vulkan-1.dll handle."
-              << std::endl;
+    OMNIFORGE_LOG_ERROR("vulkan_capture: Failed to get vulkan-1.dll handle.");
     return false;
   }
 
@@ -124,37 +103,62 @@ bool initializeCapture() {
       (void *)GetProcAddress(hVulkan, "vkCreateSwapchainKHR");
   void *pGetSwapchainImages =
       (void *)GetProcAddress(hVulkan, "vkGetSwapchainImagesKHR");
+  void *pDestroySwapchain =
+      (void *)GetProcAddress(hVulkan, "vkDestroySwapchainKHR");
 
   if (pPresent) {
     MH_CreateHook(pPresent, (void *)&Detour_vkQueuePresentKHR,
                   (void **)&Original_vkQueuePresentKHR);
     MH_EnableHook(pPresent);
-    std::cerr << "vulkan_capture: Hooked vkQueuePresentKHR" << std::endl;
+    OMNIFORGE_LOG_INFO("vulkan_capture: Hooked vkQueuePresentKHR");
   }
 
   if (pCreateSwapchain) {
     MH_CreateHook(pCreateSwapchain, (void *)&Detour_vkCreateSwapchainKHR,
                   (void **)&Original_vkCreateSwapchainKHR);
     MH_EnableHook(pCreateSwapchain);
-    std::cerr << "vulkan_capture: Hooked vkCreateSwapchainKHR" << std::endl;
+    OMNIFORGE_LOG_INFO("vulkan_capture: Hooked vkCreateSwapchainKHR");
   }
 
   if (pGetSwapchainImages) {
     MH_CreateHook(pGetSwapchainImages, (void *)&Detour_vkGetSwapchainImagesKHR,
                   (void **)&Original_vkGetSwapchainImagesKHR);
     MH_EnableHook(pGetSwapchainImages);
-    std::cerr << "vulkan_capture: Hooked vkGetSwapchainImagesKHR" << std::endl;
+    OMNIFORGE_LOG_INFO("vulkan_capture: Hooked vkGetSwapchainImagesKHR");
   }
 
+  if (pDestroySwapchain) {
+    MH_CreateHook(pDestroySwapchain, (void *)&Detour_vkDestroySwapchainKHR,
+                  (void **)&Original_vkDestroySwapchainKHR);
+    MH_EnableHook(pDestroySwapchain);
+    OMNIFORGE_LOG_INFO("vulkan_capture: Hooked vkDestroySwapchainKHR");
+  }
+
+  // Start loading the neural model now so it is usually ready before the
+  // first present; frames use FSR until then.
+  initNcnnVulkan();
+  // The dashboard finds this process's live stats by its pid.
+  TelemetryWriter::shared().open();
   return true;
 #else
-  std::cerr << "vulkan_capture: Vulkan not available." << std::endl;
+  OMNIFORGE_LOG_ERROR("vulkan_capture: Vulkan not available.");
   return false;
 #endif
 }
 
 void shutdownCapture() {
-  std::cerr << "vulkan_capture: shutdownCapture() called." << std::endl;
+  OMNIFORGE_LOG_INFO("vulkan_capture: shutdownCapture() called.");
   MH_DisableHook(MH_ALL_HOOKS);
+#ifdef OMNIFORGE_HAVE_VULKAN
+  // The hooks are off, so nothing new arrives; let queued frames finish
+  // before the module can go away.
+  shutdownSwapchainTracking();
+#endif
+  TelemetryWriter::shared().close();
+  // A no-op unless OMNIFORGE_TRACE is set.
+  Tracer::shared().flushAsync();
+  Tracer::shared().waitFlushed();
+  // Joins the log thread here rather than in DllMain, under the loader lock.
+  Logger::shared().shutdown();
 }
 }
@@ -0,0 +1,408 @@
+// cpu_conv.cpp
+// Portable build of the built-in engine's convolution kernels, weight
+// packing and the runtime ISA dispatch.
+
+#include "cpu_conv.h"
+#include "../utils/cpu_features.h"
+#include "../utils/frame_pool.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+// Four lanes in plain arrays, which compilers vectorize on any target;
+// used where AVX2 is unavailable and as the reference the SIMD builds are
+// checked against.
+struct Scalar {
+  static constexpr int kLanes = 4;
+  static constexpr int kRows = 4;
+  static constexpr int kVecs = 2;
+
+  struct F {
+    float v[kLanes];
+    friend F operator+(F a, F b) {
+      for (int i = 0; i < kLanes; ++i)
+        a.v[i] += b.v[i];
+      return a;
+    }
+    friend F operator-(F a, F b) {
+      for (int i = 0; i < kLanes; ++i)
+        a.v[i] -= b.v[i];
+      return a;
+    }
+    friend F operator*(F a, F b) {
+      for (int i = 0; i < kLanes; ++i)
+        a.v[i] *= b.v[i];
+      return a;
+    }
+  };
+
+  static F zero() { return splat(0.0f); }
+  static F splat(float f) {
+    F r;
+    for (int i = 0; i < kLanes; ++i)
+      r.v[i] = f;
+    return r;
+  }
+  static F load(const float *p) {
+    F r;
+    std::memcpy(r.v, p, sizeof(r.v));
+    return r;
+  }
+  static F broadcast(const float *p) { return splat(*p); }
+  static void store(float *p, F a) { std::memcpy(p, a.v, sizeof(a.v)); }
+  static F fma(F a, F b, F c) { return a * b + c; }
+  static F min(F a, F b) {
+    for (int i = 0; i < kLanes; ++i)
+      a.v[i] = std::min(a.v[i], b.v[i]);
+    return a;
+  }
+  static F max(F a, F b) {
+    for (int i = 0; i < kLanes; ++i)
+      a.v[i] = std::max(a.v[i], b.v[i]);
+    return a;
+  }
+};
+
+} // namespace
+
+#include "cpu_conv_kernel.h"
+
+namespace {
+
+// Largest kernel a packed pass takes (cunet's biggest is 4x4).
+constexpr int kMaxTaps = 64;
+
+const ConvIsa kScalarIsa = {"scalar",        Scalar::kLanes,
+                            Scalar::kVecs,   Scalar::kRows,
+                            gemmPass<Scalar>, winogradPass<Scalar>};
+
+int floorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+// Packs weight(oc, ic, tap) into the GemmPass layout described in
+// cpu_conv.h, appending to `out`.
+template <class Fn>
+void packGemm(const ConvIsa &isa, int outC, int inC, int taps, Fn weight,
+              std::vector<float> &out) {
+  const int lanes = isa.lanes;
+  const int outPacks = (outC + lanes - 1) / lanes;
+  const int inPacks = (inC + lanes - 1) / lanes;
+  const size_t base = out.size();
+  out.resize(base + size_t(outPacks) * lanes * taps * inPacks * lanes, 0.0f);
+  float *dst = out.data() + base;
+  for (int ob = 0; ob < outPacks; ob += isa.vecs) {
+    const int vecs = std::min(isa.vecs, outPacks - ob);
+    for (int t = 0; t < taps; ++t) {
+      for (int ic = 0; ic < inPacks * lanes; ++ic) {
+        for (int o = 0; o < vecs * lanes; ++o, ++dst) {
+          const int oc = ob * lanes + o;
+          if (oc < outC && ic < inC)
+            *dst = weight(oc, ic, t);
+        }
+      }
+    }
+  }
+}
+
+// G g G^T for one 3x3 kernel, rows then columns of the 6x6 result.
+void winogradKernel(const float *g, float *u) {
+  static const float G[6][3] = {{1.0f / 4, 0.0f, 0.0f},
+                                {-1.0f / 6, -1.0f / 6, -1.0f / 6},
+                                {-1.0f / 6, 1.0f / 6, -1.0f / 6},
+                                {1.0f / 24, 1.0f / 12, 1.0f / 6},
+                                {1.0f / 24, -1.0f / 12, 1.0f / 6},
+                                {0.0f, 0.0f, 1.0f}};
+  float gg[6][3];
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 3; ++j)
+      gg[i][j] = G[i][0] * g[j] + G[i][1] * g[3 + j] + G[i][2] * g[6 + j];
+  }
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 6; ++j)
+      u[i * 6 + j] = gg[i][0] * G[j][0] + gg[i][1] * G[j][1] +
+                     gg[i][2] * G[j][2];
+  }
+}
+
+// Tiles per Winograd chunk: the transformed tiles of a chunk, in and out,
+// take about half of L2, and fill whole GEMM blocks.
+int winogradChunk(const ConvIsa &isa, int inPacks, int outPacks) {
+  const size_t perTile =
+      winogradScratch(1, inPacks, outPacks, isa.lanes) * sizeof(float);
+  const int chunk = static_cast<int>(cpuFeatures().l2Bytes / 2 / perTile);
+  return std::max(isa.rows, chunk / isa.rows * isa.rows);
+}
+
+} // namespace
+
+const ConvIsa &convIsa() {
+  static const ConvIsa &isa = []() -> const ConvIsa & {
+#ifdef OMNIFORGE_HAVE_X86_SIMD
+    const CpuFeatures &cpu = cpuFeatures();
+    if (cpu.avx512f)
+      return convIsaAvx512();
+    if (cpu.avx2)
+      return convIsaAvx2();
+#endif
+    return kScalarIsa;
+  }();
+  return isa;
+}
+
+int ConvShape::outWidth(int inW) const {
+  const int extent = dilationW * (kernelW - 1) + 1;
+  if (kind == ConvKind::Deconvolution)
+    return (inW - 1) * strideW + extent + outPadRight - padLeft - padRight;
+  return (inW - extent) / strideW + 1;
+}
+
+int ConvShape::outHeight(int inH) const {
+  const int extent = dilationH * (kernelH - 1) + 1;
+  if (kind == ConvKind::Deconvolution)
+    return (inH - 1) * strideH + extent + outPadBottom - padTop - padBottom;
+  return (inH - extent) / strideH + 1;
+}
+
+bool PackedConv::pack(const ConvShape &shape, const float *weights,
+                      const float *bias, bool rectify, float slope) {
+  const ConvIsa &isa = convIsa();
+  const int lanes = isa.lanes;
+  shape_ = shape;
+  rectify_ = rectify;
+  slope_ = slope;
+  passes_.clear();
+  if (shape.inC <= 0 || shape.outC <= 0 || shape.kernelW <= 0 ||
+      shape.kernelH <= 0 || shape.strideW <= 0 || shape.strideH <= 0 ||
+      shape.dilationW <= 0 || shape.dilationH <= 0 ||
+      shape.kernelW * shape.kernelH > kMaxTaps)
+    return false;
+  // Deconvolutions are split into stride phases, which dilation breaks.
+  if (shape.kind == ConvKind::Deconvolution &&
+      (shape.dilationW != 1 || shape.dilationH != 1))
+    return false;
+
+  const int outPacks = (shape.outC + lanes - 1) / lanes;
+  bias_.assign(size_t(outPacks) * lanes, 0.0f);
+  if (bias)
+    std::copy(bias, bias + shape.outC, bias_.begin());
+
+  const int inC = shape.inC, kw = shape.kernelW, kh = shape.kernelH;
+  auto at = [&](int oc, int ic, int ky, int kx) {
+    return weights[((size_t(oc) * inC + ic) * kh + ky) * kw + kx];
+  };
+
+  if (shape.kind == ConvKind::Convolution) {
+    winograd_ = kw == 3 && kh == 3 && shape.strideW == 1 &&
+                shape.strideH == 1 && shape.dilationW == 1 &&
+                shape.dilationH == 1;
+    Pass pass;
+    if (winograd_) {
+      std::vector<float> u(size_t(shape.outC) * inC * 36);
+      for (size_t k = 0; k < size_t(shape.outC) * inC; ++k)
+        winogradKernel(weights + k * 9, u.data() + k * 36);
+      for (int pos = 0; pos < 36; ++pos)
+        packGemm(
+            isa, shape.outC, inC, 1,
+            [&](int oc, int ic, int) {
+              return u[(size_t(oc) * inC + ic) * 36 + pos];
+            },
+            pass.weights);
+      winogradChunk_ =
+          winogradChunk(isa, (inC + lanes - 1) / lanes, outPacks);
+    } else {
+      pass.tapsX = kw;
+      pass.tapsY = kh;
+      packGemm(
+          isa, shape.outC, inC, kw * kh,
+          [&](int oc, int ic, int t) { return at(oc, ic, t / kw, t % kw); },
+          pass.weights);
+    }
+    passes_.push_back(std::move(pass));
+    return true;
+  }
+
+  // Output phase (px, py) of a deconvolution, counted in the uncropped
+  // output, only sees the taps k = p, p + stride, ...; each phase is a
+  // small stride-1 convolution of the input.
+  winograd_ = false;
+  const int sw = shape.strideW, sh = shape.strideH;
+  for (int py = 0; py < sh; ++py) {
+    for (int px = 0; px < sw; ++px) {
+      Pass pass;
+      pass.phaseX = px;
+      pass.phaseY = py;
+      pass.tapsX = px < kw ? (kw - px + sw - 1) / sw : 0;
+      pass.tapsY = py < kh ? (kh - py + sh - 1) / sh : 0;
+      if (pass.tapsX > 0 && pass.tapsY > 0) {
+        const int tx = pass.tapsX;
+        packGemm(
+            isa, shape.outC, inC, tx * pass.tapsY,
+            [&](int oc, int ic, int t) {
+              return at(oc, ic, py + t / tx * sh, px + t % tx * sw);
+            },
+            pass.weights);
+      }
+      passes_.push_back(std::move(pass));
+    }
+  }
+  return true;
+}
+
+bool PackedConv::run(const BlobView &in, const BlobView &out) const {
+  const ConvIsa &isa = convIsa();
+  const int lanes = isa.lanes;
+  if (in.lanes != lanes || out.lanes != lanes || in.c != shape_.inC ||
+      out.c != shape_.outC || out.w != shape_.outWidth(in.w) ||
+      out.h != shape_.outHeight(in.h) || out.w <= 0 || out.h <= 0)
+    return false;
+  if (shape_.kind == ConvKind::Deconvolution)
+    return runDeconv(in, out);
+
+  if (winograd_) {
+    WinogradPass p;
+    p.weights = passes_[0].weights.data();
+    p.bias = bias_.data();
+    p.rectify = rectify_;
+    p.slope = slope_;
+    p.chunk = std::min(winogradChunk_, ((out.w + 3) / 4) * ((out.h + 3) / 4));
+    FramePool::Handle scratch = FramePool::shared().acquireBytes(
+        winogradScratch(p.chunk, in.packs(), out.packs(), lanes) *
+        sizeof(float));
+    if (!scratch)
+      return false;
+    isa.winograd(p, in, out, reinterpret_cast<float *>(scratch.data()));
+    return true;
+  }
+
+  const Pass &pass = passes_[0];
+  std::array<ptrdiff_t, kMaxTaps> taps;
+  for (int ky = 0; ky < pass.tapsY; ++ky) {
+    for (int kx = 0; kx < pass.tapsX; ++kx)
+      taps[ky * pass.tapsX + kx] =
+          (ptrdiff_t(ky) * shape_.dilationH * in.w + kx * shape_.dilationW) *
+          lanes;
+  }
+  GemmPass g;
+  g.weights = pass.weights.data();
+  g.bias = bias_.data();
+  g.rectify = rectify_;
+  g.slope = slope_;
+  g.taps = taps.data();
+  g.tapCount = pass.tapsX * pass.tapsY;
+  g.inPacks = in.packs();
+  g.inLanes = in.c - (g.inPacks - 1) * lanes;
+  g.inPackStride = in.packStride;
+  g.in = in.data;
+  g.inRowStep = ptrdiff_t(shape_.strideH) * in.w * lanes;
+  g.inColStep = ptrdiff_t(shape_.strideW) * lanes;
+  g.outPacks = out.packs();
+  g.outPackStride = out.packStride;
+  g.out = out.data;
+  g.outRowStep = ptrdiff_t(out.w) * lanes;
+  g.outColStep = lanes;
+  g.rows = out.h;
+  g.cols = out.w;
+  isa.gemm(g);
+  return true;
+}
+
+bool PackedConv::runDeconv(const BlobView &in, const BlobView &out) const {
+  const ConvIsa &isa = convIsa();
+  const int lanes = isa.lanes;
+  const int sw = shape_.strideW, sh = shape_.strideH;
+
+  // Input rows and columns the phases reach; anything outside the blob
+  // contributes nothing, so the input is zero-padded to cover it.
+  struct Range {
+    int first, last; // grid positions m: output m * stride + phase - pad
+  };
+  auto range = [](int phase, int pad, int stride, int outSize) {
+    return Range{floorDiv(pad - phase + stride - 1, stride),
+                 floorDiv(outSize - 1 + pad - phase, stride)};
+  };
+  int padL = 0, padT = 0, padR = 0, padB = 0;
+  for (const Pass &pass : passes_) {
+    const Range rx = range(pass.phaseX, shape_.padLeft, sw, out.w);
+    const Range ry = range(pass.phaseY, shape_.padTop, sh, out.h);
+    if (rx.first > rx.last || ry.first > ry.last || pass.weights.empty())
+      continue;
+    padL = std::max(padL, pass.tapsX - 1 - rx.first);
+    padT = std::max(padT, pass.tapsY - 1 - ry.first);
+    padR = std::max(padR, rx.last - (in.w - 1));
+    padB = std::max(padB, ry.last - (in.h - 1));
+  }
+
+  BlobView src = in;
+  FramePool::Handle padded;
+  if (padL > 0 || padT > 0 || padR > 0 || padB > 0) {
+    src.w = in.w + padL + padR;
+    src.h = in.h + padT + padB;
+    src.packStride = blobPackStride(src.w, src.h, lanes);
+    padded = FramePool::shared().acquireBytes(src.packStride * in.packs() *
+                                              sizeof(float));
+    if (!padded)
+      return false;
+    src.data = reinterpret_cast<float *>(padded.data());
+    std::memset(src.data, 0, src.packStride * in.packs() * sizeof(float));
+    for (int p = 0; p < in.packs(); ++p) {
+      for (int y = 0; y < in.h; ++y)
+        std::memcpy(src.at(p, y + padT, padL), in.at(p, y, 0),
+                    size_t(in.w) * lanes * sizeof(float));
+    }
+  }
+
+  std::array<ptrdiff_t, kMaxTaps> taps;
+  for (const Pass &pass : passes_) {
+    const Range rx = range(pass.phaseX, shape_.padLeft, sw, out.w);
+    const Range ry = range(pass.phaseY, shape_.padTop, sh, out.h);
+    if (rx.first > rx.last || ry.first > ry.last)
+      continue;
+    const int ox = rx.first * sw + pass.phaseX - shape_.padLeft;
+    const int oy = ry.first * sh + pass.phaseY - shape_.padTop;
+
+    if (pass.weights.empty()) {
+      // No tap lands on this phase: bias only.
+      for (int p = 0; p < out.packs(); ++p) {
+        std::vector<float> v(bias_.begin() + p * lanes,
+                             bias_.begin() + (p + 1) * lanes);
+        for (float &b : v)
+          b = rectify_ && b < 0.0f ? b * slope_ : b;
+        for (int y = oy; y < out.h; y += sh) {
+          for (int x = ox; x < out.w; x += sw)
+            std::memcpy(out.at(p, y, x), v.data(),
+                        size_t(lanes) * sizeof(float));
+        }
+      }
+      continue;
+    }
+
+    // Tap (jy, jx) reads input (m - jy, m - jx) for grid position m.
+    for (int jy = 0; jy < pass.tapsY; ++jy) {
+      for (int jx = 0; jx < pass.tapsX; ++jx)
+        taps[jy * pass.tapsX + jx] = -(ptrdiff_t(jy) * src.w + jx) * lanes;
+    }
+    GemmPass g;
+    g.weights = pass.weights.data();
+    g.bias = bias_.data();
+    g.rectify = rectify_;
+    g.slope = slope_;
+    g.taps = taps.data();
+    g.tapCount = pass.tapsX * pass.tapsY;
+    g.inPacks = src.packs();
+    g.inLanes = src.c - (g.inPacks - 1) * lanes;
+    g.inPackStride = src.packStride;
+    g.in = src.at(0, ry.first + padT, rx.first + padL);
+    g.inRowStep = ptrdiff_t(src.w) * lanes;
+    g.inColStep = lanes;
+    g.outPacks = out.packs();
+    g.outPackStride = out.packStride;
+    g.out = out.at(0, oy, ox);
+    g.outRowStep = ptrdiff_t(sh) * out.w * lanes;
+    g.outColStep = ptrdiff_t(sw) * lanes;
+    g.rows = ry.last - ry.first + 1;
+    g.cols = rx.last - rx.first + 1;
+    isa.gemm(g);
+  }
+  return true;
+}
@@ -0,0 +1,157 @@
+#pragma once
+// cpu_conv.h
+// Convolution kernels of the built-in CPU engine (cpu_net.cpp): 3x3
+// convolutions through Winograd F(4x4, 3x3), everything else as a packed
+// GEMM, with bias and (leaky) ReLU applied as results leave the registers.
+// Built once per ISA like the FSR kernels; convIsa() picks the widest one
+// the host runs, and weights are packed for that build's register blocking.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A blob in the engine's layout: channels in packs of `lanes` floats (one
+// SIMD register), each pack a plane of h rows of w pixels. Lanes past `c`
+// in the last pack are zero or at least finite: every weight that reads
+// them is zero.
+struct BlobView {
+  float *data = nullptr;
+  int w = 0;
+  int h = 0;
+  int c = 0;
+  int lanes = 0;
+  size_t packStride = 0; // floats between pack planes
+
+  int packs() const { return (c + lanes - 1) / lanes; }
+  float *pack(int p) const { return data + size_t(p) * packStride; }
+  float *at(int p, int y, int x) const {
+    return pack(p) + (size_t(y) * w + x) * lanes;
+  }
+};
+
+// Floats a pack plane of w x h pixels takes, rounded to whole cache lines.
+inline size_t blobPackStride(int w, int h, int lanes) {
+  return (size_t(w) * h * lanes + 15) & ~size_t(15);
+}
+
+enum class ConvKind : uint8_t { Convolution, Deconvolution };
+
+// Geometry of a convolution, or of a deconvolution (transposed
+// convolution) in ncnn's convention: the full output is cropped by the
+// pads afterwards and grown by outPad on the right and bottom.
+struct ConvShape {
+  ConvKind kind = ConvKind::Convolution;
+  int inC = 0;
+  int outC = 0;
+  int kernelW = 1, kernelH = 1;
+  int strideW = 1, strideH = 1;
+  int dilationW = 1, dilationH = 1;
+  // Deconvolution only: convolutions are given an already padded input.
+  int padLeft = 0, padTop = 0;
+  int padRight = 0, padBottom = 0;
+  int outPadRight = 0, outPadBottom = 0;
+
+  int outWidth(int inW) const;
+  int outHeight(int inH) const;
+};
+
+// Weights of one convolution layer packed for convIsa(), with bias and
+// activation. Immutable once packed, so any number of threads may run it.
+class PackedConv {
+public:
+  // `weights` in ncnn order (outC x inC x kernelH x kernelW, for both
+  // kinds), `bias` outC floats or null. `slope` is the negative slope of
+  // the fused rectifier (0 for ReLU) if `rectify` is set.
+  bool pack(const ConvShape &shape, const float *weights, const float *bias,
+            bool rectify, float slope);
+
+  const ConvShape &shape() const { return shape_; }
+  bool winograd() const { return winograd_; }
+
+  // `out` must be outWidth(in.w) x outHeight(in.h) x outC. Single-threaded;
+  // scratch comes from FramePool. False if that runs out of memory.
+  bool run(const BlobView &in, const BlobView &out) const;
+
+private:
+  // One packed-GEMM pass: a deconvolution has one per output phase.
+  struct Pass {
+    std::vector<float> weights;
+    int tapsX = 0, tapsY = 0;
+    int phaseX = 0, phaseY = 0;
+  };
+
+  bool runDeconv(const BlobView &in, const BlobView &out) const;
+
+  ConvShape shape_;
+  bool winograd_ = false;
+  bool rectify_ = false;
+  float slope_ = 0.0f;
+  int winogradChunk_ = 0;
+  std::vector<float> bias_; // padded to whole packs
+  std::vector<Pass> passes_;
+};
+
+// --- ISA builds ---------------------------------------------------------
+
+// Packed weight layout: output channels in blocks of `vecs` packs (fewer
+// in the last block); per block, K = taps x inPacks x lanes rows of
+// (block packs x lanes) floats, rows ordered tap, input pack, lane.
+
+// One packed-GEMM pass over a rows x cols grid of output pixels. The input
+// pixel of grid position (i, j) is at in + i * inRowStep + j * inColStep;
+// the kernel sums `taps` offsets from it over all input channels.
+struct GemmPass {
+  const float *weights = nullptr;
+  const float *bias = nullptr; // whole packs, or null
+  bool rectify = false;
+  float slope = 0.0f;
+
+  const ptrdiff_t *taps = nullptr;
+  int tapCount = 0;
+  int inPacks = 0;
+  int inLanes = 0; // channels used in the last input pack
+  size_t inPackStride = 0;
+  const float *in = nullptr;
+  ptrdiff_t inRowStep = 0, inColStep = 0;
+
+  int outPacks = 0;
+  size_t outPackStride = 0;
+  float *out = nullptr;
+  ptrdiff_t outRowStep = 0, outColStep = 0;
+
+  int rows = 0, cols = 0;
+};
+
+// A 3x3 stride-1 convolution of an already padded input. `weights` holds
+// the 36 transformed GEMMs (one tap each) in turn; tiles are transformed
+// `chunk` at a time through scratch, winogradScratch() floats.
+struct WinogradPass {
+  const float *weights = nullptr;
+  const float *bias = nullptr;
+  bool rectify = false;
+  float slope = 0.0f;
+  int chunk = 0;
+};
+
+struct ConvIsa {
+  const char *name;
+  int lanes;
+  int vecs; // output packs per GEMM block
+  int rows; // output pixels per GEMM block
+  void (*gemm)(const GemmPass &pass);
+  void (*winograd)(const WinogradPass &pass, const BlobView &in,
+                   const BlobView &out, float *scratch);
+};
+
+// The widest build the host supports, chosen once.
+const ConvIsa &convIsa();
+
+inline size_t winogradScratch(int chunk, int inPacks, int outPacks,
+                              int lanes) {
+  return size_t(36) * chunk * (inPacks + outPacks) * lanes;
+}
+
+#ifdef OMNIFORGE_HAVE_X86_SIMD
+const ConvIsa &convIsaAvx2();
+const ConvIsa &convIsaAvx512();
+#endif
@@ -0,0 +1,44 @@
+// cpu_conv_avx2.cpp
+// AVX2/FMA build of the built-in engine's convolutions: channels in packs
+// of 8, GEMM blocks of 6 pixels by 16 output channels. Compiled with AVX2
+// enabled for this file only; cpu_conv.cpp calls into it after checking
+// cpuFeatures().
+
+#include <immintrin.h>
+
+#include "cpu_conv.h"
+
+namespace {
+
+struct Avx2 {
+  static constexpr int kLanes = 8;
+  static constexpr int kRows = 6;
+  static constexpr int kVecs = 2;
+
+  struct F {
+    __m256 v;
+    friend F operator+(F a, F b) { return {_mm256_add_ps(a.v, b.v)}; }
+    friend F operator-(F a, F b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    friend F operator*(F a, F b) { return {_mm256_mul_ps(a.v, b.v)}; }
+  };
+
+  static F zero() { return {_mm256_setzero_ps()}; }
+  static F splat(float f) { return {_mm256_set1_ps(f)}; }
+  static F load(const float *p) { return {_mm256_loadu_ps(p)}; }
+  static F broadcast(const float *p) { return {_mm256_broadcast_ss(p)}; }
+  static void store(float *p, F a) { _mm256_storeu_ps(p, a.v); }
+  static F fma(F a, F b, F c) { return {_mm256_fmadd_ps(a.v, b.v, c.v)}; }
+  static F min(F a, F b) { return {_mm256_min_ps(a.v, b.v)}; }
+  static F max(F a, F b) { return {_mm256_max_ps(a.v, b.v)}; }
+};
+
+} // namespace
+
+#include "cpu_conv_kernel.h"
+
+const ConvIsa &convIsaAvx2() {
+  static const ConvIsa isa = {"avx2",         Avx2::kLanes,
+                              Avx2::kVecs,    Avx2::kRows,
+                              gemmPass<Avx2>, winogradPass<Avx2>};
+  return isa;
+}
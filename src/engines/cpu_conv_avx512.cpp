@@ -0,0 +1,52 @@
+// cpu_conv_avx512.cpp
+// AVX-512 build of the built-in engine's convolutions: channels in packs
+// of 16, GEMM blocks of 12 pixels by 32 output channels, using 24 of the 32
+// registers for accumulators. Compiled with AVX-512F enabled for this file
+// only; cpu_conv.cpp calls into it after checking cpuFeatures().
+
+#include <immintrin.h>
+
+#include "cpu_conv.h"
+
+namespace {
+
+struct Avx512 {
+  static constexpr int kLanes = 16;
+  static constexpr int kRows = 12;
+  static constexpr int kVecs = 2;
+
+  struct F {
+    __m512 v;
+    friend F operator+(F a, F b) { return {_mm512_add_ps(a.v, b.v)}; }
+    friend F operator-(F a, F b) { return {_mm512_sub_ps(a.v, b.v)}; }
+    friend F operator*(F a, F b) { return {_mm512_mul_ps(a.v, b.v)}; }
+  };
+
+  static F zero() { return {_mm512_setzero_ps()}; }
+  static F splat(float f) { return {_mm512_set1_ps(f)}; }
+  static F load(const float *p) { return {_mm512_loadu_ps(p)}; }
+  static F broadcast(const float *p) { return {_mm512_set1_ps(*p)}; }
+  static void store(float *p, F a) { _mm512_storeu_ps(p, a.v); }
+  static F fma(F a, F b, F c) { return {_mm512_fmadd_ps(a.v, b.v, c.v)}; }
+  // Compare and blend rather than _mm512_min_ps/_mm512_max_ps, whose
+  // undefined pass-through operand trips GCC 12's -Wmaybe-uninitialized.
+  static F min(F a, F b) {
+    return {_mm512_mask_blend_ps(_mm512_cmp_ps_mask(b.v, a.v, _CMP_LT_OQ),
+                                 a.v, b.v)};
+  }
+  static F max(F a, F b) {
+    return {_mm512_mask_blend_ps(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ),
+                                 a.v, b.v)};
+  }
+};
+
+} // namespace
+
+#include "cpu_conv_kernel.h"
+
+const ConvIsa &convIsaAvx512() {
+  static const ConvIsa isa = {"avx512",         Avx512::kLanes,
+                              Avx512::kVecs,    Avx512::kRows,
+                              gemmPass<Avx512>, winogradPass<Avx512>};
+  return isa;
+}
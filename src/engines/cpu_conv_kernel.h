@@ -0,0 +1,275 @@
+// cpu_conv_kernel.h
+// Vector-width agnostic body of the built-in engine's convolutions.
+//
+// Only include this from the per-ISA translation units (cpu_conv.cpp,
+// cpu_conv_avx2.cpp, cpu_conv_avx512.cpp), after defining the register
+// traits `S` inside an anonymous namespace:
+//   S::kLanes            floats per register, the blob channel pack
+//   S::kRows, S::kVecs   GEMM register block: kRows output pixels by kVecs
+//                        packs of output channels (kRows * kVecs
+//                        accumulators, plus kVecs weights and a broadcast,
+//                        must fit the register file)
+//   S::F                 register, with +, - and *
+//   zero, splat, load, broadcast (one float to every lane), store, fma
+//   (a * b + c), min, max
+
+#include "cpu_conv.h"
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace {
+
+// Calls fn(std::integral_constant<int, i>) for every i in [0, N). The
+// accumulator arrays below are only indexed through these constants, so
+// the compiler keeps them in registers.
+template <class Fn, int... I>
+inline void unrollWith(Fn &&fn, std::integer_sequence<int, I...>) {
+  (fn(std::integral_constant<int, I>()), ...);
+}
+
+template <int N, class Fn> inline void unroll(Fn &&fn) {
+  unrollWith(fn, std::make_integer_sequence<int, N>());
+}
+
+// The fused (leaky) ReLU.
+template <class S>
+inline typename S::F activate(typename S::F x, bool rectify, float slope) {
+  if (!rectify)
+    return x;
+  const typename S::F zero = S::zero();
+  return S::max(x, zero) + S::splat(slope) * S::min(x, zero);
+}
+
+// R consecutive output pixels of one grid row by V output packs. `w` is the
+// block's packed weights, `bias` its packs of the bias.
+template <class S, int R, int V>
+void gemmBlock(const GemmPass &p, const float *in, float *out,
+               const float *w, const float *bias) {
+  using F = typename S::F;
+  constexpr int L = S::kLanes;
+  F acc[R][V];
+  unroll<R>([&](auto r) {
+    unroll<V>([&](auto v) { acc[r][v] = S::zero(); });
+  });
+
+  for (int t = 0; t < p.tapCount; ++t) {
+    const float *src = in + p.taps[t];
+    for (int ip = 0; ip < p.inPacks; ++ip, src += p.inPackStride) {
+      const int lanes = ip + 1 < p.inPacks ? L : p.inLanes;
+      for (int l = 0; l < lanes; ++l, w += V * L) {
+        F wv[V];
+        unroll<V>([&](auto v) { wv[v] = S::load(w + v * L); });
+        unroll<R>([&](auto r) {
+          const F x = S::broadcast(src + r * p.inColStep + l);
+          unroll<V>([&](auto v) { acc[r][v] = S::fma(x, wv[v], acc[r][v]); });
+        });
+      }
+      // Rows of the unused lanes are zero.
+      w += size_t(L - lanes) * V * L;
+    }
+  }
+
+  unroll<V>([&](auto v) {
+    const F b = bias ? S::load(bias + v * L) : S::zero();
+    float *dst = out + v * p.outPackStride;
+    unroll<R>([&](auto r) {
+      S::store(dst + r * p.outColStep,
+               activate<S>(acc[r][v] + b, p.rectify, p.slope));
+    });
+  });
+}
+
+using GemmBlockFn = void (*)(const GemmPass &, const float *, float *,
+                             const float *, const float *);
+
+// gemmBlock<S, rows, vecs> at [(rows - 1) * kVecs + vecs - 1].
+template <class S, int... I>
+constexpr std::array<GemmBlockFn, sizeof...(I)>
+gemmBlocks(std::integer_sequence<int, I...>) {
+  return {{&gemmBlock<S, I / S::kVecs + 1, I % S::kVecs + 1>...}};
+}
+
+template <class S> void gemmPass(const GemmPass &p) {
+  constexpr int L = S::kLanes, R = S::kRows, V = S::kVecs;
+  static constexpr std::array<GemmBlockFn, R * V> blocks =
+      gemmBlocks<S>(std::make_integer_sequence<int, R * V>());
+  const size_t k = size_t(p.tapCount) * p.inPacks * L;
+
+  // Output blocks outermost: their weights stay in cache while the whole
+  // grid streams past.
+  for (int ob = 0; ob < p.outPacks; ob += V) {
+    const int vecs = std::min(V, p.outPacks - ob);
+    const float *w = p.weights + size_t(ob) * L * k;
+    const float *bias = p.bias ? p.bias + ob * L : nullptr;
+    for (int i = 0; i < p.rows; ++i) {
+      const float *in = p.in + i * p.inRowStep;
+      float *out = p.out + i * p.outRowStep + ob * p.outPackStride;
+      for (int j = 0; j < p.cols; j += R) {
+        const int rows = std::min(R, p.cols - j);
+        blocks[(rows - 1) * V + vecs - 1](p, in + j * p.inColStep,
+                                          out + j * p.outColStep, w, bias);
+      }
+    }
+  }
+}
+
+// --- Winograd F(4x4, 3x3) ----------------------------------------------
+// Lavin & Gray's transforms with interpolation points 0, +-1, +-2 and
+// infinity: a 6x6 input tile d gives B^T d B, the GEMMs multiply it by
+// G g G^T per channel pair (packed in cpu_conv.cpp), and A^T m A is the 4x4
+// output tile.
+
+// B^T applied down one column of six registers.
+template <class S> inline void winogradIn6(typename S::F (&d)[6]) {
+  using F = typename S::F;
+  const F two = S::splat(2.0f), four = S::splat(4.0f),
+          five = S::splat(5.0f);
+  const F a = S::fma(four, d[0], d[4]) - five * d[2];
+  const F b = S::fma(four, d[1], d[5]) - five * d[3];
+  const F c1 = d[4] - four * d[2], c2 = d[3] - four * d[1];
+  const F e1 = d[4] - d[2], e2 = two * (d[3] - d[1]);
+  d[0] = a;
+  d[1] = c1 + c2;
+  d[2] = c1 - c2;
+  d[3] = e1 + e2;
+  d[4] = e1 - e2;
+  d[5] = b;
+}
+
+// A^T applied to six registers, giving four.
+template <class S>
+inline void winogradOut6(const typename S::F (&m)[6], typename S::F (&o)[4]) {
+  using F = typename S::F;
+  const F s1 = m[1] + m[2], d1 = m[1] - m[2];
+  const F s2 = m[3] + m[4], d2 = m[3] - m[4];
+  o[0] = m[0] + s1 + s2;
+  o[1] = S::fma(S::splat(2.0f), d2, d1);
+  o[2] = S::fma(S::splat(4.0f), s2, s1);
+  o[3] = S::fma(S::splat(8.0f), d2, d1) + m[5];
+}
+
+// Transforms the tile of input pack `ip` at (x, y) and scatters its 36
+// values to v + pos * posStride.
+template <class S>
+void winogradInputTile(const BlobView &in, int ip, int x, int y, float *v,
+                       size_t posStride) {
+  using F = typename S::F;
+  constexpr int L = S::kLanes;
+  F d[6][6];
+  if (x + 6 <= in.w && y + 6 <= in.h) {
+    for (int r = 0; r < 6; ++r) {
+      const float *src = in.at(ip, y + r, x);
+      unroll<6>([&](auto c) { d[r][c] = S::load(src + c * L); });
+    }
+  } else {
+    // Right and bottom edge tiles read zeros past the blob.
+    for (int r = 0; r < 6; ++r) {
+      for (int c = 0; c < 6; ++c)
+        d[r][c] = y + r < in.h && x + c < in.w
+                      ? S::load(in.at(ip, y + r, x + c))
+                      : S::zero();
+    }
+  }
+
+  F col[6];
+  for (int c = 0; c < 6; ++c) {
+    unroll<6>([&](auto r) { col[r] = d[r][c]; });
+    winogradIn6<S>(col);
+    unroll<6>([&](auto r) { d[r][c] = col[r]; });
+  }
+  for (int r = 0; r < 6; ++r) {
+    winogradIn6<S>(d[r]);
+    unroll<6>([&](auto c) {
+      S::store(v + size_t(r * 6 + c) * posStride, d[r][c]);
+    });
+  }
+}
+
+// Inverse-transforms output pack `op` of one tile from m + pos * posStride
+// and stores the part of its 4x4 pixels at (x, y) that lies inside `out`.
+template <class S>
+void winogradOutputTile(const WinogradPass &p, const float *m,
+                        size_t posStride, const BlobView &out, int op, int x,
+                        int y) {
+  using F = typename S::F;
+  constexpr int L = S::kLanes;
+  F t[4][6];
+  for (int c = 0; c < 6; ++c) {
+    F col[6], o[4];
+    unroll<6>([&](auto r) {
+      col[r] = S::load(m + size_t(r * 6 + c) * posStride);
+    });
+    winogradOut6<S>(col, o);
+    unroll<4>([&](auto r) { t[r][c] = o[r]; });
+  }
+
+  const F bias = p.bias ? S::load(p.bias + op * L) : S::zero();
+  const int rows = std::min(4, out.h - y), cols = std::min(4, out.w - x);
+  for (int r = 0; r < rows; ++r) {
+    F o[4];
+    winogradOut6<S>(t[r], o);
+    float *dst = out.at(op, y + r, x);
+    if (cols == 4) {
+      unroll<4>([&](auto c) {
+        S::store(dst + c * L, activate<S>(o[c] + bias, p.rectify, p.slope));
+      });
+    } else {
+      for (int c = 0; c < cols; ++c)
+        S::store(dst + c * L, activate<S>(o[c] + bias, p.rectify, p.slope));
+    }
+  }
+}
+
+template <class S>
+void winogradPass(const WinogradPass &p, const BlobView &in,
+                  const BlobView &out, float *scratch) {
+  constexpr int L = S::kLanes;
+  const int inPacks = in.packs(), outPacks = out.packs();
+  const int tilesX = (out.w + 3) / 4, tilesY = (out.h + 3) / 4;
+  const int tiles = tilesX * tilesY;
+  const size_t inWidth = size_t(inPacks) * L, outWidth = size_t(outPacks) * L;
+  float *const v = scratch;
+  float *const m = scratch + size_t(36) * p.chunk * inWidth;
+  const ptrdiff_t tap = 0;
+
+  for (int t0 = 0; t0 < tiles; t0 += p.chunk) {
+    const int n = std::min(p.chunk, tiles - t0);
+    for (int i = 0; i < n; ++i) {
+      const int ty = (t0 + i) / tilesX, tx = (t0 + i) % tilesX;
+      for (int ip = 0; ip < inPacks; ++ip)
+        winogradInputTile<S>(in, ip, 4 * tx, 4 * ty,
+                             v + i * inWidth + ip * L, n * inWidth);
+    }
+
+    // 36 independent GEMMs of the chunk's tiles by the transformed
+    // weights, one per position in the tile.
+    GemmPass g;
+    g.taps = &tap;
+    g.tapCount = 1;
+    g.inPacks = inPacks;
+    g.inLanes = in.c - (inPacks - 1) * L;
+    g.inPackStride = L;
+    g.inColStep = static_cast<ptrdiff_t>(inWidth);
+    g.outPacks = outPacks;
+    g.outPackStride = L;
+    g.outColStep = static_cast<ptrdiff_t>(outWidth);
+    g.rows = 1;
+    g.cols = n;
+    for (int pos = 0; pos < 36; ++pos) {
+      g.weights = p.weights + pos * outWidth * inWidth;
+      g.in = v + pos * n * inWidth;
+      g.out = m + pos * n * outWidth;
+      gemmPass<S>(g);
+    }
+
+    for (int i = 0; i < n; ++i) {
+      const int ty = (t0 + i) / tilesX, tx = (t0 + i) % tilesX;
+      for (int op = 0; op < outPacks; ++op)
+        winogradOutputTile<S>(p, m + i * outWidth + op * L, n * outWidth, out,
+                              op, 4 * tx, 4 * ty);
+    }
+  }
+}
+
+} // namespace
@@ -0,0 +1,903 @@
+// cpu_net.cpp
+// ncnn .param/.bin loading and graph execution for the built-in CPU
+// engine. Convolutions run on cpu_conv.cpp's kernels; the remaining layers
+// are cheap per-pixel passes over the packed blobs.
+
+#include "cpu_net.h"
+#include "../utils/log.h"
+#include "../utils/mapped_file.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace {
+
+constexpr int kParamMagic = 7767517;
+// Shape and offset value ncnn writes for "not set".
+constexpr int kUnset = -233;
+
+enum class LayerKind : uint8_t {
+  Input,
+  Alias, // Split, Noop, Dropout, vector Reshape: the bottom under new names
+  Convolution,
+  Deconvolution,
+  InnerProduct,
+  Activation, // ReLU, Sigmoid, Clip
+  Crop,
+  Eltwise,
+  BinaryOp,
+  Pooling,
+  Scale,
+};
+
+// ncnn's activation_type numbering.
+enum class Activation : uint8_t { None, ReLU, LeakyReLU, Clip, Sigmoid };
+
+// The key=value pairs of one layer line. Array values (keys -23300 - k)
+// are stored under k.
+class ParamDict {
+public:
+  bool parse(const std::string &token) {
+    const size_t eq = token.find('=');
+    if (eq == std::string::npos)
+      return false;
+    int key = std::atoi(token.substr(0, eq).c_str());
+    std::vector<double> &values = values_[key <= -23300 ? -23300 - key : key];
+    const char *p = token.c_str() + eq + 1;
+    char *end = nullptr;
+    if (key <= -23300) {
+      const long count = std::strtol(p, &end, 10);
+      for (long i = 0; i < count && *end == ','; ++i) {
+        p = end + 1;
+        values.push_back(std::strtod(p, &end));
+      }
+      return values.size() == size_t(std::max(0L, count));
+    }
+    values.push_back(std::strtod(p, &end));
+    return end != p;
+  }
+
+  int i(int key, int def) const {
+    auto it = values_.find(key);
+    return it == values_.end() || it->second.empty()
+               ? def
+               : static_cast<int>(it->second[0]);
+  }
+  float f(int key, float def) const {
+    auto it = values_.find(key);
+    return it == values_.end() || it->second.empty()
+               ? def
+               : static_cast<float>(it->second[0]);
+  }
+  std::vector<int> ints(int key) const {
+    std::vector<int> out;
+    auto it = values_.find(key);
+    if (it != values_.end()) {
+      for (double v : it->second)
+        out.push_back(static_cast<int>(v));
+    }
+    return out;
+  }
+  std::vector<float> floats(int key) const {
+    std::vector<float> out;
+    auto it = values_.find(key);
+    if (it != values_.end()) {
+      for (double v : it->second)
+        out.push_back(static_cast<float>(v));
+    }
+    return out;
+  }
+
+private:
+  std::map<int, std::vector<double>> values_;
+};
+
+float halfToFloat(uint16_t h) {
+  const uint32_t sign = uint32_t(h & 0x8000u) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1fu, mantissa = h & 0x3ffu;
+  uint32_t bits;
+  if (exponent == 0) {
+    const float f = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+    std::memcpy(&bits, &f, sizeof(bits));
+    bits |= sign;
+  } else if (exponent == 31) {
+    bits = sign | 0x7f800000u | mantissa << 13;
+  } else {
+    bits = sign | (exponent + 112) << 23 | mantissa << 13;
+  }
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// Sequential reader over a .bin in ncnn's ModelBin layout.
+class WeightReader {
+public:
+  WeightReader(const uint8_t *data, size_t size)
+      : p_(data), end_(data + size) {}
+
+  // `count` weights. Layer weights are `tagged` with their encoding (fp32,
+  // fp16 or a 256-entry table); biases and scales are plain fp32.
+  bool read(size_t count, bool tagged, std::vector<float> &out) {
+    out.resize(count);
+    uint32_t tag = 0;
+    if (tagged && !take(&tag, sizeof(tag)))
+      return false;
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&tag);
+    if (tag == 0x01306B47u) {
+      std::vector<uint16_t> halves(count);
+      if (!take(halves.data(), count * 2) || !skip(count * 2))
+        return false;
+      std::transform(halves.begin(), halves.end(), out.begin(), halfToFloat);
+      return true;
+    }
+    if (tag == 0x000D4B38u) {
+      OMNIFORGE_LOG_ERROR("cpu_net: int8 weights need the ncnn engine.");
+      return false;
+    }
+    if (tag != 0x0002C056u && bytes[0] + bytes[1] + bytes[2] + bytes[3]) {
+      float table[256];
+      std::vector<uint8_t> index(count);
+      if (!take(table, sizeof(table)) || !take(index.data(), count) ||
+          !skip(count))
+        return false;
+      for (size_t i = 0; i < count; ++i)
+        out[i] = table[index[i]];
+      return true;
+    }
+    return take(out.data(), count * sizeof(float));
+  }
+
+private:
+  bool take(void *dst, size_t bytes) {
+    if (size_t(end_ - p_) < bytes)
+      return false;
+    std::memcpy(dst, p_, bytes);
+    p_ += bytes;
+    return true;
+  }
+  // Padding after `bytes` of 8- or 16-bit data, to the next 4 bytes.
+  bool skip(size_t bytes) {
+    const size_t pad = (4 - bytes % 4) % 4;
+    if (size_t(end_ - p_) < pad)
+      return false;
+    p_ += pad;
+    return true;
+  }
+
+  const uint8_t *p_;
+  const uint8_t *end_;
+};
+
+float activate(float x, Activation act, float a, float b) {
+  switch (act) {
+  case Activation::ReLU:
+    return x < 0.0f ? 0.0f : x;
+  case Activation::LeakyReLU:
+    return x < 0.0f ? x * a : x;
+  case Activation::Clip:
+    return std::min(std::max(x, a), b);
+  case Activation::Sigmoid:
+    return 1.0f / (1.0f + std::exp(-x));
+  default:
+    return x;
+  }
+}
+
+// Floats of pack plane p that hold pixels (the rest is alignment).
+size_t planeFloats(const BlobView &b) { return size_t(b.w) * b.h * b.lanes; }
+
+bool sameShape(const BlobView &a, const BlobView &b) {
+  return a.w == b.w && a.h == b.h && a.c == b.c;
+}
+
+// Calls fn with BinaryOp `op` as a function object, so the loops below
+// are compiled once per operation.
+template <class Fn> bool withBinaryOp(int op, Fn fn) {
+  switch (op) {
+  case 0:
+    return fn([](float x, float y) { return x + y; });
+  case 1:
+    return fn([](float x, float y) { return x - y; });
+  case 2:
+    return fn([](float x, float y) { return x * y; });
+  case 3:
+    return fn([](float x, float y) { return x / y; });
+  case 4:
+    return fn([](float x, float y) { return std::max(x, y); });
+  case 5:
+    return fn([](float x, float y) { return std::min(x, y); });
+  case 6:
+    return fn([](float x, float y) { return std::pow(x, y); });
+  case 7:
+    return fn([](float x, float y) { return y - x; });
+  case 8:
+    return fn([](float x, float y) { return y / x; });
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+bool NetBlob::create(int w, int h, int c) {
+  reset();
+  if (w <= 0 || h <= 0 || c <= 0)
+    return false;
+  BlobView v;
+  v.w = w;
+  v.h = h;
+  v.c = c;
+  v.lanes = convIsa().lanes;
+  v.packStride = blobPackStride(w, h, v.lanes);
+  memory_ = FramePool::shared().acquireBytes(v.packStride * v.packs() *
+                                             sizeof(float));
+  if (!memory_)
+    return false;
+  v.data = reinterpret_cast<float *>(memory_.data());
+  view_ = v;
+  return true;
+}
+
+void NetBlob::reset() {
+  memory_.reset();
+  view_ = BlobView();
+}
+
+struct CpuNet::Layer {
+  LayerKind kind = LayerKind::Input;
+  std::string type;
+  std::string name;
+  std::vector<int> bottoms;
+  std::vector<int> tops;
+
+  // Convolution, Deconvolution, InnerProduct. The weights are kept as read
+  // until activations are fused, then packed into `conv`.
+  ConvShape shape;
+  PackedConv conv;
+  std::vector<float> weights;
+  std::vector<float> bias;
+  int padLeft = 0, padRight = 0, padTop = 0, padBottom = 0;
+  float padValue = 0.0f;
+
+  // The layer's own activation, or the one fused into it.
+  Activation act = Activation::None;
+  float actA = 0.0f, actB = 0.0f;
+
+  // Crop: offsets and sizes per axis (c, h, w); size 0 is the rest of the
+  // blob minus offsetEnd. Or ncnn's starts/ends/axes form.
+  int offset[3] = {};
+  int size[3] = {};
+  int offsetEnd[3] = {};
+  std::vector<int> starts, ends, axes;
+
+  // Eltwise, BinaryOp and Pooling operation; Eltwise sum coefficients.
+  int op = 0;
+  std::vector<float> coeffs;
+  bool withScalar = false;
+  float scalar = 0.0f;
+
+  bool loadParams(const ParamDict &pd);
+  bool loadWeights(WeightReader &reader);
+  bool forward(const std::vector<BlobView> &blobs, NetBlob &out) const;
+
+  bool forwardConv(const BlobView &in, NetBlob &out) const;
+  bool forwardCrop(const std::vector<BlobView> &blobs, NetBlob &out) const;
+  bool forwardBinary(const std::vector<BlobView> &blobs, NetBlob &out) const;
+};
+
+bool CpuNet::Layer::loadParams(const ParamDict &pd) {
+  if (type == "Input") {
+    kind = LayerKind::Input;
+    return bottoms.empty();
+  }
+  if (type == "Split" || type == "Noop" || type == "Dropout") {
+    kind = LayerKind::Alias;
+    return bottoms.size() == 1;
+  }
+  if (type == "Reshape") {
+    // Only between a channel vector and its 1D form, which share a layout
+    // here; checked again on the actual blob in forward().
+    kind = LayerKind::Alias;
+    const int w = pd.i(0, kUnset), h = pd.i(1, kUnset);
+    return bottoms.size() == 1 && pd.i(3, 0) == 0 &&
+           ((h == kUnset && pd.i(2, kUnset) == kUnset) || (w == 1 && h == 1));
+  }
+  if (type == "Convolution" || type == "Deconvolution" ||
+      type == "InnerProduct") {
+    const bool inner = type == "InnerProduct";
+    kind = inner ? LayerKind::InnerProduct
+           : type == "Convolution" ? LayerKind::Convolution
+                                   : LayerKind::Deconvolution;
+    shape.kind = kind == LayerKind::Deconvolution ? ConvKind::Deconvolution
+                                                  : ConvKind::Convolution;
+    shape.outC = pd.i(0, 0);
+    if (!inner) {
+      shape.kernelW = pd.i(1, 0);
+      shape.kernelH = pd.i(11, shape.kernelW);
+      shape.dilationW = pd.i(2, 1);
+      shape.dilationH = pd.i(12, shape.dilationW);
+      shape.strideW = pd.i(3, 1);
+      shape.strideH = pd.i(13, shape.strideW);
+      padLeft = pd.i(4, 0);
+      padRight = pd.i(15, padLeft);
+      padTop = pd.i(14, padLeft);
+      padBottom = pd.i(16, padTop);
+    }
+    const int biasTerm = inner ? pd.i(1, 0) : pd.i(5, 0);
+    const int weightCount = inner ? pd.i(2, 0) : pd.i(6, 0);
+    if (shape.outC <= 0 || shape.kernelW <= 0 || shape.kernelH <= 0 ||
+        weightCount % (shape.outC * shape.kernelW * shape.kernelH) != 0 ||
+        pd.i(8, 0) != 0 || padLeft < 0 || padRight < 0 || padTop < 0 ||
+        padBottom < 0)
+      return false; // int8 or SAME padding
+    if (kind == LayerKind::Convolution && pd.i(19, 0) != 0)
+      return false; // weights from a second input
+    shape.inC = weightCount / (shape.outC * shape.kernelW * shape.kernelH);
+    weights.resize(size_t(weightCount));
+    bias.resize(biasTerm ? size_t(shape.outC) : 0);
+    if (kind == LayerKind::Convolution) {
+      padValue = pd.f(18, 0.0f);
+    } else if (kind == LayerKind::Deconvolution) {
+      shape.padLeft = padLeft;
+      shape.padRight = padRight;
+      shape.padTop = padTop;
+      shape.padBottom = padBottom;
+      shape.outPadRight = pd.i(18, 0);
+      shape.outPadBottom = pd.i(19, shape.outPadRight);
+      padLeft = padRight = padTop = padBottom = 0;
+      if (pd.i(20, 0) > 0 || pd.i(21, 0) > 0)
+        return false; // explicit output size
+    }
+    const std::vector<float> params = pd.floats(10);
+    act = static_cast<Activation>(pd.i(9, 0));
+    actA = params.size() > 0 ? params[0] : 0.0f;
+    actB = params.size() > 1 ? params[1] : 0.0f;
+    return act <= Activation::Sigmoid;
+  }
+  if (type == "ReLU" || type == "Sigmoid" || type == "Clip") {
+    kind = LayerKind::Activation;
+    if (type == "ReLU") {
+      actA = pd.f(0, 0.0f);
+      act = actA == 0.0f ? Activation::ReLU : Activation::LeakyReLU;
+    } else if (type == "Clip") {
+      act = Activation::Clip;
+      actA = pd.f(0, -INFINITY);
+      actB = pd.f(1, INFINITY);
+    } else {
+      act = Activation::Sigmoid;
+    }
+    return bottoms.size() == 1;
+  }
+  if (type == "Crop") {
+    kind = LayerKind::Crop;
+    // ncnn orders these w, h, c; stored here c, h, w.
+    offset[0] = pd.i(2, 0);
+    offset[1] = pd.i(1, 0);
+    offset[2] = pd.i(0, 0);
+    size[0] = pd.i(5, 0);
+    size[1] = pd.i(4, 0);
+    size[2] = pd.i(3, 0);
+    offsetEnd[0] = pd.i(8, 0);
+    offsetEnd[1] = pd.i(7, 0);
+    offsetEnd[2] = pd.i(6, 0);
+    starts = pd.ints(9);
+    ends = pd.ints(10);
+    axes = pd.ints(11);
+    return (bottoms.size() == 1 || bottoms.size() == 2) &&
+           starts.size() == ends.size() &&
+           (axes.empty() || axes.size() == starts.size());
+  }
+  if (type == "Eltwise") {
+    kind = LayerKind::Eltwise;
+    op = pd.i(0, 1);
+    coeffs = pd.floats(1);
+    return op >= 0 && op <= 2 && !bottoms.empty() &&
+           (coeffs.empty() || coeffs.size() == bottoms.size());
+  }
+  if (type == "BinaryOp") {
+    kind = LayerKind::BinaryOp;
+    op = pd.i(0, 0);
+    withScalar = pd.i(1, 0) != 0;
+    scalar = pd.f(2, 0.0f);
+    return op >= 0 && op <= 8 && bottoms.size() == (withScalar ? 1u : 2u);
+  }
+  if (type == "Pooling") {
+    kind = LayerKind::Pooling;
+    op = pd.i(0, 0);
+    // cunet only pools globally (its squeeze-and-excitation blocks).
+    return (op == 0 || op == 1) && pd.i(4, 0) != 0 && bottoms.size() == 1;
+  }
+  if (type == "Scale") {
+    kind = LayerKind::Scale;
+    const int count = pd.i(0, 0);
+    weights.resize(count == kUnset ? 0 : size_t(std::max(0, count)));
+    bias.resize(pd.i(1, 0) ? size_t(std::max(0, count)) : 0);
+    return count == kUnset ? bottoms.size() == 2
+                           : count > 0 && bottoms.size() == 1;
+  }
+  return false;
+}
+
+bool CpuNet::Layer::loadWeights(WeightReader &reader) {
+  switch (kind) {
+  case LayerKind::Convolution:
+  case LayerKind::Deconvolution:
+  case LayerKind::InnerProduct:
+    return reader.read(weights.size(), true, weights) &&
+           reader.read(bias.size(), false, bias);
+  case LayerKind::Scale:
+    return reader.read(weights.size(), false, weights) &&
+           reader.read(bias.size(), false, bias);
+  default:
+    return true;
+  }
+}
+
+bool CpuNet::Layer::forwardConv(const BlobView &in, NetBlob &out) const {
+  if (in.c != shape.inC)
+    return false;
+  if (kind == LayerKind::InnerProduct && (in.w != 1 || in.h != 1))
+    return false; // only on channel vectors
+
+  BlobView src = in;
+  NetBlob padded;
+  if (padLeft || padRight || padTop || padBottom) {
+    if (!padded.create(in.w + padLeft + padRight, in.h + padTop + padBottom,
+                       in.c))
+      return false;
+    src = padded.view();
+    for (int p = 0; p < src.packs(); ++p) {
+      std::fill(src.pack(p), src.pack(p) + planeFloats(src), padValue);
+      for (int y = 0; y < in.h; ++y)
+        std::memcpy(src.at(p, y + padTop, padLeft), in.at(p, y, 0),
+                    size_t(in.w) * in.lanes * sizeof(float));
+    }
+  }
+
+  if (!out.create(shape.outWidth(src.w), shape.outHeight(src.h), shape.outC) ||
+      !conv.run(src, out.view()))
+    return false;
+  // Activations the kernels do not fuse.
+  if (act == Activation::Clip || act == Activation::Sigmoid) {
+    const BlobView &o = out.view();
+    for (int p = 0; p < o.packs(); ++p) {
+      float *d = o.pack(p);
+      for (size_t i = 0; i < planeFloats(o); ++i)
+        d[i] = activate(d[i], act, actA, actB);
+    }
+  }
+  return true;
+}
+
+bool CpuNet::Layer::forwardCrop(const std::vector<BlobView> &blobs,
+                                NetBlob &out) const {
+  const BlobView &in = blobs[bottoms[0]];
+  const int dims[3] = {in.c, in.h, in.w};
+  int begin[3], end[3];
+  if (!starts.empty()) {
+    for (int a = 0; a < 3; ++a) {
+      begin[a] = 0;
+      end[a] = dims[a];
+    }
+    for (size_t k = 0; k < starts.size(); ++k) {
+      int axis = axes.empty() ? static_cast<int>(k) : axes[k];
+      axis = axis < 0 ? axis + 3 : axis;
+      if (axis < 0 || axis > 2)
+        return false;
+      const int dim = dims[axis];
+      int s = starts[k], e = ends[k];
+      s = s < 0 ? s + dim : s;
+      e = e < 0 ? e + dim : e;
+      begin[axis] = std::min(std::max(s, 0), dim);
+      end[axis] = std::min(std::max(e, 0), dim);
+    }
+  } else {
+    for (int a = 0; a < 3; ++a) {
+      begin[a] = offset[a];
+      end[a] = size[a] > 0 ? offset[a] + size[a] : dims[a] - offsetEnd[a];
+    }
+    if (bottoms.size() == 2) {
+      // Cropped to the reference blob's extent.
+      const BlobView &ref = blobs[bottoms[1]];
+      end[0] = offset[0] + std::min(ref.c, in.c - offset[0]);
+      end[1] = offset[1] + ref.h;
+      end[2] = offset[2] + ref.w;
+    }
+  }
+  for (int a = 0; a < 3; ++a) {
+    if (begin[a] < 0 || end[a] > dims[a] || begin[a] >= end[a])
+      return false;
+  }
+
+  const int c0 = begin[0], y0 = begin[1], x0 = begin[2];
+  if (!out.create(end[2] - x0, end[1] - y0, end[0] - c0))
+    return false;
+  const BlobView &o = out.view();
+  const int lanes = o.lanes;
+  for (int p = 0; p < o.packs(); ++p) {
+    for (int y = 0; y < o.h; ++y) {
+      if (c0 % lanes == 0) {
+        std::memcpy(o.at(p, y, 0), in.at(p + c0 / lanes, y0 + y, x0),
+                    size_t(o.w) * lanes * sizeof(float));
+        continue;
+      }
+      // Channel offset inside a pack: move lane by lane.
+      for (int x = 0; x < o.w; ++x) {
+        float *d = o.at(p, y, x);
+        for (int l = 0; l < lanes; ++l) {
+          const int c = c0 + p * lanes + l;
+          d[l] = p * lanes + l < o.c
+                     ? in.at(c / lanes, y0 + y, x0 + x)[c % lanes]
+                     : 0.0f;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool CpuNet::Layer::forwardBinary(const std::vector<BlobView> &blobs,
+                                  NetBlob &out) const {
+  BlobView a = blobs[bottoms[0]], b;
+  int opCode = op;
+  if (!withScalar) {
+    b = blobs[bottoms[1]];
+    // Broadcasting is per channel (or scalar) from the second operand;
+    // swap operands to get there.
+    const bool aSmall = a.w == 1 && a.h == 1 && !sameShape(a, b);
+    if (aSmall) {
+      static const int kSwapped[9] = {0, 7, 2, 8, 4, 5, -1, 1, 3};
+      std::swap(a, b);
+      opCode = kSwapped[op];
+    }
+  }
+  const bool perChannel = !withScalar && b.w == 1 && b.h == 1 && b.c == a.c &&
+                          !sameShape(a, b);
+  const bool scalarB =
+      withScalar || (b.w == 1 && b.h == 1 && b.c == 1 && a.c > 1);
+  if (!scalarB && !perChannel && !sameShape(a, b))
+    return false;
+  if (!out.create(a.w, a.h, a.c))
+    return false;
+  const BlobView &o = out.view();
+  const float s = withScalar ? scalar : scalarB ? b.data[0] : 0.0f;
+
+  return withBinaryOp(opCode, [&](auto fn) {
+    const size_t n = planeFloats(a);
+    for (int p = 0; p < a.packs(); ++p) {
+      const float *x = a.pack(p);
+      float *d = o.pack(p);
+      if (scalarB) {
+        for (size_t i = 0; i < n; ++i)
+          d[i] = fn(x[i], s);
+      } else if (perChannel) {
+        const float *y = b.pack(p);
+        for (size_t i = 0; i < n; i += a.lanes) {
+          for (int l = 0; l < a.lanes; ++l)
+            d[i + l] = fn(x[i + l], y[l]);
+        }
+      } else {
+        const float *y = b.pack(p);
+        for (size_t i = 0; i < n; ++i)
+          d[i] = fn(x[i], y[i]);
+      }
+    }
+    return true;
+  });
+}
+
+bool CpuNet::Layer::forward(const std::vector<BlobView> &blobs,
+                            NetBlob &out) const {
+  const BlobView &in = blobs[bottoms[0]];
+  if (!in.data)
+    return false;
+  switch (kind) {
+  case LayerKind::Convolution:
+  case LayerKind::Deconvolution:
+  case LayerKind::InnerProduct:
+    return forwardConv(in, out);
+  case LayerKind::Crop:
+    return forwardCrop(blobs, out);
+  case LayerKind::BinaryOp:
+    return forwardBinary(blobs, out);
+  default:
+    break;
+  }
+
+  const int lanes = in.lanes;
+  const size_t n = planeFloats(in);
+  switch (kind) {
+  case LayerKind::Activation:
+    if (!out.create(in.w, in.h, in.c))
+      return false;
+    for (int p = 0; p < in.packs(); ++p) {
+      const float *s = in.pack(p);
+      float *d = out.view().pack(p);
+      for (size_t i = 0; i < n; ++i)
+        d[i] = activate(s[i], act, actA, actB);
+    }
+    return true;
+
+  case LayerKind::Eltwise: {
+    for (int b : bottoms) {
+      if (!blobs[b].data || !sameShape(blobs[b], in))
+        return false;
+    }
+    if (!out.create(in.w, in.h, in.c))
+      return false;
+    for (int p = 0; p < in.packs(); ++p) {
+      float *d = out.view().pack(p);
+      const float c0 = coeffs.empty() ? 1.0f : coeffs[0];
+      const float *s = in.pack(p);
+      for (size_t i = 0; i < n; ++i)
+        d[i] = op == 1 ? s[i] * c0 : s[i];
+      for (size_t k = 1; k < bottoms.size(); ++k) {
+        const float c = coeffs.empty() ? 1.0f : coeffs[k];
+        s = blobs[bottoms[k]].pack(p);
+        for (size_t i = 0; i < n; ++i) {
+          d[i] = op == 0   ? d[i] * s[i]
+                 : op == 1 ? d[i] + s[i] * c
+                           : std::max(d[i], s[i]);
+        }
+      }
+    }
+    return true;
+  }
+
+  case LayerKind::Pooling:
+    // Global: one value per channel.
+    if (!out.create(1, 1, in.c))
+      return false;
+    for (int p = 0; p < in.packs(); ++p) {
+      float *d = out.view().pack(p);
+      const float *s = in.pack(p);
+      for (int l = 0; l < lanes; ++l) {
+        float acc = op == 0 ? s[l] : 0.0f;
+        for (size_t i = l; i < n; i += lanes)
+          acc = op == 0 ? std::max(acc, s[i]) : acc + s[i];
+        d[l] = op == 0 ? acc : acc / float(in.w * in.h);
+      }
+    }
+    return true;
+
+  case LayerKind::Scale: {
+    const BlobView *factors = weights.empty() ? &blobs[bottoms[1]] : nullptr;
+    if (factors && (!factors->data || factors->c != in.c ||
+                    factors->w != 1 || factors->h != 1))
+      return false;
+    if ((!factors && int(weights.size()) != in.c) ||
+        !out.create(in.w, in.h, in.c))
+      return false;
+    for (int p = 0; p < in.packs(); ++p) {
+      float scale[64] = {}, shift[64] = {};
+      for (int l = 0; l < lanes && p * lanes + l < in.c; ++l) {
+        const int c = p * lanes + l;
+        scale[l] = factors ? factors->pack(p)[l] : weights[c];
+        shift[l] = bias.empty() ? 0.0f : bias[c];
+      }
+      const float *s = in.pack(p);
+      float *d = out.view().pack(p);
+      for (size_t i = 0; i < n; i += lanes) {
+        for (int l = 0; l < lanes; ++l)
+          d[i + l] = s[i + l] * scale[l] + shift[l];
+      }
+    }
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
+CpuNet::CpuNet() = default;
+CpuNet::~CpuNet() = default;
+
+int CpuNet::findBlob(const char *name) const {
+  for (size_t i = 0; i < blobNames_.size(); ++i) {
+    if (blobNames_[i] == name)
+      return blobRoots_[i];
+  }
+  return -1;
+}
+
+bool CpuNet::load(const std::string &param, const std::string &bin) {
+  layers_.clear();
+  blobNames_.clear();
+  blobRoots_.clear();
+
+  std::ifstream file(param);
+  int magic = 0, layerCount = 0, blobCount = 0;
+  if (!(file >> magic >> layerCount >> blobCount) || magic != kParamMagic ||
+      layerCount <= 0 || blobCount <= 0) {
+    OMNIFORGE_LOG_ERROR("cpu_net: {} is not an ncnn param file.", param);
+    return false;
+  }
+  MappedFile weights;
+  if (!weights.open(bin)) {
+    OMNIFORGE_LOG_ERROR("cpu_net: Failed to map {}.", bin);
+    return false;
+  }
+  WeightReader reader(weights.data(), weights.size());
+
+  std::map<std::string, int> blobIds;
+  std::string line;
+  std::getline(file, line);
+  layers_.resize(size_t(layerCount));
+  for (Layer &layer : layers_) {
+    if (!std::getline(file, line)) {
+      OMNIFORGE_LOG_ERROR("cpu_net: {} ends early.", param);
+      return false;
+    }
+    std::istringstream tokens(line);
+    size_t bottomCount = 0, topCount = 0;
+    if (!(tokens >> layer.type >> layer.name >> bottomCount >> topCount)) {
+      OMNIFORGE_LOG_ERROR("cpu_net: Malformed line in {}: {}", param, line);
+      return false;
+    }
+    std::string blob;
+    for (size_t i = 0; i < bottomCount && tokens >> blob; ++i) {
+      auto it = blobIds.find(blob);
+      if (it == blobIds.end()) {
+        OMNIFORGE_LOG_ERROR("cpu_net: {} reads unknown blob {}.", layer.name,
+                            blob);
+        return false;
+      }
+      layer.bottoms.push_back(blobRoots_[it->second]);
+    }
+    for (size_t i = 0; i < topCount && tokens >> blob; ++i) {
+      const int id = static_cast<int>(blobNames_.size());
+      blobIds[blob] = id;
+      blobNames_.push_back(blob);
+      blobRoots_.push_back(id);
+      layer.tops.push_back(id);
+    }
+    ParamDict pd;
+    std::string token;
+    bool parsed = layer.bottoms.size() == bottomCount &&
+                  layer.tops.size() == topCount && topCount > 0;
+    while (parsed && tokens >> token)
+      parsed = pd.parse(token);
+    if (!parsed || !layer.loadParams(pd)) {
+      OMNIFORGE_LOG_ERROR("cpu_net: Unsupported layer {} ({}).", layer.name,
+                          layer.type);
+      return false;
+    }
+    if (!layer.loadWeights(reader)) {
+      OMNIFORGE_LOG_ERROR("cpu_net: {} has no weights for {}.", bin,
+                          layer.name);
+      return false;
+    }
+    if (layer.kind == LayerKind::Alias) {
+      for (int top : layer.tops)
+        blobRoots_[top] = layer.bottoms[0];
+    }
+  }
+
+  // Fuse activation layers into the convolution they follow when nothing
+  // else reads the convolution's output.
+  std::vector<int> readers(blobNames_.size());
+  for (const Layer &layer : layers_) {
+    for (int b : layer.bottoms)
+      ++readers[b];
+  }
+  std::vector<Layer *> producer(blobNames_.size());
+  for (Layer &layer : layers_) {
+    if (layer.kind == LayerKind::Activation) {
+      Layer *conv = producer[layer.bottoms[0]];
+      if (conv && conv->act == Activation::None &&
+          readers[layer.bottoms[0]] == 1) {
+        conv->act = layer.act;
+        conv->actA = layer.actA;
+        conv->actB = layer.actB;
+        // Readers of the activation read the convolution's output instead.
+        const int from = layer.tops[0], to = layer.bottoms[0];
+        for (int &root : blobRoots_)
+          root = root == from ? to : root;
+        for (Layer &later : layers_) {
+          for (int &b : later.bottoms)
+            b = b == from ? to : b;
+        }
+        layer.kind = LayerKind::Alias;
+        continue;
+      }
+    }
+    if (layer.kind == LayerKind::Convolution ||
+        layer.kind == LayerKind::Deconvolution ||
+        layer.kind == LayerKind::InnerProduct)
+      producer[layer.tops[0]] = &layer;
+  }
+  layers_.erase(std::remove_if(layers_.begin(), layers_.end(),
+                               [](const Layer &l) {
+                                 return l.kind == LayerKind::Alias &&
+                                        l.type != "Reshape";
+                               }),
+                layers_.end());
+
+  for (Layer &layer : layers_) {
+    if (layer.kind != LayerKind::Convolution &&
+        layer.kind != LayerKind::Deconvolution &&
+        layer.kind != LayerKind::InnerProduct)
+      continue;
+    const bool rectify = layer.act == Activation::ReLU ||
+                         layer.act == Activation::LeakyReLU;
+    if (!layer.conv.pack(layer.shape, layer.weights.data(),
+                         layer.bias.empty() ? nullptr : layer.bias.data(),
+                         rectify,
+                         layer.act == Activation::LeakyReLU ? layer.actA
+                                                            : 0.0f)) {
+      OMNIFORGE_LOG_ERROR("cpu_net: Unsupported geometry in {}.", layer.name);
+      return false;
+    }
+    layer.weights = std::vector<float>();
+    layer.bias = std::vector<float>();
+  }
+  OMNIFORGE_LOG_INFO("cpu_net: Loaded {} ({} layers, {} kernels).", param,
+                     layers_.size(), convIsa().name);
+  return true;
+}
+
+bool CpuNet::run(const char *input, const BlobView &in, const char *output,
+                 NetBlob &out) const {
+  const int inId = findBlob(input), outId = findBlob(output);
+  if (inId < 0 || outId < 0 || inId == outId || !in.data ||
+      in.lanes != convIsa().lanes)
+    return false;
+
+  // Only the layers the output depends on run, and each blob is released
+  // after its last reader.
+  const size_t blobCount = blobNames_.size();
+  std::vector<char> wanted(blobCount), needed(layers_.size());
+  std::vector<int> readers(blobCount);
+  wanted[outId] = 1;
+  for (size_t i = layers_.size(); i-- > 0;) {
+    const Layer &layer = layers_[i];
+    const int top = blobRoots_[layer.tops[0]];
+    if (layer.kind == LayerKind::Input || top == inId || !wanted[top])
+      continue;
+    needed[i] = 1;
+    for (int b : layer.bottoms) {
+      wanted[b] = 1;
+      ++readers[b];
+    }
+  }
+
+  std::vector<BlobView> blobs(blobCount);
+  std::vector<NetBlob> owned(blobCount);
+  blobs[inId] = in;
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    if (!needed[i])
+      continue;
+    const Layer &layer = layers_[i];
+    const int top = blobRoots_[layer.tops[0]];
+    if (layer.kind == LayerKind::Alias) {
+      // A vector Reshape: same data, checked to really be a vector.
+      const BlobView &src = blobs[layer.bottoms[0]];
+      if (src.w != 1 || src.h != 1)
+        return false;
+      blobs[top] = src;
+    } else {
+      if (!layer.forward(blobs, owned[top])) {
+        OMNIFORGE_LOG_ERROR("cpu_net: {} ({}) failed.", layer.name,
+                            layer.type);
+        return false;
+      }
+      blobs[top] = owned[top].view();
+    }
+    for (int b : layer.bottoms) {
+      if (--readers[b] == 0 && b != outId && b != top) {
+        owned[b].reset();
+        blobs[b] = BlobView();
+      }
+    }
+  }
+  if (!owned[outId])
+    return false;
+  out = std::move(owned[outId]);
+  return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+// cpu_net.h
+// Built-in CPU engine for ncnn-format models: reads the .param graph and
+// .bin weights itself and runs them on the kernels in cpu_conv.h, so the
+// CPU neural path needs no ncnn build. Covers the layers the waifu2x cunet
+// family uses.
+
+#include "cpu_conv.h"
+#include "../utils/frame_pool.h"
+#include <string>
+#include <vector>
+
+// A blob in the engine's layout, owning pooled storage.
+class NetBlob {
+public:
+  // c channels of w x h, contents undefined; false if out of memory.
+  bool create(int w, int h, int c);
+  void reset();
+
+  const BlobView &view() const { return view_; }
+  explicit operator bool() const { return view_.data != nullptr; }
+
+private:
+  FramePool::Handle memory_;
+  BlobView view_;
+};
+
+class CpuNet {
+public:
+  CpuNet();
+  ~CpuNet();
+  CpuNet(const CpuNet &) = delete;
+  CpuNet &operator=(const CpuNet &) = delete;
+
+  // Parses `param` and packs the weights in `bin` for convIsa(). Logs and
+  // returns false if a file is unreadable or malformed, or if the model
+  // uses a layer, option or weight encoding the engine does not have (the
+  // int8 models, for one). A (leaky) ReLU or sigmoid whose input is only
+  // used by it is fused into the convolution before it, which then
+  // produces the activated values under its own blob name as well.
+  bool load(const std::string &param, const std::string &bin);
+
+  // Runs the layers between the blobs named `input` and `output`. `in`
+  // must be in the engine's layout, with its unused lanes zeroed. Nothing
+  // is shared between runs, so threads may run one net concurrently.
+  bool run(const char *input, const BlobView &in, const char *output,
+           NetBlob &out) const;
+
+private:
+  struct Layer;
+
+  int findBlob(const char *name) const;
+
+  std::vector<Layer> layers_;
+  std::vector<std::string> blobNames_;
+  // Blobs that are another layer's output under a new name (Split and
+  // friends) point at it; everything else at itself.
+  std::vector<int> blobRoots_;
+};
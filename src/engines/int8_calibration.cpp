@@ -0,0 +1,106 @@
+// int8_calibration.cpp
+// KL-divergence threshold search and scale computation for INT8 models.
+
+#include "int8_calibration.h"
+#include <algorithm>
+#include <cmath>
+
+void ActivationHistogram::observe(const float *data, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    absMax_ = std::max(absMax_, std::fabs(data[i]));
+}
+
+void ActivationHistogram::accumulate(const float *data, size_t count) {
+  if (absMax_ <= 0.0f)
+    return;
+  if (bins_.empty())
+    bins_.assign(kBins, 0);
+  const float toBin = kBins / absMax_;
+  for (size_t i = 0; i < count; ++i) {
+    const float v = std::fabs(data[i]);
+    if (v == 0.0f)
+      continue; // zeros (mostly ReLU output) would swamp bin 0
+    bins_[std::min(kBins - 1, static_cast<int>(v * toBin))]++;
+  }
+}
+
+float ActivationHistogram::scale() const {
+  if (absMax_ <= 0.0f)
+    return 0.0f;
+  if (bins_.empty())
+    return 127.0f / absMax_;
+  const int bin = klThresholdBin(bins_);
+  const float threshold = (bin + 0.5f) * (absMax_ / kBins);
+  return 127.0f / threshold;
+}
+
+int klThresholdBin(const std::vector<uint64_t> &bins, int levels) {
+  const int n = static_cast<int>(bins.size());
+  if (n <= levels)
+    return n - 1;
+
+  int best = n - 1;
+  double bestKl = INFINITY;
+  std::vector<double> p, q;
+  for (int t = levels; t <= n; ++t) {
+    // Reference: the first t bins, everything clipped folded into the last.
+    p.assign(bins.begin(), bins.begin() + t);
+    for (int i = t; i < n; ++i)
+      p[t - 1] += bins[i];
+
+    // Candidate: the same t bins merged into `levels` levels, each level's
+    // mass spread evenly over its non-empty source bins.
+    q.assign(t, 0.0);
+    const double width = double(t) / levels;
+    for (int l = 0; l < levels; ++l) {
+      const int b0 = static_cast<int>(l * width);
+      const int b1 = l + 1 == levels ? t : static_cast<int>((l + 1) * width);
+      double mass = 0.0;
+      int nonEmpty = 0;
+      for (int i = b0; i < b1; ++i) {
+        mass += bins[i];
+        nonEmpty += bins[i] != 0;
+      }
+      if (nonEmpty == 0)
+        continue;
+      for (int i = b0; i < b1; ++i)
+        if (bins[i] != 0)
+          q[i] = mass / nonEmpty;
+    }
+
+    double pSum = 0.0, qSum = 0.0;
+    for (int i = 0; i < t; ++i) {
+      pSum += p[i];
+      qSum += q[i];
+    }
+    if (pSum <= 0.0 || qSum <= 0.0)
+      continue;
+    double kl = 0.0;
+    for (int i = 0; i < t; ++i) {
+      if (p[i] == 0.0)
+        continue;
+      const double pi = p[i] / pSum;
+      // Clipped mass in the last bin may have no counterpart in q.
+      const double qi = q[i] > 0.0 ? q[i] / qSum : 1e-12;
+      kl += pi * std::log(pi / qi);
+    }
+    if (kl < bestKl) {
+      bestKl = kl;
+      best = t - 1;
+    }
+  }
+  return best;
+}
+
+std::vector<float> weightScales(const float *weights, int outputs,
+                                size_t perOutput) {
+  std::vector<float> scales(static_cast<size_t>(std::max(0, outputs)), 0.0f);
+  for (int o = 0; o < outputs; ++o) {
+    const float *w = weights + size_t(o) * perOutput;
+    float absMax = 0.0f;
+    for (size_t i = 0; i < perOutput; ++i)
+      absMax = std::max(absMax, std::fabs(w[i]));
+    scales[o] = absMax > 0.0f ? 127.0f / absMax : 0.0f;
+  }
+  return scales;
+}
@@ -0,0 +1,39 @@
+#pragma once
+// int8_calibration.h
+// Scale computation for INT8 models, written in the table format ncnn's
+// ncnn2int8 consumes: per-output-channel weight scales plus one scale per
+// layer input, the latter from the KL-divergence threshold of its
+// activation histogram (as in ncnn2table / TensorRT).
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Activation statistics of one blob. Calibration makes two passes over the
+// sample set: observe() everything to find the range, then accumulate()
+// everything again to fill the histogram over that range.
+class ActivationHistogram {
+public:
+  static constexpr int kBins = 2048;
+
+  void observe(const float *data, size_t count);
+  void accumulate(const float *data, size_t count);
+
+  float absMax() const { return absMax_; }
+  // 127 / threshold, or 0 if nothing non-zero was seen.
+  float scale() const;
+
+private:
+  float absMax_ = 0.0f;
+  std::vector<uint64_t> bins_;
+};
+
+// Index of the bin whose upper edge is the clipping threshold that
+// minimises the KL divergence between `bins` and its `levels`-level
+// quantisation.
+int klThresholdBin(const std::vector<uint64_t> &bins, int levels = 128);
+
+// 127 / max|w| for each of `outputs` consecutive filters of `perOutput`
+// weights (0 for an all-zero filter).
+std::vector<float> weightScales(const float *weights, int outputs,
+                                size_t perOutput);
@@ -1,53 +1,333 @@
-// ncnn_stub.cpp - placeholder for ncnn-vulkan integration
-#include <iostream>
+// ncnn_stub.cpp - ncnn integration: model loading, GPU and CPU inference
+#include "neural_engine.h"
+#include "cpu_net.h"
+#include "neural_tiler.h"
+#include "../utils/cpu_features.h"
+#include "../utils/log.h"
+#include "../utils/thread_pool.h"
+#include "../utils/trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #ifdef OMNIFORGE_HAVE_NCNN
+#include "../utils/mapped_file.h"
+#include <ncnn/allocator.h>
 #include <ncnn/gpu.h>
+#include <ncnn/layer.h>
 #include <ncnn/net.h>
+#endif
+
+namespace {
 
+constexpr const char *kModelName = "models-cunet/cunet-noise0";
+#ifdef _WIN32
+constexpr const char *kDefaultModelDir = "C:/omniforge/models";
+#else
+constexpr const char *kDefaultModelDir = "/usr/share/omniforge/models";
 #endif
 
-// Global ncnn net instance
+// cunet's receptive field: inputs are padded by this much so the border
+// pixels see context, and tiles get as much real input beyond their
+// blended part (NeuralTilePlan::halo).
+constexpr int kCunetPrepadding = 18;
+
+// Half-width of the band neighbouring tiles cross-fade over, in input
+// pixels. Both tiles see full context there, so it only has to hide what
+// the squeeze-excitation blocks' per-tile averages change.
+constexpr int kCunetBlend = 8;
+
+constexpr int kPrecisions = 3;
+
+// One network per backend and precision. `state` is read lock-free on the
+// frame path; the nets are only touched once it reads Ready.
+struct NeuralNet {
+  std::atomic<NeuralState> state{NeuralState::Idle};
+  std::mutex mutex;
+  std::condition_variable loaded;
+  std::unique_ptr<CpuNet> cpuNet; // built-in engine, or null
 #ifdef OMNIFORGE_HAVE_NCNN
-static ncnn::Net *g_net = nullptr;
-static ncnn::VulkanDevice *g_vkdev = nullptr;
+  ncnn::Net *net = nullptr;
 #endif
+};
 
-bool initNcnnVulkan() {
-  std::cerr << "ncnn_stub: initNcnnVulkan() called." << std::endl;
+NeuralNet g_nets[2][kPrecisions];
+
+NeuralNet &netFor(NeuralBackend backend, NeuralPrecision precision) {
+  return g_nets[static_cast<int>(backend)][static_cast<int>(precision)];
+}
+
+// The built-in engine (cpu_net.h) runs fp32 on the CPU; fp16, int8 and
+// Vulkan go through ncnn. OMNIFORGE_NEURAL_CPU=ncnn sends fp32 there too
+// when ncnn is built in, to compare the two.
+bool useCpuNet(NeuralBackend backend, NeuralPrecision precision) {
+  if (backend != NeuralBackend::Cpu || precision != NeuralPrecision::FP32)
+    return false;
 #ifdef OMNIFORGE_HAVE_NCNN
-  if (ncnn::create_gpu_instance()) {
-    std::cerr << "ncnn: GPU instance created." << std::endl;
-    g_vkdev = ncnn::get_gpu_device(0); // Use first GPU
+  static const bool ncnn = [] {
+    const char *env = std::getenv("OMNIFORGE_NEURAL_CPU");
+    return env && std::string(env) == "ncnn";
+  }();
+  return !ncnn;
+#else
+  return true;
+#endif
+}
+
+// Loads the model into the built-in engine and runs the same warm-up as
+// loadNet(), which also checks the graph reaches cunet's output.
+std::unique_ptr<CpuNet> loadCpuNet() {
+  const std::string base = neuralModelBase();
+  std::unique_ptr<CpuNet> net(new CpuNet());
+  if (!net->load(base + ".param", base + ".bin"))
+    return nullptr;
+
+  const int size = 2 * kCunetPrepadding + 16;
+  NetBlob warmup, result;
+  if (!warmup.create(size, size, 3))
+    return nullptr;
+  const BlobView &v = warmup.view();
+  for (int i = 0; i < size * size; ++i) {
+    float *px = v.pack(0) + size_t(i) * v.lanes;
+    std::fill(px, px + v.lanes, 0.0f);
+    std::fill(px, px + 3, 0.5f);
+  }
+  if (!net->run("Input1", v, "Eltwise4", result)) {
+    OMNIFORGE_LOG_ERROR("cpu_net: Warm-up inference failed.");
+    return nullptr;
   }
+  return net;
+}
 
-  g_net = new ncnn::Net();
-  g_net->opt.use_vulkan_compute = true;
-  g_net->set_vulkan_device(g_vkdev);
+#ifdef OMNIFORGE_HAVE_NCNN
+ncnn::PoolAllocator g_cpuBlobAllocator;
+ncnn::PoolAllocator g_cpuWorkspaceAllocator;
 
-  // Load model (hardcoded path for now, should be configurable)
-  // Assuming models are in C:/omniforge/models
-  std::string paramPath = "C:/omniforge/models/models-cunet/cunet-noise0.param";
-  std::string binPath = "C:/omniforge/models/models-cunet/cunet-noise0.bin";
+// Weights stay mapped for the life of the process: ncnn references them
+// in place, so every process using the model shares the same pages.
+const MappedFile *mapWeights(const std::string &path) {
+  static std::mutex mutex;
+  static std::map<std::string, std::unique_ptr<MappedFile>> files;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<MappedFile> &file = files[path];
+  if (!file) {
+    file.reset(new MappedFile());
+    if (file->open(path))
+      file->prefetch();
+  }
+  return *file ? file.get() : nullptr;
+}
 
-  if (g_net->load_param(paramPath.c_str()) != 0) {
-    std::cerr << "ncnn: Failed to load param: " << paramPath << std::endl;
-    return false;
+void applyPrecision(ncnn::Option &opt, NeuralBackend backend,
+                    NeuralPrecision precision) {
+  opt.use_int8_inference = precision == NeuralPrecision::INT8;
+  opt.use_bf16_storage = false;
+  bool storage = precision == NeuralPrecision::FP16;
+  bool arithmetic = storage;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||            \
+    defined(_M_IX86)
+  if (backend == NeuralBackend::Cpu) {
+    storage = storage && cpuFeatures().f16c;
+    arithmetic = arithmetic && cpuFeatures().avx512fp16;
   }
-  if (g_net->load_model(binPath.c_str()) != 0) {
-    std::cerr << "ncnn: Failed to load model: " << binPath << std::endl;
-    return false;
+#else
+  (void)backend;
+#endif
+  opt.use_fp16_storage = storage;
+  opt.use_fp16_packed = storage;
+  opt.use_fp16_arithmetic = arithmetic;
+}
+
+// Loads the model and runs one small inference, so layer pipelines (and on
+// Vulkan the shaders) are built before the first real frame.
+ncnn::Net *loadNet(NeuralBackend backend, NeuralPrecision precision) {
+  if (backend == NeuralBackend::Vulkan &&
+      precision == NeuralPrecision::INT8) {
+    OMNIFORGE_LOG_ERROR("ncnn: INT8 models are CPU-only.");
+    return nullptr;
+  }
+  const std::string base = neuralModelBase() +
+                           (precision == NeuralPrecision::INT8 ? "-int8" : "");
+  const MappedFile *weights = mapWeights(base + ".bin");
+  if (!weights) {
+    OMNIFORGE_LOG_ERROR("ncnn: Failed to map model: {}.bin", base);
+    return nullptr;
+  }
+
+  ncnn::Net *net = new ncnn::Net();
+  if (backend == NeuralBackend::Vulkan) {
+    if (ncnn::create_gpu_instance() != 0 || ncnn::get_gpu_count() == 0) {
+      OMNIFORGE_LOG_ERROR("ncnn: No Vulkan device.");
+      delete net;
+      return nullptr;
+    }
+    net->opt.use_vulkan_compute = true;
+    net->set_vulkan_device(ncnn::get_gpu_device(0)); // Use first GPU
+  } else {
+    // One thread per extractor; parallelism comes from running tiles
+    // concurrently (see runNcnnInferenceCpu).
+    net->opt.use_vulkan_compute = false;
+    net->opt.num_threads = 1;
+    net->opt.blob_allocator = &g_cpuBlobAllocator;
+    net->opt.workspace_allocator = &g_cpuWorkspaceAllocator;
   }
-  std::cerr << "ncnn: Model loaded successfully." << std::endl;
+  net->opt.lightmode = true;
+  applyPrecision(net->opt, backend, precision);
+
+  if (net->load_param((base + ".param").c_str()) != 0 ||
+      net->load_model(weights->data()) == 0) {
+    OMNIFORGE_LOG_ERROR("ncnn: Failed to load model: {}", base);
+    delete net;
+    return nullptr;
+  }
+
+  ncnn::Mat warmup(2 * kCunetPrepadding + 16, 2 * kCunetPrepadding + 16, 3);
+  warmup.fill(0.5f);
+  ncnn::Extractor ex = net->create_extractor();
+  ex.input("Input1", warmup);
+  ncnn::Mat result;
+  if (ex.extract("Eltwise4", result) != 0) {
+    OMNIFORGE_LOG_ERROR("ncnn: Warm-up inference failed.");
+    delete net;
+    return nullptr;
+  }
+  return net;
+}
 #endif
-  return true;
+
+// Loads `n` on the calling thread with whichever engine serves it.
+bool loadNeuralNet(NeuralNet &n, NeuralBackend backend,
+                   NeuralPrecision precision) {
+  if (useCpuNet(backend, precision)) {
+    n.cpuNet = loadCpuNet();
+    return n.cpuNet != nullptr;
+  }
+#ifdef OMNIFORGE_HAVE_NCNN
+  n.net = loadNet(backend, precision);
+  return n.net != nullptr;
+#else
+  return false;
+#endif
+}
+
+} // namespace
+
+const char *precisionName(NeuralPrecision precision) {
+  switch (precision) {
+  case NeuralPrecision::FP16:
+    return "fp16";
+  case NeuralPrecision::INT8:
+    return "int8";
+  default:
+    return "fp32";
+  }
+}
+
+bool parsePrecision(const std::string &name, NeuralPrecision &precision) {
+  for (int i = 0; i < kPrecisions; ++i) {
+    const NeuralPrecision p = static_cast<NeuralPrecision>(i);
+    if (name == precisionName(p)) {
+      precision = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string neuralModelDir() {
+  const char *env = std::getenv("OMNIFORGE_MODEL_DIR");
+  return env && *env ? std::string(env) : std::string(kDefaultModelDir);
+}
+
+std::string neuralModelBase() {
+  return neuralModelDir() + "/" + kModelName;
+}
+
+NeuralPrecision neuralPrecision() {
+  static const NeuralPrecision precision = [] {
+    NeuralPrecision p = NeuralPrecision::FP32;
+    std::string name;
+    if (const char *env = std::getenv("OMNIFORGE_NEURAL_PRECISION")) {
+      name = env;
+    } else {
+      std::ifstream file(neuralModelBase() + ".precision");
+      file >> name;
+    }
+    if (!name.empty() && !parsePrecision(name, p))
+      OMNIFORGE_LOG_WARN("ncnn: Unknown precision '{}', using fp32.", name);
+    return p;
+  }();
+  return precision;
+}
+
+NeuralState neuralState(NeuralBackend backend, NeuralPrecision precision) {
+  return netFor(backend, precision).state.load(std::memory_order_acquire);
+}
+
+void startNeuralLoad(NeuralBackend backend, NeuralPrecision precision) {
+  NeuralNet &n = netFor(backend, precision);
+  NeuralState expected = NeuralState::Idle;
+  if (!n.state.compare_exchange_strong(expected, NeuralState::Loading))
+    return;
+#ifndef OMNIFORGE_HAVE_NCNN
+  if (!useCpuNet(backend, precision)) {
+    {
+      std::lock_guard<std::mutex> lock(n.mutex);
+      n.state.store(NeuralState::Failed, std::memory_order_release);
+    }
+    n.loaded.notify_all();
+    return;
+  }
+#endif
+  std::thread([&n, backend, precision] {
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok = loadNeuralNet(n, backend, precision);
+    {
+      std::lock_guard<std::mutex> lock(n.mutex);
+      n.state.store(ok ? NeuralState::Ready : NeuralState::Failed,
+                    std::memory_order_release);
+    }
+    n.loaded.notify_all();
+    if (ok)
+      OMNIFORGE_LOG_INFO("{}: {} model ready after {} s.",
+                         n.cpuNet ? "cpu_net" : "ncnn",
+                         precisionName(precision),
+                         std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count());
+  }).detach();
+}
+
+bool waitNeuralReady(NeuralBackend backend, NeuralPrecision precision) {
+  startNeuralLoad(backend, precision);
+  NeuralNet &n = netFor(backend, precision);
+  std::unique_lock<std::mutex> lock(n.mutex);
+  n.loaded.wait(lock, [&] {
+    return n.state.load(std::memory_order_acquire) != NeuralState::Loading;
+  });
+  return n.state.load(std::memory_order_acquire) == NeuralState::Ready;
+}
+
+bool initNcnnVulkan() {
+  OMNIFORGE_LOG_INFO("ncnn_stub: initNcnnVulkan() called.");
+  // Returns at once; processFrame keeps frames on FSR until the model is
+  // ready.
+  startNeuralLoad(NeuralBackend::Vulkan);
+  return neuralState(NeuralBackend::Vulkan) != NeuralState::Failed;
 }
 
 bool runNcnnInference(void *input, void *output, int width, int height) {
-  // std::cerr << "ncnn_stub: runNcnnInference() called." << std::endl;
+  OMNIFORGE_TRACE_SCOPE("ncnn inference");
 #ifdef OMNIFORGE_HAVE_NCNN
-  if (!g_net)
+  if (!neuralReady(NeuralBackend::Vulkan))
     return false;
 
   // In a real scenario, we need the VkCommandBuffer to record the layout
@@ -60,19 +340,190 @@ bool runNcnnInference(void *input, void *output, int width, int height) {
   VkCommandBuffer cmd = ...; // Need to pass this down
 
   ncnn::VkImageMat in_mat;
-  in_mat.create(width, height, 1, 4, inputImg, cmd, g_net->opt);
+  ncnn::Net *net = netFor(NeuralBackend::Vulkan, neuralPrecision()).net;
+  in_mat.create(width, height, 1, 4, inputImg, cmd, net->opt);
 
-  ncnn::Extractor ex = g_net->create_extractor();
+  ncnn::Extractor ex = net->create_extractor();
   ex.input("input", in_mat);
 
   ncnn::VkImageMat out_mat;
-  out_mat.create(width*2, height*2, 1, 4, outputImg, cmd, g_net->opt);
+  out_mat.create(width*2, height*2, 1, 4, outputImg, cmd, net->opt);
   ex.extract("output", out_mat);
   */
 
   // For now, just log that we would run inference
-  // std::cout << "ncnn: Inference stub called for " << width << "x" << height
-  // << std::endl;
+  OMNIFORGE_LOG_DEBUG("ncnn: Inference stub called for {}x{}", width, height);
 #endif
   return true;
 }
+
+// --- CPU path ---------------------------------------------------------------
+
+namespace {
+
+// Rough peak of live cunet blobs per input pixel in light mode (fp32,
+// 64..256 channels at 1x and 2x).
+constexpr size_t kCunetBytesPerPixel = 2048;
+constexpr size_t kDefaultBudgetMb = 1024;
+
+size_t neuralBudgetBytes() {
+  size_t mb = kDefaultBudgetMb;
+  if (const char *env = std::getenv("OMNIFORGE_NEURAL_MEM_MB")) {
+    const long v = std::atol(env);
+    if (v > 0)
+      mb = static_cast<size_t>(v);
+  }
+  return mb << 20;
+}
+
+// Right and bottom prepadding: rounds the padded size up to the multiple
+// of 4 cunet's down/up-sampling needs.
+int cunetFarPad(int size) {
+  return kCunetPrepadding + ((4 - (size + 2 * kCunetPrepadding) % 4) % 4);
+}
+
+// Where `out` starts in cunet's result for a padded input: the network
+// trims the same border from each side of its 2x output. False if the
+// result does not cover `out`.
+bool cunetOrigin(int paddedW, int paddedH, int resultW, int resultH,
+                 const FrameView &out, int &ox, int &oy) {
+  const int pad = kCunetPrepadding;
+  ox = 2 * pad - (2 * paddedW - resultW) / 2;
+  oy = 2 * pad - (2 * paddedH - resultH) / 2;
+  return ox >= 0 && oy >= 0 && ox + out.width <= resultW &&
+         oy + out.height <= resultH;
+}
+
+// One row of cunet's RGB result as RGBA8, keeping the alpha of the source
+// pixel; a channel's consecutive pixels are `step` floats apart.
+void storeCunetRow(const float *r, const float *g, const float *b,
+                   size_t step, const uint32_t *alpha, uint32_t *dst,
+                   int width) {
+  auto to8 = [](float v) {
+    const int i = static_cast<int>(v * 255.f + 0.5f);
+    return static_cast<uint32_t>(std::min(255, std::max(0, i)));
+  };
+  for (int x = 0; x < width; ++x) {
+    const size_t i = x * step;
+    dst[x] = to8(r[i]) | to8(g[i]) << 8 | to8(b[i]) << 16 |
+             (alpha[x >> 1] & 0xff000000u);
+  }
+}
+
+// makeCunetInput for the built-in engine.
+bool makeCunetBlob(const FrameView &in, NetBlob &padded) {
+  const int w = in.width, h = in.height, pad = kCunetPrepadding;
+  if (!padded.create(w + pad + cunetFarPad(w), h + pad + cunetFarPad(h), 3))
+    return false;
+  const BlobView &v = padded.view();
+  for (int y = 0; y < v.h; ++y) {
+    const uint32_t *src = in.row(std::min(std::max(y - pad, 0), h - 1));
+    float *dst = v.at(0, y, 0);
+    for (int x = 0; x < v.w; ++x, dst += v.lanes) {
+      const uint32_t p = src[std::min(std::max(x - pad, 0), w - 1)];
+      dst[0] = static_cast<float>(p & 0xff) * (1 / 255.f);
+      dst[1] = static_cast<float>(p >> 8 & 0xff) * (1 / 255.f);
+      dst[2] = static_cast<float>(p >> 16 & 0xff) * (1 / 255.f);
+      std::fill(dst + 3, dst + v.lanes, 0.0f);
+    }
+  }
+  return true;
+}
+
+// NeuralTileFn for the built-in engine; `user` is the CpuNet.
+bool cunetTileCpuNet(void *user, const FrameView &in, const FrameView &out) {
+  const CpuNet &net = *static_cast<const CpuNet *>(user);
+  NetBlob padded, result;
+  if (!makeCunetBlob(in, padded) ||
+      !net.run("Input1", padded.view(), "Eltwise4", result) ||
+      result.view().c != 3)
+    return false;
+
+  const BlobView &r = result.view();
+  int ox, oy;
+  if (!cunetOrigin(padded.view().w, padded.view().h, r.w, r.h, out, ox, oy))
+    return false;
+  for (int y = 0; y < out.height; ++y) {
+    const float *px = r.at(0, oy + y, ox);
+    storeCunetRow(px, px + 1, px + 2, r.lanes, in.row(y >> 1), out.row(y),
+                  out.width);
+  }
+  return true;
+}
+
+#ifdef OMNIFORGE_HAVE_NCNN
+// NeuralTileFn: one cunet pass over an extended tile; `user` is the net.
+bool cunetTile(void *user, const FrameView &in, const FrameView &out) {
+  const ncnn::Net &net = *static_cast<const ncnn::Net *>(user);
+  ncnn::Mat padded;
+  makeCunetInput(in, padded, net.opt);
+
+  ncnn::Extractor ex = net.create_extractor();
+  ex.set_light_mode(true);
+  ex.input("Input1", padded);
+  ncnn::Mat result;
+  if (ex.extract("Eltwise4", result) != 0 || result.c != 3)
+    return false;
+
+  int ox, oy;
+  if (!cunetOrigin(padded.w, padded.h, result.w, result.h, out, ox, oy))
+    return false;
+  for (int y = 0; y < out.height; ++y) {
+    storeCunetRow(result.channel(0).row(oy + y) + ox,
+                  result.channel(1).row(oy + y) + ox,
+                  result.channel(2).row(oy + y) + ox, 1, in.row(y >> 1),
+                  out.row(y), out.width);
+  }
+  return true;
+}
+#endif
+
+} // namespace
+
+#ifdef OMNIFORGE_HAVE_NCNN
+
+void makeCunetInput(const FrameView &in, ncnn::Mat &padded,
+                    const ncnn::Option &opt) {
+  const int w = in.width, h = in.height;
+  ncnn::Mat rgb = ncnn::Mat::from_pixels(in.data, ncnn::Mat::PIXEL_RGBA2RGB, w,
+                                         h, static_cast<int>(in.stride),
+                                         opt.blob_allocator);
+  const float norm[3] = {1 / 255.f, 1 / 255.f, 1 / 255.f};
+  rgb.substract_mean_normalize(nullptr, norm);
+
+  // Frame borders get replicated context.
+  const int pad = kCunetPrepadding;
+  ncnn::copy_make_border(rgb, padded, pad, cunetFarPad(h), pad, cunetFarPad(w),
+                         ncnn::BORDER_REPLICATE, 0.f, opt);
+}
+#endif
+
+int neuralHalo() { return kCunetPrepadding; }
+
+bool runNcnnInferenceCpu(const FrameView &input, const FrameView &output,
+                         ThreadPool &pool, NeuralPrecision precision) {
+  if (!waitNeuralReady(NeuralBackend::Cpu, precision))
+    return false;
+  const NeuralNet &n = netFor(NeuralBackend::Cpu, precision);
+  if (n.cpuNet) {
+    const NeuralTilePlan plan = planNeuralTiles(
+        input.width, input.height, neuralBudgetBytes(), pool.concurrency(),
+        kCunetBlend, neuralHalo(), kCunetBytesPerPixel);
+    return runTiledUpscale(input, output, plan, pool, cunetTileCpuNet,
+                           n.cpuNet.get());
+  }
+#ifdef OMNIFORGE_HAVE_NCNN
+  ncnn::Net *net = n.net;
+  // fp16 storage halves the live blobs, so tiles can grow.
+  const size_t bytesPerPixel = net->opt.use_fp16_storage
+                                   ? kCunetBytesPerPixel / 2
+                                   : kCunetBytesPerPixel;
+  const NeuralTilePlan plan =
+      planNeuralTiles(input.width, input.height, neuralBudgetBytes(),
+                      pool.concurrency(), kCunetBlend, neuralHalo(),
+                      bytesPerPixel);
+  return runTiledUpscale(input, output, plan, pool, cunetTile, net);
+#else
+  return false;
+#endif
+}
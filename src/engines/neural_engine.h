@@ -0,0 +1,80 @@
+#pragma once
+// neural_engine.h
+// Entry points of the neural upscaler (engines/ncnn_stub.cpp): ncnn, and
+// for fp32 on the CPU the built-in engine in cpu_net.h.
+
+#include "../pipeline/frame.h"
+#include <string>
+
+class ThreadPool;
+
+enum class NeuralBackend { Vulkan, Cpu };
+enum class NeuralState { Idle, Loading, Ready, Failed };
+
+// FP16 halves weight and activation traffic where the hardware has it
+// (F16C storage, AVX512-FP16 arithmetic; ncnn checks ARM and GPUs itself).
+// INT8 runs the `<model>-int8` files produced by ncnn2int8 from an
+// omniforge_calibrate table, and is CPU-only.
+enum class NeuralPrecision { FP32, FP16, INT8 };
+
+const char *precisionName(NeuralPrecision precision);
+bool parsePrecision(const std::string &name, NeuralPrecision &precision);
+
+// Model files are read from OMNIFORGE_MODEL_DIR, falling back to the
+// default install location. Weights are memory-mapped, so processes using
+// the same model share its pages.
+std::string neuralModelDir();
+// Model path without extension, e.g. `<dir>/models-cunet/cunet-noise0`.
+std::string neuralModelBase();
+
+// Precision processFrame uses: OMNIFORGE_NEURAL_PRECISION if set, else the
+// first word of `<model>.precision` next to the model, else FP32.
+NeuralPrecision neuralPrecision();
+
+// Loads the model for `backend` at `precision` and runs a warm-up
+// inference on a background thread. Only the first call for a backend and
+// precision does anything.
+void startNeuralLoad(NeuralBackend backend,
+                     NeuralPrecision precision = neuralPrecision());
+NeuralState neuralState(NeuralBackend backend,
+                        NeuralPrecision precision = neuralPrecision());
+inline bool neuralReady(NeuralBackend backend,
+                        NeuralPrecision precision = neuralPrecision()) {
+  return neuralState(backend, precision) == NeuralState::Ready;
+}
+// Starts the load if needed and blocks until it finishes; false if the
+// model could not be loaded (or needs ncnn, which is not built in).
+bool waitNeuralReady(NeuralBackend backend,
+                     NeuralPrecision precision = neuralPrecision());
+
+// Starts the Vulkan model load; returns without waiting for it.
+bool initNcnnVulkan();
+
+// GPU path: `input` and `output` are VkImage handles.
+bool runNcnnInference(void *input, void *output, int width, int height);
+
+// Input pixels around a region that can change the CPU path's output
+// inside it (the network's receptive field).
+int neuralHalo();
+
+// CPU path: 2x cunet upscale of `input` into `output`, run in overlapping
+// tiles on `pool` so peak memory follows OMNIFORGE_NEURAL_MEM_MB (default
+// 1024) rather than the frame size. Waits for the CPU model on first use;
+// returns false if the model is unavailable. FP32 runs on the built-in
+// engine unless OMNIFORGE_NEURAL_CPU=ncnn; the other precisions need ncnn.
+bool runNcnnInferenceCpu(const FrameView &input, const FrameView &output,
+                         ThreadPool &pool,
+                         NeuralPrecision precision = neuralPrecision());
+
+#ifdef OMNIFORGE_HAVE_NCNN
+namespace ncnn {
+class Mat;
+class Option;
+} // namespace ncnn
+
+// cunet's input blob for an RGBA8 region: RGB scaled to 0..1, borders
+// replicated by the model's prepadding. Shared with omniforge_calibrate so
+// calibration sees exactly what inference does.
+void makeCunetInput(const FrameView &in, ncnn::Mat &padded,
+                    const ncnn::Option &opt);
+#endif
@@ -0,0 +1,192 @@
+// neural_tiler.cpp
+// Overlapping-tile execution and seam blending for the neural engines.
+
+#include "neural_tiler.h"
+#include "../utils/frame_pool.h"
+#include "../utils/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int kMinCore = 16;
+
+// Balanced split of [0, extent) into `parts` cores.
+int coreStart(int index, int parts, int extent) {
+  return static_cast<int>(static_cast<long long>(index) * extent / parts);
+}
+
+struct Span {
+  int core0, core1;   // core, input pixels
+  int blend0, blend1; // core plus its bands: where the tile has weight
+  int ext0, ext1;     // that plus the halo, fed to the network
+  bool lowBand, highBand;
+};
+
+// Frame edges get no halo: the network replicates them for every tile,
+// the same as it does for the whole frame.
+Span spanOf(int index, int parts, int extent, int overlap, int halo) {
+  Span s;
+  s.core0 = coreStart(index, parts, extent);
+  s.core1 = coreStart(index + 1, parts, extent);
+  s.lowBand = index > 0 && overlap > 0;
+  s.highBand = index + 1 < parts && overlap > 0;
+  s.blend0 = s.lowBand ? s.core0 - overlap : s.core0;
+  s.blend1 = s.highBand ? s.core1 + overlap : s.core1;
+  s.ext0 = index > 0 ? std::max(0, s.blend0 - halo) : 0;
+  s.ext1 = index + 1 < parts ? std::min(extent, s.blend1 + halo) : extent;
+  return s;
+}
+
+// Cross-fade weight (0..256) of output coordinate `o` for a tile spanning
+// `s`; neighbouring tiles' weights sum to 256 across each band.
+int weightAt(const Span &s, int overlap, int o) {
+  // Output pixel centre in input units, times 4 to stay integral.
+  const int x4 = 2 * o + 1;
+  if (s.lowBand && x4 < 4 * (s.core0 + overlap))
+    return (x4 - 4 * (s.core0 - overlap)) * 256 / (8 * overlap);
+  if (s.highBand && x4 >= 4 * (s.core1 - overlap))
+    return 256 - (x4 - 4 * (s.core1 - overlap)) * 256 / (8 * overlap);
+  return 256;
+}
+
+bool inBand(int parts, int extent, int overlap, int o) {
+  for (int i = 1; i < parts; ++i) {
+    const int edge = 2 * coreStart(i, parts, extent);
+    if (o >= edge - 2 * overlap && o < edge + 2 * overlap)
+      return true;
+  }
+  return false;
+}
+
+} // namespace
+
+NeuralTilePlan planNeuralTiles(int width, int height, size_t budgetBytes,
+                               unsigned workers, int overlap, int halo,
+                               size_t activationBytesPerPixel) {
+  NeuralTilePlan plan;
+  plan.width = width;
+  plan.height = height;
+  plan.overlap = std::max(0, overlap);
+  plan.halo = std::max(0, halo);
+  if (width <= 0 || height <= 0)
+    return plan;
+
+  workers = std::max(1u, workers);
+  const double perWorker = double(budgetBytes) / workers;
+  const int extended = static_cast<int>(
+      std::sqrt(perWorker / double(std::max<size_t>(1, activationBytesPerPixel))));
+  const int minTile = 2 * plan.overlap + kMinCore;
+  int tile =
+      std::max(minTile, extended - 2 * (plan.overlap + plan.halo));
+
+  // Enough tiles to keep every worker busy, as long as the overlap does
+  // not start to dominate.
+  auto tiles = [&](int t) {
+    return ((width + t - 1) / t) * ((height + t - 1) / t);
+  };
+  while (static_cast<unsigned>(tiles(tile)) < workers && tile > 2 * minTile)
+    tile = tile * 3 / 4;
+
+  plan.cols = (width + tile - 1) / tile;
+  plan.rows = (height + tile - 1) / tile;
+  plan.tileWidth = (width + plan.cols - 1) / plan.cols;
+  plan.tileHeight = (height + plan.rows - 1) / plan.rows;
+  return plan;
+}
+
+bool runTiledUpscale(const FrameView &input, const FrameView &output,
+                     const NeuralTilePlan &plan, ThreadPool &pool,
+                     NeuralTileFn fn, void *user) {
+  if (!input.valid() || !output.valid() || plan.count() <= 0 ||
+      output.width != input.width * 2 || output.height != input.height * 2)
+    return false;
+
+  // Bands of neighbouring tiles must not meet, or same-phase tiles below
+  // would overlap. Only the cross-fade narrows; the halo never does.
+  const int overlap =
+      std::min({plan.overlap, (input.width / plan.cols) / 2,
+                (input.height / plan.rows) / 2});
+  const int halo = plan.halo;
+  const int cols = plan.cols, rows = plan.rows;
+
+  // One output buffer per pool slot, big enough for any extended tile.
+  const int maxExtW = plan.tileWidth + 1 + 2 * (overlap + halo);
+  const int maxExtH = plan.tileHeight + 1 + 2 * (overlap + halo);
+  const size_t tileStride = (size_t(maxExtW) * 8 + 63) & ~size_t(63);
+  const size_t slotBytes = tileStride * size_t(maxExtH) * 2;
+  FramePool::Handle scratch =
+      FramePool::shared().acquireBytes(slotBytes * pool.slots());
+  if (!scratch)
+    return false;
+
+  // Blending adds into the bands, so clear them first.
+  pool.parallelFor(static_cast<size_t>(output.height), [&](size_t i) {
+    const int y = static_cast<int>(i);
+    uint32_t *row = output.row(y);
+    if (overlap > 0 && inBand(rows, input.height, overlap, y)) {
+      std::memset(row, 0, size_t(output.width) * 4);
+      return;
+    }
+    for (int c = 1; c < cols && overlap > 0; ++c) {
+      const int edge = 2 * coreStart(c, cols, input.width);
+      std::memset(row + edge - 2 * overlap, 0, size_t(4 * overlap) * 4);
+    }
+  });
+
+  // Tiles of one phase are two apart in both directions and never touch,
+  // so each phase can write its blended contribution without locking.
+  std::atomic<bool> failed{false};
+  for (int phase = 0; phase < 4 && !failed; ++phase) {
+    const int pr = phase >> 1, pc = phase & 1;
+    const int phaseCols = (cols - pc + 1) / 2, phaseRows = (rows - pr + 1) / 2;
+    if (phaseCols <= 0 || phaseRows <= 0)
+      continue;
+    pool.parallelFor(size_t(phaseCols) * phaseRows, [&](size_t i) {
+      if (failed.load(std::memory_order_relaxed))
+        return;
+      const int c = pc + 2 * static_cast<int>(i % phaseCols);
+      const int r = pr + 2 * static_cast<int>(i / phaseCols);
+      const Span sx = spanOf(c, cols, input.width, overlap, halo);
+      const Span sy = spanOf(r, rows, input.height, overlap, halo);
+
+      const FrameView tileIn{input.data + size_t(sy.ext0) * input.stride +
+                                 size_t(sx.ext0) * 4,
+                             sx.ext1 - sx.ext0, sy.ext1 - sy.ext0,
+                             input.stride};
+      const FrameView tileOut{scratch.data() + pool.slot() * slotBytes,
+                              2 * tileIn.width, 2 * tileIn.height,
+                              tileStride};
+      if (!fn(user, tileIn, tileOut)) {
+        failed = true;
+        return;
+      }
+
+      // The halo only fed the network; its output is dropped, and the
+      // next same-phase tile may be writing there.
+      for (int oy = 2 * sy.blend0; oy < 2 * sy.blend1; ++oy) {
+        const int wy = weightAt(sy, overlap, oy);
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(
+            tileOut.row(oy - 2 * sy.ext0));
+        uint8_t *dst = reinterpret_cast<uint8_t *>(output.row(oy)) +
+                       size_t(2 * sx.ext0) * 4;
+        for (int tx = 2 * (sx.blend0 - sx.ext0);
+             tx < 2 * (sx.blend1 - sx.ext0); ++tx) {
+          const int w = wy * weightAt(sx, overlap, 2 * sx.ext0 + tx);
+          if (w == 256 * 256) {
+            std::memcpy(dst + 4 * tx, src + 4 * tx, 4);
+            continue;
+          }
+          for (int ch = 0; ch < 4; ++ch) {
+            const int v =
+                dst[4 * tx + ch] + ((src[4 * tx + ch] * w + 32768) >> 16);
+            dst[4 * tx + ch] = static_cast<uint8_t>(v > 255 ? 255 : v);
+          }
+        }
+      }
+    });
+  }
+  return !failed;
+}
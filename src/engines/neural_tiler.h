@@ -0,0 +1,45 @@
+#pragma once
+// neural_tiler.h
+// Runs a 2x upscaling network over a frame in overlapping tiles so memory
+// is bounded by the tile size instead of the frame size.
+
+#include "../pipeline/frame.h"
+#include <cstddef>
+
+class ThreadPool;
+
+// Tile layout in input pixels. Neighbouring tiles share a band `overlap`
+// wide on each side of their common edge, which is cross-faded on output.
+// The network sees each tile's core and bands grown by a further `halo`
+// (its receptive field), so every pixel with nonzero weight was computed
+// from real input rather than the tile's replicated border.
+struct NeuralTilePlan {
+  int width = 0;
+  int height = 0;
+  int tileWidth = 0;
+  int tileHeight = 0;
+  int overlap = 0;
+  int halo = 0;
+  int cols = 0;
+  int rows = 0;
+
+  int count() const { return cols * rows; }
+};
+
+// Largest square tiles for which `workers` concurrent inferences stay
+// within `budgetBytes`, given the network's peak activation memory per
+// input pixel. Tiles never shrink below 2 * overlap + 16.
+NeuralTilePlan planNeuralTiles(int width, int height, size_t budgetBytes,
+                               unsigned workers, int overlap, int halo,
+                               size_t activationBytesPerPixel);
+
+// Upscales one tile: `in` is the extended input region, `out` a buffer of
+// exactly twice its extent. Called concurrently from pool threads.
+using NeuralTileFn = bool (*)(void *user, const FrameView &in,
+                              const FrameView &out);
+
+// Runs `fn` over every tile of `plan` on `pool` and blends the results
+// into `output` (2x the input). Returns false if any tile failed.
+bool runTiledUpscale(const FrameView &input, const FrameView &output,
+                     const NeuralTilePlan &plan, ThreadPool &pool,
+                     NeuralTileFn fn, void *user);
@@ -3,7 +3,59 @@
 #include "../injector/injector_host.h"
 #include "ui_MainWindow.h"
 #include <QFileDialog>
+#include <QLabel>
 #include <QMessageBox>
+#include <QPainter>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <QtCharts/QChart>
+#include <QtCharts/QChartView>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+#include <algorithm>
+
+namespace {
+
+constexpr int kPollMs = 100;
+constexpr int kFrameWindow = 600;   // frames on the frame-time graph
+constexpr double kStageWindowS = 30.0;
+constexpr int kStagePoints = 120;   // 30 s of stats at 4 Hz
+constexpr int kStalePolls = 30;     // ~3 s without new stats ends a session
+
+// A line chart over `series` with explicit axes the poller scrolls.
+QChartView *lineChart(const QString &title,
+                      std::initializer_list<QLineSeries *> series,
+                      QValueAxis *&axisX, QValueAxis *&axisY,
+                      QWidget *parent) {
+  auto *chart = new QChart;
+  chart->setTitle(title);
+  axisX = new QValueAxis;
+  axisY = new QValueAxis;
+  axisY->setMin(0.0);
+  chart->addAxis(axisX, Qt::AlignBottom);
+  chart->addAxis(axisY, Qt::AlignLeft);
+  for (QLineSeries *s : series) {
+    chart->addSeries(s);
+    s->attachAxis(axisX);
+    s->attachAxis(axisY);
+  }
+  auto *view = new QChartView(chart, parent);
+  view->setRenderHint(QPainter::Antialiasing);
+  return view;
+}
+
+// Keeps the last `keep` points and returns the largest y among them, for
+// the axis.
+double trimSeries(QLineSeries *s, int keep) {
+  if (s->count() > keep)
+    s->removePoints(0, s->count() - keep);
+  double maxY = 0.0;
+  for (const QPointF &p : s->points())
+    maxY = std::max(maxY, p.y());
+  return maxY;
+}
+
+} // namespace
 
 
 MainWindow::MainWindow(QWidget *parent)
@@ -20,6 +72,8 @@ MainWindow::MainWindow(QWidget *parent)
       connect(injectBtn, &QPushButton::clicked, this,
               &MainWindow::onInjectClicked);
   }
+  if (ui->tabRealtime)
+    buildSessionView();
 }
 
 MainWindow::~MainWindow() { delete ui; }
@@ -38,10 +92,120 @@ void MainWindow::onInjectClicked() {
   // emit injectionRequested(exePath, dllPath); // Optional: keep if other
   // components need to know
 
-  if (InjectorHost::inject(exePath.toStdString(), dllPath.toStdString())) {
+  unsigned long pid = 0;
+  if (InjectorHost::inject(exePath.toStdString(), dllPath.toStdString(),
+                           &pid)) {
+    startSession(pid);
     QMessageBox::information(this, tr("Inject"), tr("Injection successful!"));
   } else {
     QMessageBox::critical(this, tr("Inject"), tr("Injection failed."));
   }
 }
+void MainWindow::buildSessionView() {
+  QWidget *tab = ui->tabRealtime;
+  auto *layout = new QVBoxLayout(tab);
+  if (auto *injectBtn = tab->findChild<QPushButton *>("injectButton"))
+    layout->addWidget(injectBtn, 0, Qt::AlignLeft);
+  sessionLabel_ = new QLabel(tr("No session."), tab);
+  layout->addWidget(sessionLabel_);
+
+  frameSeries_ = new QLineSeries;
+  frameSeries_->setName(tr("frame"));
+  upscaleSeries_ = new QLineSeries;
+  upscaleSeries_->setName(tr("upscale"));
+  layout->addWidget(lineChart(tr("Frame time (ms)"),
+                              {frameSeries_, upscaleSeries_}, frameAxisX_,
+                              frameAxisY_, tab));
+
+  auto *stageChart = lineChart(tr("Stage cost, p95 (ms)"), {}, stageAxisX_,
+                               stageAxisY_, tab);
+  for (size_t i = 0; i < stageSeries_.size(); ++i) {
+    auto *s = new QLineSeries;
+    s->setName(stageName(static_cast<Stage>(i)));
+    stageChart->chart()->addSeries(s);
+    s->attachAxis(stageAxisX_);
+    s->attachAxis(stageAxisY_);
+    stageSeries_[i] = s;
+  }
+  layout->addWidget(stageChart);
+
+  pollTimer_ = new QTimer(this);
+  connect(pollTimer_, &QTimer::timeout, this, &MainWindow::pollTelemetry);
+}
+
+void MainWindow::startSession(unsigned long pid) {
+  if (!pollTimer_)
+    return;
+  sessionPid_ = pid;
+  telemetry_ = std::make_unique<TelemetryReader>();
+  frameBuffer_.resize(kTelemetryFrames);
+  nextFrame_ = 0;
+  firstStatsNs_ = lastStatsNs_ = 0;
+  stalePolls_ = 0;
+  frameSeries_->clear();
+  upscaleSeries_->clear();
+  for (QLineSeries *s : stageSeries_)
+    s->clear();
+  sessionLabel_->setText(
+      tr("Waiting for process %1 to present...").arg(sessionPid_));
+  pollTimer_->start(kPollMs);
+}
+
+void MainWindow::pollTelemetry() {
+  // The segment appears once the DLL has hooked the first swapchain.
+  if (!telemetry_->isOpen() &&
+      !telemetry_->open(static_cast<uint32_t>(sessionPid_)))
+    return;
+
+  const size_t n = telemetry_->readFrames(nextFrame_, frameBuffer_.data(),
+                                          frameBuffer_.size());
+  for (size_t i = 0; i < n; ++i) {
+    const FrameSample &f = frameBuffer_[i];
+    frameSeries_->append(static_cast<double>(f.frame), f.frameMs);
+    upscaleSeries_->append(static_cast<double>(f.frame), f.upscaleMs);
+    nextFrame_ = f.frame + 1;
+  }
+  if (n > 0) {
+    const double maxY = std::max(trimSeries(frameSeries_, kFrameWindow),
+                                 trimSeries(upscaleSeries_, kFrameWindow));
+    const double end = static_cast<double>(nextFrame_);
+    frameAxisX_->setRange(std::max(0.0, end - kFrameWindow),
+                          std::max(double(kFrameWindow), end));
+    frameAxisY_->setRange(0.0, maxY * 1.1 + 1.0);
+  }
+
+  StatsSample stats;
+  if (!telemetry_->readStats(stats) || stats.timeNs == lastStatsNs_) {
+    // The writer republishes several times a second while it runs.
+    if (lastStatsNs_ != 0 && ++stalePolls_ > kStalePolls) {
+      pollTimer_->stop();
+      telemetry_->close();
+      sessionLabel_->setText(tr("Process %1 ended.").arg(sessionPid_));
+    }
+    return;
+  }
+  stalePolls_ = 0;
+  if (firstStatsNs_ == 0)
+    firstStatsNs_ = stats.timeNs;
+  lastStatsNs_ = stats.timeNs;
+
+  const double t = (stats.timeNs - firstStatsNs_) * 1e-9;
+  double maxY = 0.0;
+  for (size_t i = 0; i < stageSeries_.size(); ++i) {
+    if (stats.stages[i].count == 0)
+      continue;
+    stageSeries_[i]->append(t, stats.stages[i].p95Ms);
+    maxY = std::max(maxY, trimSeries(stageSeries_[i], kStagePoints));
+  }
+  stageAxisX_->setRange(std::max(0.0, t - kStageWindowS),
+                        std::max(kStageWindowS, t));
+  stageAxisY_->setRange(0.0, maxY * 1.1 + 0.1);
+
+  sessionLabel_->setText(tr("Process %1: %2 fps, frame p99 %3 ms, 1% low "
+                            "%4 fps")
+                             .arg(sessionPid_)
+                             .arg(stats.fps, 0, 'f', 1)
+                             .arg(stats.frames.p99Ms, 0, 'f', 2)
+                             .arg(stats.frames.low1PctFps, 0, 'f', 1));
+}
 #endif
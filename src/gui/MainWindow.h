@@ -1,10 +1,19 @@
 #pragma once
 
 #ifdef OMNIFORGE_HAVE_QT
+#include "../utils/telemetry.h"
 #include <QMainWindow>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
+class QLabel;
+class QLineSeries;
+class QTimer;
+class QValueAxis;
 QT_END_NAMESPACE
 
 class MainWindow : public QMainWindow {
@@ -19,7 +28,32 @@ public slots:
 signals:
     void injectionRequested(const QString &exePath, const QString &dllPath);
 
+private slots:
+    // Pulls new frames and stats from the session's telemetry segment.
+    void pollTelemetry();
+
 private:
+    void buildSessionView();
+    void startSession(unsigned long pid);
+
     Ui::MainWindow *ui;
+
+    // Live view of the injected process (see utils/telemetry.h).
+    std::unique_ptr<TelemetryReader> telemetry_;
+    std::vector<FrameSample> frameBuffer_;
+    unsigned long sessionPid_ = 0;
+    uint64_t nextFrame_ = 0;
+    uint64_t firstStatsNs_ = 0;
+    uint64_t lastStatsNs_ = 0;
+    int stalePolls_ = 0;
+    QTimer *pollTimer_ = nullptr;
+    QLabel *sessionLabel_ = nullptr;
+    QLineSeries *frameSeries_ = nullptr;
+    QLineSeries *upscaleSeries_ = nullptr;
+    QValueAxis *frameAxisX_ = nullptr;
+    QValueAxis *frameAxisY_ = nullptr;
+    std::array<QLineSeries *, static_cast<size_t>(Stage::Count)> stageSeries_{};
+    QValueAxis *stageAxisX_ = nullptr;
+    QValueAxis *stageAxisY_ = nullptr;
 };
 #endif
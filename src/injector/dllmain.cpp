@@ -1,6 +1,6 @@
 // dllmain.cpp - injector DLL entry and MinHook stubs
+#include "../utils/log.h"
 #include <MinHook.h>
-#include <iostream>
 #include <windows.h>
 
 // Forward declarations for hook functions
@@ -24,16 +24,15 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpReserved) {
   case DLL_PROCESS_ATTACH:
     DisableThreadLibraryCalls(hinstDLL);
     if (MH_Initialize() != MH_OK) {
-      std::cerr << "Failed to initialize MinHook." << std::endl;
+      OMNIFORGE_LOG_ERROR("Failed to initialize MinHook.");
       return FALSE;
     }
-    std::cerr << "Omniforge injector DLL attached. MinHook initialized."
-              << std::endl;
+    OMNIFORGE_LOG_INFO("Omniforge injector DLL attached. MinHook initialized.");
     break;
   case DLL_PROCESS_DETACH:
     MH_DisableHook(MH_ALL_HOOKS);
     MH_Uninitialize();
-    std::cerr << "Omniforge injector DLL detached." << std::endl;
+    OMNIFORGE_LOG_INFO("Omniforge injector DLL detached.");
     break;
   }
   return TRUE;
@@ -44,6 +43,6 @@ bool initializeCapture();
 }
 
 extern "C" __declspec(dllexport) bool installHooks() {
-  std::cerr << "installHooks() called. Initializing capture..." << std::endl;
+  OMNIFORGE_LOG_INFO("installHooks() called. Initializing capture...");
   return initializeCapture();
 }
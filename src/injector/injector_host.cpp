@@ -4,7 +4,8 @@
 
 
 bool InjectorHost::inject(const std::string &exePath,
-                          const std::string &dllPath) {
+                          const std::string &dllPath,
+                          unsigned long *processId) {
   STARTUPINFOA si = {sizeof(si)};
   PROCESS_INFORMATION pi = {0};
 
@@ -50,6 +51,8 @@ bool InjectorHost::inject(const std::string &exePath,
 
   // Resume main thread
   ResumeThread(pi.hThread);
+  if (processId)
+    *processId = pi.dwProcessId;
 
   CloseHandle(pi.hProcess);
   CloseHandle(pi.hThread);
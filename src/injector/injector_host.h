@@ -3,5 +3,8 @@
 
 class InjectorHost {
 public:
-  static bool inject(const std::string &exePath, const std::string &dllPath);
+  // Starts `exePath` with the DLL loaded; its process id goes to
+  // `processId` (for TelemetryReader) when given.
+  static bool inject(const std::string &exePath, const std::string &dllPath,
+                     unsigned long *processId = nullptr);
 };
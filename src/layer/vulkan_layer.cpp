@@ -0,0 +1,312 @@
+// vulkan_layer.cpp
+// VK_LAYER_OMNIFORGE_upscale: the capture hooks packaged as a Vulkan layer
+// for Linux, where there is no DLL injection. The loader calls these entry
+// points directly through its dispatch tables, and each one calls the next
+// layer or the driver through pointers resolved once at instance or device
+// creation, so there is no trampoline on the way. Works with any ICD,
+// including Mesa's lavapipe for GPU-less runs.
+
+#include "../capture/swapchain_tracker.h"
+#include "../engines/neural_engine.h"
+#include "../utils/log.h"
+#include "../utils/metrics.h"
+#include "../utils/snapshot_map.h"
+#include "../utils/telemetry.h"
+#include "../utils/trace.h"
+#include <cstring>
+#include <memory>
+#include <vulkan/vk_layer.h>
+#include <vulkan/vulkan.h>
+
+#define OMNIFORGE_LAYER_EXPORT extern "C" __attribute__((visibility("default")))
+
+namespace {
+
+struct InstanceDispatch {
+  VkInstance instance = VK_NULL_HANDLE;
+  PFN_vkGetInstanceProcAddr getInstanceProcAddr = nullptr;
+  PFN_vkDestroyInstance destroyInstance = nullptr;
+};
+
+struct DeviceDispatch {
+  PFN_vkGetDeviceProcAddr getDeviceProcAddr = nullptr;
+  PFN_vkDestroyDevice destroyDevice = nullptr;
+  PFN_vkCreateSwapchainKHR createSwapchain = nullptr;
+  PFN_vkDestroySwapchainKHR destroySwapchain = nullptr;
+  PFN_vkGetSwapchainImagesKHR getSwapchainImages = nullptr;
+  PFN_vkQueuePresentKHR queuePresent = nullptr;
+};
+
+// Dispatchable handles start with the loader's dispatch table pointer, which
+// physical devices share with their instance and queues with their device.
+template <typename T> void *dispatchKey(T handle) {
+  return *reinterpret_cast<void **>(handle);
+}
+
+// Looked up on every call, written only on instance/device create/destroy.
+SnapshotMap<void *, InstanceDispatch> g_instances;
+SnapshotMap<void *, DeviceDispatch> g_devices;
+
+InstanceDispatch instanceOf(void *key) {
+  InstanceDispatch d;
+  g_instances.with(key, [&](const InstanceDispatch &found) { d = found; });
+  return d;
+}
+
+DeviceDispatch deviceOf(void *key) {
+  DeviceDispatch d;
+  g_devices.with(key, [&](const DeviceDispatch &found) { d = found; });
+  return d;
+}
+
+// The loader's link info for this layer in a create info's pNext chain.
+template <typename Info, typename Create>
+Info *layerLinkInfo(const Create *createInfo, VkStructureType type) {
+  auto *info = static_cast<Info *>(const_cast<void *>(createInfo->pNext));
+  while (info && !(info->sType == type && info->function == VK_LAYER_LINK_INFO))
+    info = static_cast<Info *>(const_cast<void *>(info->pNext));
+  return info;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+layerCreateInstance(const VkInstanceCreateInfo *pCreateInfo,
+                    const VkAllocationCallbacks *pAllocator,
+                    VkInstance *pInstance) {
+  auto *link = layerLinkInfo<VkLayerInstanceCreateInfo>(
+      pCreateInfo, VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO);
+  if (!link || !link->u.pLayerInfo)
+    return VK_ERROR_INITIALIZATION_FAILED;
+  PFN_vkGetInstanceProcAddr next =
+      link->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+  auto create = reinterpret_cast<PFN_vkCreateInstance>(
+      next(VK_NULL_HANDLE, "vkCreateInstance"));
+  if (!create)
+    return VK_ERROR_INITIALIZATION_FAILED;
+
+  // The next layer reads its own link entry.
+  link->u.pLayerInfo = link->u.pLayerInfo->pNext;
+  const VkResult result = create(pCreateInfo, pAllocator, pInstance);
+  if (result != VK_SUCCESS)
+    return result;
+
+  auto d = std::make_unique<InstanceDispatch>();
+  d->instance = *pInstance;
+  d->getInstanceProcAddr = next;
+  d->destroyInstance = reinterpret_cast<PFN_vkDestroyInstance>(
+      next(*pInstance, "vkDestroyInstance"));
+  g_instances.insert(dispatchKey(*pInstance), std::move(d));
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+layerDestroyInstance(VkInstance instance,
+                     const VkAllocationCallbacks *pAllocator) {
+  if (instance == VK_NULL_HANDLE)
+    return;
+  std::unique_ptr<InstanceDispatch> d =
+      g_instances.erase(dispatchKey(instance));
+  if (d && d->destroyInstance)
+    d->destroyInstance(instance, pAllocator);
+  // Games rarely get to unload the layer cleanly, so this is where a trace
+  // (if OMNIFORGE_TRACE is set) gets written and the log caught up.
+  Tracer::shared().flushAsync();
+  Logger::shared().flush();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+layerCreateDevice(VkPhysicalDevice physicalDevice,
+                  const VkDeviceCreateInfo *pCreateInfo,
+                  const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
+  auto *link = layerLinkInfo<VkLayerDeviceCreateInfo>(
+      pCreateInfo, VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO);
+  if (!link || !link->u.pLayerInfo)
+    return VK_ERROR_INITIALIZATION_FAILED;
+  PFN_vkGetInstanceProcAddr nextInstance =
+      link->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+  PFN_vkGetDeviceProcAddr nextDevice =
+      link->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+  const InstanceDispatch instance = instanceOf(dispatchKey(physicalDevice));
+  auto create = reinterpret_cast<PFN_vkCreateDevice>(
+      nextInstance(instance.instance, "vkCreateDevice"));
+  if (!create)
+    return VK_ERROR_INITIALIZATION_FAILED;
+
+  link->u.pLayerInfo = link->u.pLayerInfo->pNext;
+  const VkResult result =
+      create(physicalDevice, pCreateInfo, pAllocator, pDevice);
+  if (result != VK_SUCCESS)
+    return result;
+
+  const VkDevice device = *pDevice;
+  auto d = std::make_unique<DeviceDispatch>();
+  d->getDeviceProcAddr = nextDevice;
+  d->destroyDevice = reinterpret_cast<PFN_vkDestroyDevice>(
+      nextDevice(device, "vkDestroyDevice"));
+  d->createSwapchain = reinterpret_cast<PFN_vkCreateSwapchainKHR>(
+      nextDevice(device, "vkCreateSwapchainKHR"));
+  d->destroySwapchain = reinterpret_cast<PFN_vkDestroySwapchainKHR>(
+      nextDevice(device, "vkDestroySwapchainKHR"));
+  d->getSwapchainImages = reinterpret_cast<PFN_vkGetSwapchainImagesKHR>(
+      nextDevice(device, "vkGetSwapchainImagesKHR"));
+  d->queuePresent = reinterpret_cast<PFN_vkQueuePresentKHR>(
+      nextDevice(device, "vkQueuePresentKHR"));
+  g_devices.insert(dispatchKey(device), std::move(d));
+
+  // Same as initializeCapture() on Windows: the model loads in the
+  // background while frames use FSR, and stats go out to the dashboard.
+  initNcnnVulkan();
+  TelemetryWriter::shared().open();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+layerDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+  if (device == VK_NULL_HANDLE)
+    return;
+  std::unique_ptr<DeviceDispatch> d = g_devices.erase(dispatchKey(device));
+  if (d && d->destroyDevice)
+    d->destroyDevice(device, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+layerCreateSwapchainKHR(VkDevice device,
+                        const VkSwapchainCreateInfoKHR *pCreateInfo,
+                        const VkAllocationCallbacks *pAllocator,
+                        VkSwapchainKHR *pSwapchain) {
+  const DeviceDispatch d = deviceOf(dispatchKey(device));
+  if (!d.createSwapchain)
+    return VK_ERROR_INITIALIZATION_FAILED;
+  const VkResult result =
+      d.createSwapchain(device, pCreateInfo, pAllocator, pSwapchain);
+  if (pCreateInfo)
+    onSwapchainCreated(pCreateInfo, result,
+                       pSwapchain ? *pSwapchain : VK_NULL_HANDLE);
+  return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+layerDestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain,
+                         const VkAllocationCallbacks *pAllocator) {
+  onSwapchainDestroyed(swapchain);
+  const DeviceDispatch d = deviceOf(dispatchKey(device));
+  if (d.destroySwapchain)
+    d.destroySwapchain(device, swapchain, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+layerGetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain,
+                           uint32_t *pSwapchainImageCount,
+                           VkImage *pSwapchainImages) {
+  const DeviceDispatch d = deviceOf(dispatchKey(device));
+  if (!d.getSwapchainImages)
+    return VK_ERROR_INITIALIZATION_FAILED;
+  const VkResult result = d.getSwapchainImages(
+      device, swapchain, pSwapchainImageCount, pSwapchainImages);
+  if (result == VK_SUCCESS && pSwapchainImages != nullptr)
+    onSwapchainImages(swapchain, *pSwapchainImageCount, pSwapchainImages);
+  return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+layerQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
+  Metrics &metrics = Metrics::shared();
+  const DeviceDispatch d = deviceOf(dispatchKey(queue));
+  if (!d.queuePresent)
+    return VK_ERROR_INITIALIZATION_FAILED;
+  if (pPresentInfo)
+    onQueuePresent(pPresentInfo);
+  VkResult result;
+  {
+    OMNIFORGE_TRACE_SCOPE("present");
+    StageTimer timer(metrics, Stage::Present);
+    result = d.queuePresent(queue, pPresentInfo);
+  }
+  metrics.framePresented();
+  return result;
+}
+
+// Device-level functions this layer implements; null if `name` is not one.
+PFN_vkVoidFunction deviceFunction(const char *name);
+
+} // namespace
+
+OMNIFORGE_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+OmniForge_GetDeviceProcAddr(VkDevice device, const char *pName) {
+  if (PFN_vkVoidFunction fn = deviceFunction(pName))
+    return fn;
+  const DeviceDispatch d = deviceOf(dispatchKey(device));
+  return d.getDeviceProcAddr ? d.getDeviceProcAddr(device, pName) : nullptr;
+}
+
+OMNIFORGE_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+OmniForge_GetInstanceProcAddr(VkInstance instance, const char *pName) {
+  struct Entry {
+    const char *name;
+    PFN_vkVoidFunction fn;
+  };
+  static const Entry kInstance[] = {
+      {"vkGetInstanceProcAddr",
+       reinterpret_cast<PFN_vkVoidFunction>(&OmniForge_GetInstanceProcAddr)},
+      {"vkCreateInstance",
+       reinterpret_cast<PFN_vkVoidFunction>(&layerCreateInstance)},
+      {"vkDestroyInstance",
+       reinterpret_cast<PFN_vkVoidFunction>(&layerDestroyInstance)},
+      {"vkCreateDevice",
+       reinterpret_cast<PFN_vkVoidFunction>(&layerCreateDevice)},
+  };
+  for (const Entry &e : kInstance)
+    if (std::strcmp(pName, e.name) == 0)
+      return e.fn;
+  // Device functions may be fetched through the instance too.
+  if (PFN_vkVoidFunction fn = deviceFunction(pName))
+    return fn;
+  if (instance == VK_NULL_HANDLE)
+    return nullptr;
+  const InstanceDispatch d = instanceOf(dispatchKey(instance));
+  return d.getInstanceProcAddr ? d.getInstanceProcAddr(instance, pName)
+                               : nullptr;
+}
+
+namespace {
+PFN_vkVoidFunction deviceFunction(const char *name) {
+  struct Entry {
+    const char *name;
+    PFN_vkVoidFunction fn;
+  };
+  static const Entry kDevice[] = {
+      {"vkGetDeviceProcAddr",
+       reinterpret_cast<PFN_vkVoidFunction>(&OmniForge_GetDeviceProcAddr)},
+      {"vkDestroyDevice",
+       reinterpret_cast<PFN_vkVoidFunction>(&layerDestroyDevice)},
+      {"vkCreateSwapchainKHR",
+       reinterpret_cast<PFN_vkVoidFunction>(&layerCreateSwapchainKHR)},
+      {"vkDestroySwapchainKHR",
+       reinterpret_cast<PFN_vkVoidFunction>(&layerDestroySwapchainKHR)},
+      {"vkGetSwapchainImagesKHR",
+       reinterpret_cast<PFN_vkVoidFunction>(&layerGetSwapchainImagesKHR)},
+      {"vkQueuePresentKHR",
+       reinterpret_cast<PFN_vkVoidFunction>(&layerQueuePresentKHR)},
+  };
+  for (const Entry &e : kDevice)
+    if (std::strcmp(name, e.name) == 0)
+      return e.fn;
+  return nullptr;
+}
+} // namespace
+
+// Loader-layer interface version 2: the loader gets both ProcAddr
+// functions from here instead of by exported name.
+OMNIFORGE_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkNegotiateLoaderLayerInterfaceVersion(
+    VkNegotiateLayerInterface *pVersionStruct) {
+  if (!pVersionStruct ||
+      pVersionStruct->sType != LAYER_NEGOTIATE_INTERFACE_STRUCT)
+    return VK_ERROR_INITIALIZATION_FAILED;
+  if (pVersionStruct->loaderLayerInterfaceVersion > 2)
+    pVersionStruct->loaderLayerInterfaceVersion = 2;
+  pVersionStruct->pfnGetInstanceProcAddr = &OmniForge_GetInstanceProcAddr;
+  pVersionStruct->pfnGetDeviceProcAddr = &OmniForge_GetDeviceProcAddr;
+  pVersionStruct->pfnGetPhysicalDeviceProcAddr = nullptr;
+  OMNIFORGE_LOG_INFO("omniforge_layer: loaded");
+  return VK_SUCCESS;
+}
@@ -0,0 +1,123 @@
+// dirty_tiles.cpp
+// Block hashing and dirty-tile marking.
+
+#include "dirty_tiles.h"
+#include "../utils/thread_pool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kStripe = 64;
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+
+// Arbitrary per-lane keys (XXH3's default secret, first 64 bytes).
+constexpr uint64_t kSecret[8] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull,
+    0x1f67b3b7a4a44072ull, 0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull,
+    0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull};
+
+inline void accumulate(uint64_t acc[8], const uint8_t *stripe) {
+  for (int i = 0; i < 8; ++i) {
+    uint64_t v;
+    std::memcpy(&v, stripe + 8 * i, 8);
+    const uint64_t k = v ^ kSecret[i];
+    acc[i ^ 1] += v;
+    acc[i] += (k & 0xffffffffu) * (k >> 32);
+  }
+}
+
+inline uint64_t avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+} // namespace
+
+uint64_t hashPixels(const uint8_t *data, size_t stride, int width,
+                    int height, int bytesPerPixel) {
+  uint64_t acc[8] = {kPrime3, kPrime1, kPrime2, kPrime1,
+                     kPrime2, kPrime3, kPrime1, kPrime2};
+  const size_t rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+  const size_t full = rowBytes / kStripe * kStripe;
+  for (int y = 0; y < height; ++y) {
+    const uint8_t *row = data + static_cast<size_t>(y) * stride;
+    for (size_t x = 0; x < full; x += kStripe)
+      accumulate(acc, row + x);
+    if (full < rowBytes) {
+      uint8_t tail[kStripe] = {};
+      std::memcpy(tail, row + full, rowBytes - full);
+      accumulate(acc, tail);
+    }
+  }
+  uint64_t h = (static_cast<uint64_t>(width) << 32 | uint32_t(height)) * kPrime1;
+  for (int i = 0; i < 8; ++i)
+    h = (h ^ avalanche(acc[i])) * kPrime1 + kPrime3;
+  return avalanche(h);
+}
+
+size_t DirtyTiles::update(const FrameView &input, const TileGrid &grid,
+                          int halo, ThreadPool &pool) {
+  if (input.width != width_ || input.height != height_) {
+    width_ = input.width;
+    height_ = input.height;
+    blocksX_ = (width_ + kBlock - 1) / kBlock;
+    blocksY_ = (height_ + kBlock - 1) / kBlock;
+    hashes_.assign(static_cast<size_t>(blocksX_) * blocksY_, 0);
+    changed_.assign(hashes_.size(), 1);
+    valid_ = false;
+  }
+  dirty_.resize(static_cast<size_t>(grid.count()));
+
+  pool.parallelFor(static_cast<size_t>(blocksY_), [&](size_t by) {
+    const int y0 = static_cast<int>(by) * kBlock;
+    const int h = std::min(kBlock, height_ - y0);
+    for (int bx = 0; bx < blocksX_; ++bx) {
+      const int x0 = bx * kBlock;
+      const int bytes = pixelBytes(input.format);
+      const uint64_t hash =
+          hashPixels(input.data + static_cast<size_t>(y0) * input.stride +
+                         static_cast<size_t>(x0) * bytes,
+                     input.stride, std::min(kBlock, width_ - x0), h, bytes);
+      const size_t i = by * static_cast<size_t>(blocksX_) + bx;
+      changed_[i] = !valid_ || hash != hashes_[i];
+      hashes_[i] = hash;
+    }
+  });
+  const bool wasValid = valid_;
+  valid_ = true;
+  if (!wasValid) {
+    std::fill(dirty_.begin(), dirty_.end(), uint8_t(1));
+    return dirty_.size();
+  }
+
+  size_t count = 0;
+  for (int t = 0; t < grid.count(); ++t) {
+    // Input footprint of the tile plus the halo, in blocks.
+    const Tile tile = grid.tile(t);
+    const int ix0 = static_cast<int>(int64_t(tile.x0) * width_ / grid.width);
+    const int iy0 = static_cast<int>(int64_t(tile.y0) * height_ / grid.height);
+    const int ix1 = static_cast<int>(
+        (int64_t(tile.x1) * width_ + grid.width - 1) / grid.width);
+    const int iy1 = static_cast<int>(
+        (int64_t(tile.y1) * height_ + grid.height - 1) / grid.height);
+    const int bx0 = std::max(0, ix0 - halo) / kBlock;
+    const int by0 = std::max(0, iy0 - halo) / kBlock;
+    const int bx1 = std::min(blocksX_ - 1, (ix1 + halo - 1) / kBlock);
+    const int by1 = std::min(blocksY_ - 1, (iy1 + halo - 1) / kBlock);
+
+    uint8_t d = 0;
+    for (int by = by0; by <= by1 && !d; ++by)
+      for (int bx = bx0; bx <= bx1 && !d; ++bx)
+        d = changed_[static_cast<size_t>(by) * blocksX_ + bx];
+    dirty_[static_cast<size_t>(t)] = d;
+    count += d;
+  }
+  return count;
+}
@@ -0,0 +1,51 @@
+#pragma once
+// dirty_tiles.h
+// Change detection between consecutive frames of one swapchain, so the CPU
+// frame path can skip tiles whose input did not change.
+
+#include "frame.h"
+#include "tiling.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// 64-bit content hash of a width x height region of pixels of the given
+// size. XXH3-style: eight 64-bit lanes fed by 32x32->64 bit multiplies,
+// which compilers map onto packed multiplies, over one 64-byte stripe at a
+// time.
+uint64_t hashPixels(const uint8_t *data, size_t stride, int width, int height,
+                    int bytesPerPixel = 4);
+
+// Keeps a hash per kBlock x kBlock input block of the previous frame.
+// update() rehashes the new frame and marks the output tiles whose input
+// footprint, grown by the stage's reach, touches a block that changed.
+// Storage is only reallocated when the extent or grid changes.
+class DirtyTiles {
+public:
+  static constexpr int kBlock = 16;
+
+  // `grid` tiles the output, which maps linearly onto `input`; `halo` is
+  // how many input pixels beyond a tile's footprint can affect it. With no
+  // previous frame of the same extent every tile is dirty. Returns the
+  // number of dirty tiles.
+  size_t update(const FrameView &input, const TileGrid &grid, int halo,
+                ThreadPool &pool);
+
+  bool dirty(int tile) const { return dirty_[static_cast<size_t>(tile)] != 0; }
+
+  // Forgets the previous frame, e.g. after the output was produced some
+  // other way.
+  void invalidate() { valid_ = false; }
+
+private:
+  int width_ = 0;
+  int height_ = 0;
+  int blocksX_ = 0;
+  int blocksY_ = 0;
+  bool valid_ = false;
+  std::vector<uint64_t> hashes_;
+  std::vector<uint8_t> changed_; // per block
+  std::vector<uint8_t> dirty_;   // per tile
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Pixel layouts the CPU kernels read and write natively, i.e. the
+// presentable swapchain formats. Named in memory order for the 8-bit ones;
+// RGB10A2 is a 32-bit word with R in the low bits (A2B10G10R10 in Vulkan),
+// RGBA16F four half floats.
+enum class PixelFormat : uint8_t { RGBA8, BGRA8, RGB10A2, RGBA16F };
+
+inline int pixelBytes(PixelFormat format) {
+  return format == PixelFormat::RGBA16F ? 8 : 4;
+}
+
+// Non-owning view of a CPU-side frame. Rows are `stride` bytes apart.
+// row() addresses 32-bit words, so an RGBA16F pixel is two of them.
+struct FrameView {
+  uint8_t *data = nullptr;
+  int width = 0;
+  int height = 0;
+  size_t stride = 0;
+  PixelFormat format = PixelFormat::RGBA8;
+
+  uint32_t *row(int y) const {
+    return reinterpret_cast<uint32_t *>(data + static_cast<size_t>(y) * stride);
+  }
+
+  bool valid() const {
+    return data && width > 0 && height > 0 &&
+           stride >= static_cast<size_t>(width) * pixelBytes(format);
+  }
+};
@@ -0,0 +1,251 @@
+// fsr_cpu.cpp
+// Portable build of the CPU FSR kernels and the runtime ISA dispatch.
+
+#include "fsr_cpu.h"
+#include "../utils/cpu_features.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// One lane per "vector"; used where SSE4.1 is unavailable and as the
+// reference the SIMD builds are checked against.
+struct Scalar {
+  static constexpr int kWidth = 1;
+  static constexpr bool kPermute = false;
+  using F = float;
+  using I = int32_t;
+  using M = bool;
+
+  static F splat(float f) { return f; }
+  static F iota() { return 0.0f; }
+  static F floor(F a) { return std::floor(a); }
+  static I toInt(F a) { return static_cast<I>(a); }
+  static F min(F a, F b) { return a < b ? a : b; }
+  static F max(F a, F b) { return a > b ? a : b; }
+  static F abs(F a) { return std::fabs(a); }
+  static M less(F a, F b) { return a < b; }
+  static F select(M m, F a, F b) { return m ? a : b; }
+  static F div(F a, F b) { return a / b; }
+
+  // APrxLoRcpF1 / APrxLoRsqF1 from ffx_a.h.
+  static F rcpApprox(F a) {
+    uint32_t u;
+    std::memcpy(&u, &a, sizeof(u));
+    u = 0x7ef07ebbu - u;
+    std::memcpy(&a, &u, sizeof(u));
+    return a;
+  }
+  static F rsqApprox(F a) {
+    uint32_t u;
+    std::memcpy(&u, &a, sizeof(u));
+    u = 0x5f347d74u - (u >> 1);
+    std::memcpy(&a, &u, sizeof(u));
+    return a;
+  }
+
+  static I clamp(I a, int lo, int hi) { return a < lo ? lo : (a > hi ? hi : a); }
+  static I load(const uint32_t *p) { return static_cast<I>(*p); }
+  static F loadF(const float *p) { return *p; }
+  static I gather(const uint32_t *row, I col) {
+    return static_cast<I>(row[col]);
+  }
+  static void store(uint32_t *dst, I px, int) {
+    *dst = static_cast<uint32_t>(px);
+  }
+
+  static I bitAnd(I a, uint32_t mask) {
+    return static_cast<I>(static_cast<uint32_t>(a) & mask);
+  }
+  static I bitOr(I a, I b) { return a | b; }
+  template <int N> static I shl(I a) {
+    return static_cast<I>(static_cast<uint32_t>(a) << N);
+  }
+  template <int N> static I shr(I a) {
+    return static_cast<I>(static_cast<uint32_t>(a) >> N);
+  }
+  static F toFloat(I a) { return static_cast<F>(a); }
+  static I round(F a) { return static_cast<I>(std::lrint(a)); }
+
+  // Half float conversions matching F16C: round to nearest even, with
+  // denormals, infinities and NaN. The SSE4.1 build does the same per lane.
+  static F halfToFloat(I h) {
+    const uint32_t expMant = static_cast<uint32_t>(h) & 0x7fffu;
+    uint32_t u = expMant << 13;
+    F f;
+    std::memcpy(&f, &u, sizeof(f));
+    f *= 0x1p112f; // rebias the exponent; also normalizes denormals
+    std::memcpy(&u, &f, sizeof(u));
+    if (expMant > 0x7bffu)
+      u |= 0x7f800000u;
+    u |= (static_cast<uint32_t>(h) & 0x8000u) << 16;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+  }
+  static I floatToHalf(F f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    const uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+    uint32_t h;
+    if (u >= 0x47800000u) { // past the half range, or inf/NaN
+      h = u > 0x7f800000u ? 0x7e00u : 0x7c00u;
+    } else if (u < 0x38800000u) { // half denormal or zero
+      F v;
+      std::memcpy(&v, &u, sizeof(v));
+      v += 0.5f; // lines the half mantissa up with the low bits
+      std::memcpy(&h, &v, sizeof(h));
+      h -= 0x3f000000u;
+    } else {
+      const uint32_t odd = (u >> 13) & 1u;
+      h = (u + 0xc8000fffu + odd) >> 13;
+    }
+    return static_cast<I>(h | (sign >> 16));
+  }
+  static void loadPairs(const uint32_t *p, I &even, I &odd) {
+    even = static_cast<I>(p[0]);
+    odd = static_cast<I>(p[1]);
+  }
+  static void storePairs(uint32_t *p, I even, I odd, int) {
+    p[0] = static_cast<uint32_t>(even);
+    p[1] = static_cast<uint32_t>(odd);
+  }
+};
+
+} // namespace
+
+#include "fsr_easu_kernel.h"
+#include "fsr_rcas_kernel.h"
+
+#ifdef OMNIFORGE_HAVE_X86_SIMD
+void fsrEasuSse41(const FsrConstants &consts, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1,
+                  int ox, int oy);
+void fsrEasuAvx2(const FsrConstants &consts, const FrameView &input,
+                 const FrameView &output, int x0, int y0, int x1, int y1,
+                 int ox, int oy);
+void fsrRcasSse41(const FsrConstants &consts, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1);
+void fsrRcasAvx2(const FsrConstants &consts, const FrameView &input,
+                 const FrameView &output, int x0, int y0, int x1, int y1);
+#endif
+
+namespace {
+
+#ifdef OMNIFORGE_HAVE_X86_SIMD
+// The AVX2 build converts half floats with F16C.
+bool useAvx2(const CpuFeatures &cpu, PixelFormat format) {
+  return cpu.avx2 && (cpu.f16c || format != PixelFormat::RGBA16F);
+}
+#endif
+
+void easuDispatch(const FsrConstants &consts, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1,
+                  int ox, int oy) {
+#ifdef OMNIFORGE_HAVE_X86_SIMD
+  const CpuFeatures &cpu = cpuFeatures();
+  if (useAvx2(cpu, output.format))
+    return fsrEasuAvx2(consts, input, output, x0, y0, x1, y1, ox, oy);
+  if (cpu.sse41)
+    return fsrEasuSse41(consts, input, output, x0, y0, x1, y1, ox, oy);
+#endif
+  easuRect<Scalar>(consts, input, output, x0, y0, x1, y1, ox, oy);
+}
+
+void rcasDispatch(const FsrConstants &consts, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1) {
+#ifdef OMNIFORGE_HAVE_X86_SIMD
+  const CpuFeatures &cpu = cpuFeatures();
+  if (useAvx2(cpu, output.format))
+    return fsrRcasAvx2(consts, input, output, x0, y0, x1, y1);
+  if (cpu.sse41)
+    return fsrRcasSse41(consts, input, output, x0, y0, x1, y1);
+#endif
+  rcasRect<Scalar>(consts, input, output, x0, y0, x1, y1);
+}
+
+size_t fusedScratchStride(int tileWidth, PixelFormat format) {
+  return (static_cast<size_t>(tileWidth + 2) * pixelBytes(format) + 63) &
+         ~size_t(63);
+}
+
+} // namespace
+
+FsrRatio fsrRatio(int viewportWidth, int viewportHeight, int inputWidth,
+                  int inputHeight, int outputWidth, int outputHeight) {
+  if (viewportWidth != inputWidth || viewportHeight != inputHeight)
+    return FsrRatio::Any;
+  auto scaledBy = [&](int num, int den) {
+    return int64_t(outputWidth) * den == int64_t(inputWidth) * num &&
+           int64_t(outputHeight) * den == int64_t(inputHeight) * num;
+  };
+  if (scaledBy(2, 1))
+    return FsrRatio::X2;
+  if (scaledBy(3, 2))
+    return FsrRatio::X1_5;
+  if (scaledBy(3, 1))
+    return FsrRatio::X3;
+  return FsrRatio::Any;
+}
+
+void fsrEasu(const FsrConstants &consts, const FrameView &input,
+             const FrameView &output, int x0, int y0, int x1, int y1) {
+  if (!input.valid() || !output.valid() || input.format != output.format ||
+      x0 >= x1 || y0 >= y1)
+    return;
+  easuDispatch(consts, input, output, x0, y0, x1, y1, 0, 0);
+}
+
+void fsrRcas(const FsrConstants &consts, const FrameView &input,
+             const FrameView &output, int x0, int y0, int x1, int y1) {
+  if (!input.valid() || !output.valid() || input.format != output.format ||
+      x0 >= x1 || y0 >= y1)
+    return;
+  rcasDispatch(consts, input, output, x0, y0, x1, y1);
+}
+
+size_t fsrFusedScratchBytes(int tileWidth, int tileHeight,
+                            PixelFormat format) {
+  return fusedScratchStride(tileWidth, format) *
+         static_cast<size_t>(tileHeight + 2);
+}
+
+void fsrEasuRcasTile(const FsrConstants &consts, const FrameView &input,
+                     const FrameView &output, int x0, int y0, int x1, int y1,
+                     uint8_t *scratch, FsrTileTiming *timing) {
+  if (!input.valid() || !output.valid() || input.format != output.format ||
+      !scratch || x0 >= x1 || y0 >= y1)
+    return;
+
+  // EASU region: the tile plus the one-pixel ring RCAS reads, clipped to the
+  // frame. Where it is clipped, RCAS clamping inside the scratch matches
+  // clamping at the frame edge.
+  const int sx0 = x0 > 0 ? x0 - 1 : 0;
+  const int sy0 = y0 > 0 ? y0 - 1 : 0;
+  const int sx1 = x1 < output.width ? x1 + 1 : output.width;
+  const int sy1 = y1 < output.height ? y1 + 1 : output.height;
+  FrameView upscaled{scratch, sx1 - sx0, sy1 - sy0,
+                     fusedScratchStride(x1 - x0, output.format), output.format};
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point t0 = timing ? Clock::now() : Clock::time_point();
+  easuDispatch(consts, input, upscaled, sx0, sy0, sx1, sy1, sx0, sy0);
+  const Clock::time_point t1 = timing ? Clock::now() : Clock::time_point();
+
+  // RCAS reads the scratch and writes the tile in place in the output,
+  // addressed relative to the scratch origin.
+  FrameView target{output.data + static_cast<size_t>(sy0) * output.stride +
+                       static_cast<size_t>(sx0) * pixelBytes(output.format),
+                   upscaled.width, upscaled.height, output.stride,
+                   output.format};
+  rcasDispatch(consts, upscaled, target, x0 - sx0, y0 - sy0, x1 - sx0,
+               y1 - sy0);
+
+  if (timing) {
+    const Clock::time_point t2 = Clock::now();
+    timing->easuNs += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    timing->rcasNs += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+// fsr_cpu.h
+// CPU implementation of the FSR1 passes. The kernels are driven by the same
+// constant blocks FsrEasuCon/FsrRcasCon produce for the GPU shaders.
+
+#include "frame.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Output:input ratios the EASU kernels are specialized for. Their sampling
+// phases repeat every two or three output pixels, so the kernels take them
+// from a small table instead of computing a position per pixel, and on AVX2
+// fetch the taps with one load and a permute instead of gathers. Any other
+// ratio, or a reduced viewport, runs the generic kernel.
+enum class FsrRatio : uint8_t { Any, X1_5, X2, X3 };
+
+struct FsrConstants {
+  uint32_t easu[4][4];
+  uint32_t rcas[4][4];
+  FsrRatio ratio = FsrRatio::Any; // CPU kernels only; set by setupFSR()
+};
+
+// The specialized ratio for this setup, if there is one. Both axes must
+// scale by exactly the same ratio and the whole input must be rendered.
+FsrRatio fsrRatio(int viewportWidth, int viewportHeight, int inputWidth,
+                  int inputHeight, int outputWidth, int outputHeight);
+
+// `viewport` is the part of the input actually rendered, anchored at the
+// top-left; smaller than the input when running at reduced internal
+// resolution.
+void setupFSR(FsrConstants &consts, int viewportWidth, int viewportHeight,
+              int inputWidth, int inputHeight, int outputWidth,
+              int outputHeight);
+
+inline void setupFSR(FsrConstants &consts, int inputWidth, int inputHeight,
+                     int outputWidth, int outputHeight) {
+  setupFSR(consts, inputWidth, inputHeight, inputWidth, inputHeight,
+           outputWidth, outputHeight);
+}
+
+// Constant blocks hold float values as raw bits (AU1_AF1).
+inline float fsrConstant(uint32_t bits) {
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// EASU upscale of `input` into the output rectangle [x0, x1) x [y0, y1) of
+// `output`. Picks the widest SIMD path the host supports. All passes work
+// on the frames' own pixel format, which input and output must share.
+void fsrEasu(const FsrConstants &consts, const FrameView &input,
+             const FrameView &output, int x0, int y0, int x1, int y1);
+
+inline void fsrEasu(const FsrConstants &consts, const FrameView &input,
+                    const FrameView &output) {
+  fsrEasu(consts, input, output, 0, 0, output.width, output.height);
+}
+
+// RCAS sharpening of `input` into the same rectangle of `output`. Both
+// frames have the same extent and must not alias.
+void fsrRcas(const FsrConstants &consts, const FrameView &input,
+             const FrameView &output, int x0, int y0, int x1, int y1);
+
+// Time spent in each half of a fused tile, for per-stage metrics.
+struct FsrTileTiming {
+  uint64_t easuNs = 0;
+  uint64_t rcasNs = 0;
+};
+
+// Fused EASU + RCAS of the output tile [x0, x1) x [y0, y1). The EASU result
+// for the tile and the one-pixel ring RCAS needs is produced into `scratch`
+// and sharpened straight into `output`, so the upscaled intermediate stays
+// in cache instead of making a full-frame round trip through memory.
+// `scratch` needs fsrFusedScratchBytes(x1 - x0, y1 - y0, output.format)
+// bytes, 64-byte aligned, and must not be shared between threads.
+size_t fsrFusedScratchBytes(int tileWidth, int tileHeight,
+                            PixelFormat format = PixelFormat::RGBA8);
+void fsrEasuRcasTile(const FsrConstants &consts, const FrameView &input,
+                     const FrameView &output, int x0, int y0, int x1, int y1,
+                     uint8_t *scratch, FsrTileTiming *timing = nullptr);
@@ -0,0 +1,151 @@
+// fsr_cpu_avx2.cpp
+// AVX2/FMA build of the CPU FSR kernels: 8 output pixels per iteration,
+// EASU taps fetched with hardware gathers. Compiled with AVX2 (and F16C, for
+// RGBA16F frames) enabled for this file only; fsr_cpu.cpp calls into it
+// after checking cpuFeatures().
+
+#include <immintrin.h>
+
+#include "fsr_cpu.h"
+
+namespace {
+
+struct Avx2 {
+  static constexpr int kWidth = 8;
+  static constexpr bool kPermute = true;
+
+  struct F {
+    __m256 v;
+    friend F operator+(F a, F b) { return {_mm256_add_ps(a.v, b.v)}; }
+    friend F operator-(F a, F b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    friend F operator*(F a, F b) { return {_mm256_mul_ps(a.v, b.v)}; }
+  };
+  struct I {
+    __m256i v;
+    friend I operator+(I a, int b) {
+      return {_mm256_add_epi32(a.v, _mm256_set1_epi32(b))};
+    }
+  };
+  using M = F;
+
+  static F splat(float f) { return {_mm256_set1_ps(f)}; }
+  static F iota() { return {_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)}; }
+  static F floor(F a) { return {_mm256_floor_ps(a.v)}; }
+  static I toInt(F a) { return {_mm256_cvttps_epi32(a.v)}; }
+  static F min(F a, F b) { return {_mm256_min_ps(a.v, b.v)}; }
+  static F max(F a, F b) { return {_mm256_max_ps(a.v, b.v)}; }
+  static F abs(F a) {
+    return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)};
+  }
+  static M less(F a, F b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+  static F select(M m, F a, F b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+  static F div(F a, F b) { return {_mm256_div_ps(a.v, b.v)}; }
+
+  // APrxLoRcpF1 / APrxLoRsqF1 from ffx_a.h.
+  static F rcpApprox(F a) {
+    return {_mm256_castsi256_ps(_mm256_sub_epi32(
+        _mm256_set1_epi32(0x7ef07ebb), _mm256_castps_si256(a.v)))};
+  }
+  static F rsqApprox(F a) {
+    return {_mm256_castsi256_ps(
+        _mm256_sub_epi32(_mm256_set1_epi32(0x5f347d74),
+                         _mm256_srli_epi32(_mm256_castps_si256(a.v), 1)))};
+  }
+
+  static I clamp(I a, int lo, int hi) {
+    return {_mm256_min_epi32(_mm256_max_epi32(a.v, _mm256_set1_epi32(lo)),
+                             _mm256_set1_epi32(hi))};
+  }
+  static I load(const uint32_t *p) {
+    return {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))};
+  }
+  static F loadF(const float *p) { return {_mm256_loadu_ps(p)}; }
+  static I permute(I v, I lanes) {
+    return {_mm256_permutevar8x32_epi32(v.v, lanes.v)};
+  }
+  // Lanes 0..15 of lo:hi; the permutes only look at the low three bits.
+  static I permute(I lo, I hi, I lanes) {
+    const __m256i fromHi = _mm256_cmpgt_epi32(lanes.v, _mm256_set1_epi32(7));
+    return {_mm256_blendv_epi8(_mm256_permutevar8x32_epi32(lo.v, lanes.v),
+                               _mm256_permutevar8x32_epi32(hi.v, lanes.v),
+                               fromHi)};
+  }
+  static I gather(const uint32_t *row, I col) {
+    return {_mm256_i32gather_epi32(reinterpret_cast<const int *>(row), col.v,
+                                   4)};
+  }
+  static void store(uint32_t *dst, I px, int count) {
+    if (count == kWidth) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), px.v);
+      return;
+    }
+    alignas(32) uint32_t tmp[kWidth];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(tmp), px.v);
+    for (int i = 0; i < count; ++i)
+      dst[i] = tmp[i];
+  }
+
+  static I bitAnd(I a, uint32_t mask) {
+    return {_mm256_and_si256(a.v, _mm256_set1_epi32(static_cast<int>(mask)))};
+  }
+  static I bitOr(I a, I b) { return {_mm256_or_si256(a.v, b.v)}; }
+  template <int N> static I shl(I a) { return {_mm256_slli_epi32(a.v, N)}; }
+  template <int N> static I shr(I a) { return {_mm256_srli_epi32(a.v, N)}; }
+  static F toFloat(I a) { return {_mm256_cvtepi32_ps(a.v)}; }
+  static I round(F a) { return {_mm256_cvtps_epi32(a.v)}; }
+
+  // F16C; fsr_cpu.cpp only comes here for RGBA16F if the host has it.
+  static F halfToFloat(I h) {
+    const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(h.v),
+                                            _mm256_extracti128_si256(h.v, 1));
+    return {_mm256_cvtph_ps(packed)};
+  }
+  static I floatToHalf(F f) {
+    return {_mm256_cvtepu16_epi32(
+        _mm256_cvtps_ph(f.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC))};
+  }
+  static void loadPairs(const uint32_t *p, I &even, I &odd) {
+    const __m256 a = _mm256_loadu_ps(reinterpret_cast<const float *>(p));
+    const __m256 b = _mm256_loadu_ps(reinterpret_cast<const float *>(p + 8));
+    // Pixels 0 1 4 5 | 2 3 6 7 after the in-lane shuffles.
+    even.v = _mm256_permute4x64_epi64(
+        _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+        _MM_SHUFFLE(3, 1, 2, 0));
+    odd.v = _mm256_permute4x64_epi64(
+        _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))),
+        _MM_SHUFFLE(3, 1, 2, 0));
+  }
+  static void storePairs(uint32_t *p, I even, I odd, int count) {
+    // Pixels 0 1 4 5 and 2 3 6 7 interleaved.
+    const __m256i lo = _mm256_unpacklo_epi32(even.v, odd.v);
+    const __m256i hi = _mm256_unpackhi_epi32(even.v, odd.v);
+    const __m256i first = _mm256_permute2x128_si256(lo, hi, 0x20);
+    const __m256i second = _mm256_permute2x128_si256(lo, hi, 0x31);
+    if (count == kWidth) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), first);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + 8), second);
+      return;
+    }
+    alignas(32) uint32_t tmp[2 * kWidth];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(tmp), first);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(tmp + 8), second);
+    for (int i = 0; i < 2 * count; ++i)
+      p[i] = tmp[i];
+  }
+};
+
+} // namespace
+
+#include "fsr_easu_kernel.h"
+#include "fsr_rcas_kernel.h"
+
+void fsrEasuAvx2(const FsrConstants &consts, const FrameView &input,
+                 const FrameView &output, int x0, int y0, int x1, int y1,
+                 int ox, int oy) {
+  easuRect<Avx2>(consts, input, output, x0, y0, x1, y1, ox, oy);
+}
+
+void fsrRcasAvx2(const FsrConstants &consts, const FrameView &input,
+                 const FrameView &output, int x0, int y0, int x1, int y1) {
+  rcasRect<Avx2>(consts, input, output, x0, y0, x1, y1);
+}
@@ -0,0 +1,161 @@
+// fsr_cpu_sse41.cpp
+// SSE4.1 build of the CPU FSR kernels: 4 output pixels per iteration. There
+// is no gather before AVX2, so EASU taps are assembled from scalar loads.
+
+#include <smmintrin.h>
+
+#include "fsr_cpu.h"
+
+namespace {
+
+struct Sse41 {
+  static constexpr int kWidth = 4;
+  // Four lanes never hold a whole 4x4 footprint row; taps stay gathers.
+  static constexpr bool kPermute = false;
+
+  struct F {
+    __m128 v;
+    friend F operator+(F a, F b) { return {_mm_add_ps(a.v, b.v)}; }
+    friend F operator-(F a, F b) { return {_mm_sub_ps(a.v, b.v)}; }
+    friend F operator*(F a, F b) { return {_mm_mul_ps(a.v, b.v)}; }
+  };
+  struct I {
+    __m128i v;
+    friend I operator+(I a, int b) {
+      return {_mm_add_epi32(a.v, _mm_set1_epi32(b))};
+    }
+  };
+  using M = F;
+
+  static F splat(float f) { return {_mm_set1_ps(f)}; }
+  static F iota() { return {_mm_setr_ps(0, 1, 2, 3)}; }
+  static F floor(F a) { return {_mm_floor_ps(a.v)}; }
+  static I toInt(F a) { return {_mm_cvttps_epi32(a.v)}; }
+  static F min(F a, F b) { return {_mm_min_ps(a.v, b.v)}; }
+  static F max(F a, F b) { return {_mm_max_ps(a.v, b.v)}; }
+  static F abs(F a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+  static M less(F a, F b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+  static F select(M m, F a, F b) { return {_mm_blendv_ps(b.v, a.v, m.v)}; }
+  static F div(F a, F b) { return {_mm_div_ps(a.v, b.v)}; }
+
+  // APrxLoRcpF1 / APrxLoRsqF1 from ffx_a.h.
+  static F rcpApprox(F a) {
+    return {_mm_castsi128_ps(
+        _mm_sub_epi32(_mm_set1_epi32(0x7ef07ebb), _mm_castps_si128(a.v)))};
+  }
+  static F rsqApprox(F a) {
+    return {_mm_castsi128_ps(_mm_sub_epi32(
+        _mm_set1_epi32(0x5f347d74), _mm_srli_epi32(_mm_castps_si128(a.v), 1)))};
+  }
+
+  static I clamp(I a, int lo, int hi) {
+    return {_mm_min_epi32(_mm_max_epi32(a.v, _mm_set1_epi32(lo)),
+                          _mm_set1_epi32(hi))};
+  }
+  static I load(const uint32_t *p) {
+    return {_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))};
+  }
+  static F loadF(const float *p) { return {_mm_loadu_ps(p)}; }
+  static I gather(const uint32_t *row, I col) {
+    return {_mm_setr_epi32(static_cast<int>(row[_mm_cvtsi128_si32(col.v)]),
+                           static_cast<int>(row[_mm_extract_epi32(col.v, 1)]),
+                           static_cast<int>(row[_mm_extract_epi32(col.v, 2)]),
+                           static_cast<int>(row[_mm_extract_epi32(col.v, 3)]))};
+  }
+  static void store(uint32_t *dst, I px, int count) {
+    if (count == kWidth) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), px.v);
+      return;
+    }
+    alignas(16) uint32_t tmp[kWidth];
+    _mm_store_si128(reinterpret_cast<__m128i *>(tmp), px.v);
+    for (int i = 0; i < count; ++i)
+      dst[i] = tmp[i];
+  }
+
+  static I bitAnd(I a, uint32_t mask) {
+    return {_mm_and_si128(a.v, _mm_set1_epi32(static_cast<int>(mask)))};
+  }
+  static I bitOr(I a, I b) { return {_mm_or_si128(a.v, b.v)}; }
+  template <int N> static I shl(I a) { return {_mm_slli_epi32(a.v, N)}; }
+  template <int N> static I shr(I a) { return {_mm_srli_epi32(a.v, N)}; }
+  static F toFloat(I a) { return {_mm_cvtepi32_ps(a.v)}; }
+  static I round(F a) { return {_mm_cvtps_epi32(a.v)}; }
+
+  // No F16C here; these are the scalar build's conversions, per lane.
+  static F halfToFloat(I h) {
+    const __m128i expMant = _mm_and_si128(h.v, _mm_set1_epi32(0x7fff));
+    const __m128 scaled =
+        _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)),
+                   _mm_set1_ps(0x1p112f));
+    const __m128i infNan =
+        _mm_and_si128(_mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7bff)),
+                      _mm_set1_epi32(0x7f800000));
+    const __m128i sign =
+        _mm_slli_epi32(_mm_and_si128(h.v, _mm_set1_epi32(0x8000)), 16);
+    return {_mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(infNan, sign)))};
+  }
+  static I floatToHalf(F f) {
+    const __m128i bits = _mm_castps_si128(f.v);
+    const __m128i sign =
+        _mm_and_si128(bits, _mm_set1_epi32(static_cast<int>(0x80000000u)));
+    const __m128i u = _mm_xor_si128(bits, sign);
+    // Past the half range, or inf/NaN.
+    const __m128i big = _mm_cmpgt_epi32(u, _mm_set1_epi32(0x477fffff));
+    const __m128i nan = _mm_cmpgt_epi32(u, _mm_set1_epi32(0x7f800000));
+    const __m128i hBig = _mm_blendv_epi8(_mm_set1_epi32(0x7c00),
+                                         _mm_set1_epi32(0x7e00), nan);
+    // Half denormal or zero.
+    const __m128i small = _mm_cmplt_epi32(u, _mm_set1_epi32(0x38800000));
+    const __m128i hSmall = _mm_sub_epi32(
+        _mm_castps_si128(
+            _mm_add_ps(_mm_castsi128_ps(u), _mm_set1_ps(0.5f))),
+        _mm_set1_epi32(0x3f000000));
+    const __m128i odd =
+        _mm_and_si128(_mm_srli_epi32(u, 13), _mm_set1_epi32(1));
+    const __m128i hNormal = _mm_srli_epi32(
+        _mm_add_epi32(_mm_add_epi32(u, _mm_set1_epi32(
+                                           static_cast<int>(0xc8000fffu))),
+                      odd),
+        13);
+    const __m128i h = _mm_blendv_epi8(_mm_blendv_epi8(hNormal, hSmall, small),
+                                      hBig, big);
+    return {_mm_or_si128(h, _mm_srli_epi32(sign, 16))};
+  }
+  static void loadPairs(const uint32_t *p, I &even, I &odd) {
+    const __m128 a = _mm_loadu_ps(reinterpret_cast<const float *>(p));
+    const __m128 b = _mm_loadu_ps(reinterpret_cast<const float *>(p + 4));
+    even.v = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    odd.v = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  static void storePairs(uint32_t *p, I even, I odd, int count) {
+    const __m128i lo = _mm_unpacklo_epi32(even.v, odd.v);
+    const __m128i hi = _mm_unpackhi_epi32(even.v, odd.v);
+    if (count == kWidth) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(p), lo);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 4), hi);
+      return;
+    }
+    alignas(16) uint32_t tmp[2 * kWidth];
+    _mm_store_si128(reinterpret_cast<__m128i *>(tmp), lo);
+    _mm_store_si128(reinterpret_cast<__m128i *>(tmp + 4), hi);
+    for (int i = 0; i < 2 * count; ++i)
+      p[i] = tmp[i];
+  }
+};
+
+} // namespace
+
+#include "fsr_easu_kernel.h"
+#include "fsr_rcas_kernel.h"
+
+void fsrEasuSse41(const FsrConstants &consts, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1,
+                  int ox, int oy) {
+  easuRect<Sse41>(consts, input, output, x0, y0, x1, y1, ox, oy);
+}
+
+void fsrRcasSse41(const FsrConstants &consts, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1) {
+  rcasRect<Sse41>(consts, input, output, x0, y0, x1, y1);
+}
@@ -0,0 +1,388 @@
+// fsr_easu_kernel.h
+// Vector-width agnostic body of the CPU EASU pass (FsrEasuF from
+// ffx_fsr1.h), one output pixel per SIMD lane.
+//
+// Only include this from the per-ISA translation units (fsr_cpu.cpp,
+// fsr_cpu_sse41.cpp, fsr_cpu_avx2.cpp), after defining the lane traits `S`
+// inside an anonymous namespace:
+//   S::kWidth            lanes per vector
+//   S::F / S::I / S::M   float, int32 and mask vectors
+//   splat, iota, floor, toInt, min, max, abs, less, select,
+//   rcpApprox, rsqApprox, div, clamp, load, loadF, gather, store
+//   S::kPermute          true if permute(v, lanes) and permute(lo, hi,
+//                        lanes) pick lanes out of one or two loaded
+//                        vectors (an in-register gather)
+// and the pixel format traits listed in fsr_pixel_kernel.h.
+//
+// Colour math runs on the raw channel values of the pixel format (0..255
+// for 8-bit); EASU is scale invariant apart from the direction cut-off,
+// which is scaled to match.
+
+#include "fsr_cpu.h"
+#include "fsr_pixel_kernel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+template <class S, class P> struct EasuTap {
+  typename P::Px px;
+  typename S::F r, g, b, l;
+};
+
+template <class S, class P>
+inline EasuTap<S, P> easuUnpack(typename P::Px px) {
+  EasuTap<S, P> t;
+  t.px = px;
+  P::unpack(t.px, t.r, t.g, t.b);
+  // Luma times 2, as in FsrEasuF.
+  t.l = t.b * S::splat(0.5f) + (t.r * S::splat(0.5f) + t.g);
+  return t;
+}
+
+// FsrEasuSetF: accumulates gradient direction and edge length of one corner
+// of the 2x2 bilinear footprint.
+//    a
+//  b c d
+//    e
+template <class S>
+inline void easuSet(typename S::F &dirX, typename S::F &dirY,
+                    typename S::F &len, typename S::F w, typename S::F lA,
+                    typename S::F lB, typename S::F lC, typename S::F lD,
+                    typename S::F lE) {
+  using F = typename S::F;
+  const F zero = S::splat(0.0f);
+  const F one = S::splat(1.0f);
+
+  F dc = lD - lC;
+  F cb = lC - lB;
+  F lenX = S::rcpApprox(S::max(S::abs(dc), S::abs(cb)));
+  F dx = lD - lB;
+  dirX = dirX + dx * w;
+  lenX = S::min(S::max(S::abs(dx) * lenX, zero), one);
+  len = len + lenX * lenX * w;
+
+  F ec = lE - lC;
+  F ca = lC - lA;
+  F lenY = S::rcpApprox(S::max(S::abs(ec), S::abs(ca)));
+  F dy = lE - lA;
+  dirY = dirY + dy * w;
+  lenY = S::min(S::max(S::abs(dy) * lenY, zero), one);
+  len = len + lenY * lenY * w;
+}
+
+// FsrEasuTapF: one tap of the approximated, anisotropic lanczos2 window.
+template <class S> struct EasuAccum {
+  typename S::F r, g, b, w;
+};
+
+template <class S, class P>
+inline void easuTap(EasuAccum<S> &acc, typename S::F offX, typename S::F offY,
+                    typename S::F dirX, typename S::F dirY,
+                    typename S::F len2X, typename S::F len2Y,
+                    typename S::F lob, typename S::F clp,
+                    const EasuTap<S, P> &t) {
+  using F = typename S::F;
+  const F one = S::splat(1.0f);
+
+  F vx = (offX * dirX + offY * dirY) * len2X;
+  F vy = (offY * dirX - offX * dirY) * len2Y;
+  F d2 = S::min(vx * vx + vy * vy, clp);
+  //  (25/16 * (2/5 * x^2 - 1)^2 - (25/16 - 1)) * (1/4 * x^2 - 1)^2
+  F wB = S::splat(2.0f / 5.0f) * d2 - one;
+  F wA = lob * d2 - one;
+  wB = wB * wB;
+  wA = wA * wA;
+  wB = S::splat(25.0f / 16.0f) * wB - S::splat(25.0f / 16.0f - 1.0f);
+  F w = wB * wA;
+  acc.r = acc.r + t.r * w;
+  acc.g = acc.g + t.g * w;
+  acc.b = acc.b + t.b * w;
+  acc.w = acc.w + w;
+}
+
+// Input columns ix - 1 .. ix + 2 of a vector of output pixels, where ix is
+// each pixel's base texel and px its fraction.
+template <class S> struct EasuCols {
+  typename S::F px;
+  typename S::I col[4]; // clamped to the frame, for gathers
+  // Unless -1, the first of S::kWidth (or, if `wide`, 2 * S::kWidth)
+  // columns that hold all of the above; taps are then picked from those
+  // loads by `lane`.
+  int window = -1;
+  bool wide = false;
+  typename S::I lane[4];
+};
+
+template <class S, class P>
+inline EasuTap<S, P> easuFetch(const EasuCols<S> &c, const uint32_t *row,
+                               int k) {
+  if constexpr (P::kPermute) {
+    if (c.window >= 0 && !c.wide)
+      return easuUnpack<S, P>(S::permute(S::load(row + c.window), c.lane[k]));
+    if (c.window >= 0)
+      return easuUnpack<S, P>(S::permute(S::load(row + c.window),
+                                         S::load(row + c.window + S::kWidth),
+                                         c.lane[k]));
+  }
+  return easuUnpack<S, P>(P::gather(row, c.col[k]));
+}
+
+// Sampling phases for any ratio: position = pixel * scale + offset, as set
+// up by FsrEasuCon, computed per row and per vector of pixels.
+template <class S> class EasuPhaseAny {
+public:
+  EasuPhaseAny(const FsrConstants &consts, int maxX)
+      : scaleX_(fsrConstant(consts.easu[0][0])),
+        scaleY_(fsrConstant(consts.easu[0][1])),
+        offsetX_(fsrConstant(consts.easu[0][2])),
+        offsetY_(fsrConstant(consts.easu[0][3])), maxX_(maxX) {}
+
+  void row(int y, int &iy, float &fy) const {
+    const float ppy = static_cast<float>(y) * scaleY_ + offsetY_;
+    const float fpy = std::floor(ppy);
+    iy = static_cast<int>(fpy);
+    fy = ppy - fpy;
+  }
+
+  void cols(int x, EasuCols<S> &c) const {
+    typename S::F ppx =
+        (S::iota() + S::splat(static_cast<float>(x))) * S::splat(scaleX_) +
+        S::splat(offsetX_);
+    typename S::F fpx = S::floor(ppx);
+    c.px = ppx - fpx;
+    typename S::I ix = S::toInt(fpx);
+    for (int k = 0; k < 4; ++k)
+      c.col[k] = S::clamp(ix + (k - 1), 0, maxX_);
+  }
+
+private:
+  float scaleX_, scaleY_, offsetX_, offsetY_;
+  int maxX_;
+};
+
+// Sampling phases for an output:input ratio of Num:Den on both axes with
+// the whole input rendered. Pixel x = Num * k + r samples input position
+// Den * k + (Den * (2r + 1) - Num) / (2 Num), so base texel and fraction
+// only depend on r and come from tables built once per call. `Permute`
+// enables the load-and-permute windows of EasuCols.
+template <class S, int Num, int Den, bool Permute> class EasuPhaseFixed {
+public:
+  explicit EasuPhaseFixed(int maxX) : maxX_(maxX) {
+    int base[Num];
+    float frac[Num];
+    for (int r = 0; r < Num; ++r) {
+      // Floor division of a numerator that is negative for r = 0 below 2x.
+      const int n = Den * (2 * r + 1) - Num;
+      base[r] = (n >= 0 ? n : n - (2 * Num - 1)) / (2 * Num);
+      frac[r] = static_cast<float>(n - base[r] * 2 * Num) / (2 * Num);
+      rowBase_[r] = base[r];
+      rowFrac_[r] = frac[r];
+    }
+    // A vector starting at residue r covers residues r .. r + kWidth - 1.
+    for (int r = 0; r < Num; ++r) {
+      for (int l = 0; l < S::kWidth; ++l) {
+        const int t = r + l;
+        base_[r][l] = Den * (t / Num) + base[t % Num];
+        frac_[r][l] = frac[t % Num];
+      }
+      const int lo = base_[r][0];
+      const int span = base_[r][S::kWidth - 1] - lo + 4;
+      fits_[r] = span <= 2 * S::kWidth;
+      wide_[r] = span > S::kWidth;
+      for (int k = 0; k < 4; ++k)
+        for (int l = 0; l < S::kWidth; ++l)
+          lane_[r][k][l] = base_[r][l] - lo + k;
+    }
+  }
+
+  void row(int y, int &iy, float &fy) const {
+    const int r = y % Num;
+    iy = Den * (y / Num) + rowBase_[r];
+    fy = rowFrac_[r];
+  }
+
+  void cols(int x, EasuCols<S> &c) const {
+    const int r = x % Num;
+    const int origin = Den * (x / Num);
+    c.px = S::loadF(frac_[r]);
+    if constexpr (Permute) {
+      // Away from the frame edges nothing needs clamping, so the 4x4
+      // footprints of all lanes come out of one or two loads per row.
+      const int window = origin + base_[r][0] - 1;
+      const int loaded = wide_[r] ? 2 * S::kWidth : S::kWidth;
+      if (fits_[r] && window >= 0 && window + loaded <= maxX_ + 1) {
+        c.window = window;
+        c.wide = wide_[r];
+        for (int k = 0; k < 4; ++k)
+          c.lane[k] = S::load(reinterpret_cast<const uint32_t *>(lane_[r][k]));
+        return;
+      }
+      c.window = -1;
+    }
+    const typename S::I ix =
+        S::load(reinterpret_cast<const uint32_t *>(base_[r])) + origin;
+    for (int k = 0; k < 4; ++k)
+      c.col[k] = S::clamp(ix + (k - 1), 0, maxX_);
+  }
+
+private:
+  int maxX_;
+  int rowBase_[Num];
+  float rowFrac_[Num];
+  alignas(32) int32_t base_[Num][S::kWidth];
+  alignas(32) float frac_[Num][S::kWidth];
+  alignas(32) int32_t lane_[Num][4][S::kWidth];
+  bool fits_[Num];
+  bool wide_[Num];
+};
+
+// Output pixel (x, y) is written to output.row(y - oy)[x - ox], so a tile can
+// be produced straight into a small scratch buffer.
+template <class S, class P, class Phase>
+void easuRectWith(const Phase &phase, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1,
+                  int ox, int oy) {
+  using F = typename S::F;
+  using M = typename S::M;
+
+  const int maxY = input.height - 1;
+
+  const F zero = S::splat(0.0f);
+  const F one = S::splat(1.0f);
+  const F half = S::splat(0.5f);
+
+  for (int y = y0; y < y1; ++y) {
+    int iy;
+    float fy;
+    phase.row(y, iy, fy);
+    const F py = S::splat(fy);
+
+    //    b c        row 0
+    //  e f g h      row 1
+    //  i j k l      row 2
+    //    n o        row 3
+    const uint32_t *r0 = input.row(std::min(std::max(iy - 1, 0), maxY));
+    const uint32_t *r1 = input.row(std::min(std::max(iy, 0), maxY));
+    const uint32_t *r2 = input.row(std::min(std::max(iy + 1, 0), maxY));
+    const uint32_t *r3 = input.row(std::min(std::max(iy + 2, 0), maxY));
+    uint32_t *dst = output.row(y - oy);
+
+    EasuCols<S> cols;
+    for (int x = x0; x < x1; x += S::kWidth) {
+      phase.cols(x, cols);
+      const F px = cols.px;
+
+      using Tap = EasuTap<S, P>;
+      Tap b = easuFetch<S, P>(cols, r0, 1), c = easuFetch<S, P>(cols, r0, 2);
+      Tap e = easuFetch<S, P>(cols, r1, 0), f = easuFetch<S, P>(cols, r1, 1);
+      Tap g = easuFetch<S, P>(cols, r1, 2), h = easuFetch<S, P>(cols, r1, 3);
+      Tap i = easuFetch<S, P>(cols, r2, 0), j = easuFetch<S, P>(cols, r2, 1);
+      Tap k = easuFetch<S, P>(cols, r2, 2), l = easuFetch<S, P>(cols, r2, 3);
+      Tap n = easuFetch<S, P>(cols, r3, 1), o = easuFetch<S, P>(cols, r3, 2);
+
+      // Direction and length from the four bilinear corners.
+      F dirX = zero, dirY = zero, len = zero;
+      F qx = one - px, qy = one - py;
+      easuSet<S>(dirX, dirY, len, qx * qy, b.l, e.l, f.l, g.l, j.l);
+      easuSet<S>(dirX, dirY, len, px * qy, c.l, f.l, g.l, h.l, k.l);
+      easuSet<S>(dirX, dirY, len, qx * py, f.l, i.l, j.l, k.l, n.l);
+      easuSet<S>(dirX, dirY, len, px * py, g.l, j.l, k.l, l.l, o.l);
+
+      // Normalize, cleaning up close to zero.
+      F dir2 = dirX * dirX + dirY * dirY;
+      M zro = S::less(dir2, S::splat(P::kOne * P::kOne / 32768.0f));
+      F dirR = S::select(zro, one, S::rsqApprox(dir2));
+      dirX = S::select(zro, one, dirX) * dirR;
+      dirY = dirY * dirR;
+
+      // {0 to 2} -> {0 to 1}, shaped with a square.
+      len = len * half;
+      len = len * len;
+      // Stretch kernel {1.0 vert|horz, to sqrt(2.0) on diagonal}.
+      F stretch = (dirX * dirX + dirY * dirY) *
+                  S::rcpApprox(S::max(S::abs(dirX), S::abs(dirY)));
+      F len2X = one + (stretch - one) * len;
+      F len2Y = one + S::splat(-0.5f) * len;
+      F lob = half + S::splat((1.0f / 4.0f - 0.04f) - 0.5f) * len;
+      F clp = S::rcpApprox(lob);
+
+      EasuAccum<S> acc{zero, zero, zero, zero};
+      easuTap<S>(acc, zero - px, S::splat(-1.0f) - py, dirX, dirY, len2X,
+                 len2Y, lob, clp, b);
+      easuTap<S>(acc, one - px, S::splat(-1.0f) - py, dirX, dirY, len2X,
+                 len2Y, lob, clp, c);
+      easuTap<S>(acc, S::splat(-1.0f) - px, one - py, dirX, dirY, len2X,
+                 len2Y, lob, clp, i);
+      easuTap<S>(acc, zero - px, one - py, dirX, dirY, len2X, len2Y, lob, clp,
+                 j);
+      easuTap<S>(acc, zero - px, zero - py, dirX, dirY, len2X, len2Y, lob,
+                 clp, f);
+      easuTap<S>(acc, S::splat(-1.0f) - px, zero - py, dirX, dirY, len2X,
+                 len2Y, lob, clp, e);
+      easuTap<S>(acc, one - px, one - py, dirX, dirY, len2X, len2Y, lob, clp,
+                 k);
+      easuTap<S>(acc, S::splat(2.0f) - px, one - py, dirX, dirY, len2X,
+                 len2Y, lob, clp, l);
+      easuTap<S>(acc, S::splat(2.0f) - px, zero - py, dirX, dirY, len2X,
+                 len2Y, lob, clp, h);
+      easuTap<S>(acc, one - px, zero - py, dirX, dirY, len2X, len2Y, lob, clp,
+                 g);
+      easuTap<S>(acc, one - px, S::splat(2.0f) - py, dirX, dirY, len2X,
+                 len2Y, lob, clp, o);
+      easuTap<S>(acc, zero - px, S::splat(2.0f) - py, dirX, dirY, len2X,
+                 len2Y, lob, clp, n);
+
+      // Deringing: clamp to the min/max of the 4 nearest texels.
+      F rcpW = S::div(one, acc.w);
+      F outR = S::min(S::max(f.r, S::max(g.r, S::max(j.r, k.r))),
+                      S::max(S::min(f.r, S::min(g.r, S::min(j.r, k.r))),
+                             acc.r * rcpW));
+      F outG = S::min(S::max(f.g, S::max(g.g, S::max(j.g, k.g))),
+                      S::max(S::min(f.g, S::min(g.g, S::min(j.g, k.g))),
+                             acc.g * rcpW));
+      F outB = S::min(S::max(f.b, S::max(g.b, S::max(j.b, k.b))),
+                      S::max(S::min(f.b, S::min(g.b, S::min(j.b, k.b))),
+                             acc.b * rcpW));
+
+      // Presentable images ignore alpha; carry the base texel's through.
+      P::store(dst, x - ox, P::pack(outR, outG, outB, f.px),
+               std::min(S::kWidth, x1 - x));
+    }
+  }
+}
+
+template <class S, class P>
+void easuRectIn(const FsrConstants &consts, const FrameView &input,
+                const FrameView &output, int x0, int y0, int x1, int y1,
+                int ox, int oy) {
+  constexpr bool kPermute = P::kPermute;
+  const int maxX = input.width - 1;
+  switch (consts.ratio) {
+  case FsrRatio::X1_5:
+    return easuRectWith<S, P>(EasuPhaseFixed<S, 3, 2, kPermute>(maxX), input,
+                              output, x0, y0, x1, y1, ox, oy);
+  case FsrRatio::X2:
+    return easuRectWith<S, P>(EasuPhaseFixed<S, 2, 1, kPermute>(maxX), input,
+                              output, x0, y0, x1, y1, ox, oy);
+  case FsrRatio::X3:
+    return easuRectWith<S, P>(EasuPhaseFixed<S, 3, 1, kPermute>(maxX), input,
+                              output, x0, y0, x1, y1, ox, oy);
+  default:
+    return easuRectWith<S, P>(EasuPhaseAny<S>(consts, maxX), input, output,
+                              x0, y0, x1, y1, ox, oy);
+  }
+}
+
+// `input` and `output` share a pixel format; it picks the adapter.
+template <class S>
+void easuRect(const FsrConstants &consts, const FrameView &input,
+              const FrameView &output, int x0, int y0, int x1, int y1, int ox,
+              int oy) {
+  withPixels<S>(output.format, [&](auto pixels) {
+    easuRectIn<S, decltype(pixels)>(consts, input, output, x0, y0, x1, y1,
+                                    ox, oy);
+  });
+}
+
+} // namespace
@@ -0,0 +1,116 @@
+#pragma once
+// fsr_pixel_kernel.h
+// Pixel format adapters for the CPU FSR kernels, so EASU and RCAS read and
+// write the swapchain's own format instead of a canonical copy of it.
+//
+// Included by fsr_easu_kernel.h and fsr_rcas_kernel.h; the same rules
+// apply. On top of the traits those list, `S` provides:
+//   bitAnd, bitOr, shl<N>, shr<N>, toFloat, round
+//   halfToFloat, floatToHalf   half float in the low 16 bits of each lane
+//   loadPairs, storePairs      S::kWidth two-word pixels, split into their
+//                              first and second words
+//
+// An adapter `P` has:
+//   P::Px                 kWidth pixels as loaded
+//   P::kOne               channel value of full white, which the kernels'
+//                         few scale dependent constants are multiplied by
+//   P::kUnorm             false for float formats, whose values may go past
+//                         kOne (or below zero) and are not clamped
+//   P::kPermute           true if Px is a single S::I, so EASU may pick
+//                         taps out of loaded vectors with S::permute
+//   load, gather, unpack, pack, store
+
+#include "fsr_cpu.h"
+
+namespace {
+
+// Three channels and alpha in one 32-bit word. Channels are decoded to their
+// raw integer values (0..kOne), alpha bits pass through untouched.
+template <class S, int RShift, int GShift, int BShift, int Bits>
+struct PackedPixels {
+  using F = typename S::F;
+  using I = typename S::I;
+  using Px = I;
+
+  static constexpr float kOne = static_cast<float>((1 << Bits) - 1);
+  static constexpr bool kUnorm = true;
+  static constexpr bool kPermute = S::kPermute;
+  static constexpr uint32_t kMask = (1u << Bits) - 1;
+  static constexpr uint32_t kAlphaMask = ~0u << (3 * Bits);
+
+  static Px load(const uint32_t *row, int x) { return S::load(row + x); }
+  static Px gather(const uint32_t *row, I col) { return S::gather(row, col); }
+  static void unpack(Px px, F &r, F &g, F &b) {
+    r = S::toFloat(S::bitAnd(S::template shr<RShift>(px), kMask));
+    g = S::toFloat(S::bitAnd(S::template shr<GShift>(px), kMask));
+    b = S::toFloat(S::bitAnd(S::template shr<BShift>(px), kMask));
+  }
+  // Alpha bits are passed through from `alpha`.
+  static Px pack(F r, F g, F b, Px alpha) {
+    return S::bitOr(
+        S::bitOr(S::template shl<RShift>(S::round(r)),
+                 S::template shl<GShift>(S::round(g))),
+        S::bitOr(S::template shl<BShift>(S::round(b)),
+                 S::bitAnd(alpha, kAlphaMask)));
+  }
+  static void store(uint32_t *row, int x, Px px, int count) {
+    S::store(row + x, px, count);
+  }
+};
+
+template <class S> using Rgba8Pixels = PackedPixels<S, 0, 8, 16, 8>;
+template <class S> using Bgra8Pixels = PackedPixels<S, 16, 8, 0, 8>;
+template <class S> using Rgb10a2Pixels = PackedPixels<S, 0, 10, 20, 10>;
+
+// Four half floats, R and G in the first word, B and A in the second.
+// Linear (scRGB) values: 1.0 is SDR white and HDR highlights go past it.
+template <class S> struct HalfPixels {
+  using F = typename S::F;
+  using I = typename S::I;
+  struct Px {
+    I rg, ba;
+  };
+
+  static constexpr float kOne = 1.0f;
+  static constexpr bool kUnorm = false;
+  static constexpr bool kPermute = false;
+
+  static Px load(const uint32_t *row, int x) {
+    Px px;
+    S::loadPairs(row + 2 * x, px.rg, px.ba);
+    return px;
+  }
+  static Px gather(const uint32_t *row, I col) {
+    const I words = S::template shl<1>(col);
+    return {S::gather(row, words), S::gather(row + 1, words)};
+  }
+  static void unpack(Px px, F &r, F &g, F &b) {
+    r = S::halfToFloat(S::bitAnd(px.rg, 0xffffu));
+    g = S::halfToFloat(S::template shr<16>(px.rg));
+    b = S::halfToFloat(S::bitAnd(px.ba, 0xffffu));
+  }
+  static Px pack(F r, F g, F b, Px alpha) {
+    return {S::bitOr(S::floatToHalf(r),
+                     S::template shl<16>(S::floatToHalf(g))),
+            S::bitOr(S::floatToHalf(b), S::bitAnd(alpha.ba, 0xffff0000u))};
+  }
+  static void store(uint32_t *row, int x, Px px, int count) {
+    S::storePairs(row + 2 * x, px.rg, px.ba, count);
+  }
+};
+
+// Calls fn(P{}) with the adapter for `format`.
+template <class S, class Fn> inline void withPixels(PixelFormat format, Fn fn) {
+  switch (format) {
+  case PixelFormat::RGBA8:
+    return fn(Rgba8Pixels<S>());
+  case PixelFormat::BGRA8:
+    return fn(Bgra8Pixels<S>());
+  case PixelFormat::RGB10A2:
+    return fn(Rgb10a2Pixels<S>());
+  case PixelFormat::RGBA16F:
+    return fn(HalfPixels<S>());
+  }
+}
+
+} // namespace
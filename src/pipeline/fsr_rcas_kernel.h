@@ -0,0 +1,123 @@
+// fsr_rcas_kernel.h
+// Vector-width agnostic body of the CPU RCAS pass (FsrRcasF from
+// ffx_fsr1.h, without the optional denoise), one output pixel per SIMD lane.
+//
+// Include rules and lane traits are the same as fsr_easu_kernel.h. Like
+// EASU, the math runs on the pixel format's raw channel values; the peak
+// constants are scaled accordingly.
+
+#include "fsr_cpu.h"
+#include "fsr_pixel_kernel.h"
+#include <algorithm>
+
+namespace {
+
+template <class S> struct RcasPixel {
+  typename S::F r, g, b;
+};
+
+template <class S, class P>
+inline RcasPixel<S> rcasUnpack(typename P::Px px) {
+  RcasPixel<S> p;
+  P::unpack(px, p.r, p.g, p.b);
+  return p;
+}
+
+// Lobe contribution of one channel; guards keep flat black/white areas from
+// producing 0/0 where the GPU's rcp would have saturated. The peak is white
+// for unorm formats; for float ones it rises with the neighbourhood, so
+// highlights past SDR white are left unsharpened rather than ringing.
+template <class S, class P>
+inline typename S::F rcasLobe(typename S::F b, typename S::F d,
+                              typename S::F e, typename S::F f,
+                              typename S::F h) {
+  using F = typename S::F;
+  F mn4 = S::min(S::min(b, d), S::min(f, h));
+  F mx4 = S::max(S::max(b, d), S::max(f, h));
+  F peak = S::splat(P::kOne);
+  if constexpr (!P::kUnorm)
+    peak = S::max(peak, S::max(mx4, e));
+  F hitMin = S::div(S::min(mn4, e),
+                    S::max(S::splat(4.0f) * mx4, S::splat(1.0e-6f)));
+  F hitMax = S::div(peak - S::max(mx4, e),
+                    S::min(S::splat(4.0f) * (mn4 - peak),
+                           S::splat(-1.0e-6f)));
+  return S::max(S::splat(0.0f) - hitMin, hitMax);
+}
+
+template <class S, class P>
+void rcasRectIn(const FsrConstants &consts, const FrameView &input,
+              const FrameView &output, int x0, int y0, int x1, int y1) {
+  using F = typename S::F;
+  using I = typename S::I;
+  using Px = typename P::Px;
+
+  const F sharpness = S::splat(fsrConstant(consts.rcas[0][0]));
+  const F limit = S::splat(-(0.25f - 1.0f / 16.0f));
+  const F zero = S::splat(0.0f);
+  const F one = S::splat(1.0f);
+  const F peak = S::splat(P::kOne);
+  const int maxX = input.width - 1;
+  const int maxY = input.height - 1;
+
+  for (int y = y0; y < y1; ++y) {
+    //    b
+    //  d e f
+    //    h
+    const uint32_t *rb = input.row(std::max(y - 1, 0));
+    const uint32_t *re = input.row(y);
+    const uint32_t *rh = input.row(std::min(y + 1, maxY));
+    uint32_t *dst = output.row(y);
+
+    for (int x = x0; x < x1; x += S::kWidth) {
+      Px pb, pd, pe, pf, ph;
+      if (x >= 1 && x + S::kWidth <= maxX) {
+        pb = P::load(rb, x);
+        pd = P::load(re, x - 1);
+        pe = P::load(re, x);
+        pf = P::load(re, x + 1);
+        ph = P::load(rh, x);
+      } else {
+        I col = S::toInt(S::iota() + S::splat(static_cast<float>(x)));
+        I c = S::clamp(col, 0, maxX);
+        pb = P::gather(rb, c);
+        pd = P::gather(re, S::clamp(col + (-1), 0, maxX));
+        pe = P::gather(re, c);
+        pf = P::gather(re, S::clamp(col + 1, 0, maxX));
+        ph = P::gather(rh, c);
+      }
+      RcasPixel<S> b = rcasUnpack<S, P>(pb), d = rcasUnpack<S, P>(pd);
+      RcasPixel<S> e = rcasUnpack<S, P>(pe), f = rcasUnpack<S, P>(pf);
+      RcasPixel<S> h = rcasUnpack<S, P>(ph);
+
+      F lobe = S::max(rcasLobe<S, P>(b.r, d.r, e.r, f.r, h.r),
+                      S::max(rcasLobe<S, P>(b.g, d.g, e.g, f.g, h.g),
+                             rcasLobe<S, P>(b.b, d.b, e.b, f.b, h.b)));
+      lobe = S::max(limit, S::min(lobe, zero)) * sharpness;
+      F rcpL = S::div(one, S::splat(4.0f) * lobe + one);
+
+      F outR = (lobe * (b.r + d.r + f.r + h.r) + e.r) * rcpL;
+      F outG = (lobe * (b.g + d.g + f.g + h.g) + e.g) * rcpL;
+      F outB = (lobe * (b.b + d.b + f.b + h.b) + e.b) * rcpL;
+      if constexpr (P::kUnorm) {
+        outR = S::min(S::max(outR, zero), peak);
+        outG = S::min(S::max(outG, zero), peak);
+        outB = S::min(S::max(outB, zero), peak);
+      }
+
+      P::store(dst, x, P::pack(outR, outG, outB, pe),
+               std::min(S::kWidth, x1 - x));
+    }
+  }
+}
+
+// `input` and `output` share a pixel format; it picks the adapter.
+template <class S>
+void rcasRect(const FsrConstants &consts, const FrameView &input,
+              const FrameView &output, int x0, int y0, int x1, int y1) {
+  withPixels<S>(output.format, [&](auto pixels) {
+    rcasRectIn<S, decltype(pixels)>(consts, input, output, x0, y0, x1, y1);
+  });
+}
+
+} // namespace
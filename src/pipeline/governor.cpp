@@ -0,0 +1,146 @@
+// governor.cpp
+// Frame-time budget governor for the present path.
+
+#include "governor.h"
+#include "../utils/log.h"
+#include <algorithm>
+
+namespace {
+
+struct Level {
+  UpscaleMode mode;
+  float inputScale;
+};
+
+// Level 0 is the neural mode the ceiling allows; its entry here is replaced
+// by that mode at runtime. There are no reduced input scales yet: nothing
+// makes the game render smaller, and a smaller EASU viewport over the
+// full-size image would only zoom into its top-left corner.
+constexpr Level kLadder[] = {
+    {UpscaleMode::HYBRID, 1.0f},
+    {UpscaleMode::FSR_ONLY, 1.0f},
+};
+constexpr int kLevels = sizeof(kLadder) / sizeof(kLadder[0]);
+
+constexpr double kEwmaAlpha = 0.1;
+// Over budget means missing the target by more than this fraction.
+constexpr double kOverSlack = 1.05;
+constexpr double kOnTarget = 1.02;
+// Demote only when our cost is at least this share of the overrun; a
+// game-bound title gets nothing back from a cheaper level.
+constexpr double kMaterialShare = 0.5;
+// Headroom the predicted frame time must leave for a quick promotion.
+constexpr double kHeadroom = 0.85;
+constexpr int kDemoteFrames = 10;
+// Frames after a switch during which the smoothed values still describe
+// the old level and no decision is taken.
+constexpr int kSettleFrames = 15;
+constexpr int kPromoteFrames = 120;
+constexpr int kMaxPromoteFrames = kPromoteFrames * 32;
+
+} // namespace
+
+FrameGovernor::FrameGovernor(UpscaleMode ceiling, double targetFrameMs)
+    : target_(targetFrameMs), promoteAfter_(kPromoteFrames) {
+  static_assert(kLevels <= int(sizeof(cost_) / sizeof(cost_[0])),
+                "cost_ covers every level");
+  setCeiling(ceiling);
+}
+
+void FrameGovernor::setTarget(double targetFrameMs) {
+  target_ = targetFrameMs;
+  overBudget_ = underBudget_ = 0;
+}
+
+void FrameGovernor::setCeiling(UpscaleMode ceiling) {
+  if (ceiling != ceiling_)
+    cost_[0] = 0.0; // different neural mode, old cost does not apply
+  ceiling_ = ceiling;
+  top_ = ceiling == UpscaleMode::FSR_ONLY ? 1 : 0;
+  moveTo(std::max(level_, top_));
+}
+
+int FrameGovernor::levelCount() const { return kLevels; }
+
+GovernorDecision FrameGovernor::decision() const {
+  GovernorDecision d;
+  d.mode = level_ == 0 ? ceiling_ : kLadder[level_].mode;
+  d.inputScale = kLadder[level_].inputScale;
+  return d;
+}
+
+void FrameGovernor::moveTo(int level) {
+  level = std::min(std::max(level, top_), kLevels - 1);
+  if (level == level_ && framesAtLevel_ > 0)
+    return;
+  if (level != level_) {
+    const GovernorDecision from = decision();
+    const int old = level_;
+    level_ = level;
+    const GovernorDecision to = decision();
+    OMNIFORGE_LOG_INFO("governor: level {} -> {} (mode {} -> {}, scale {} -> "
+                       "{})",
+                       old, level_, from.mode, to.mode, from.inputScale,
+                       to.inputScale);
+  }
+  framesAtLevel_ = 0;
+  overBudget_ = underBudget_ = 0;
+}
+
+void FrameGovernor::onFrame(double frameMs, double pipelineMs) {
+  if (frameMs <= 0.0 || target_ <= 0.0)
+    return;
+
+  frameEwma_ = frameEwma_ == 0.0
+                   ? frameMs
+                   : frameEwma_ + kEwmaAlpha * (frameMs - frameEwma_);
+  double &cost = cost_[level_];
+  cost = cost == 0.0 ? pipelineMs : cost + kEwmaAlpha * (pipelineMs - cost);
+
+  if (++framesAtLevel_ < kSettleFrames)
+    return;
+
+  if (frameEwma_ > target_ * kOverSlack) {
+    underBudget_ = 0;
+    if (cost < kMaterialShare * (frameEwma_ - target_)) {
+      overBudget_ = 0;
+      return;
+    }
+    if (++overBudget_ >= kDemoteFrames && level_ < kLevels - 1) {
+      // A promotion that could not hold was premature; wait longer next
+      // time. A level that held for a good while resets the back-off.
+      if (promoted_ && framesAtLevel_ < promoteAfter_)
+        promoteAfter_ = std::min(promoteAfter_ * 2, kMaxPromoteFrames);
+      else
+        promoteAfter_ = kPromoteFrames;
+      frameEwma_ -= cost;
+      moveTo(level_ + 1);
+      promoted_ = false;
+      if (cost_[level_] > 0.0)
+        frameEwma_ += cost_[level_];
+      else
+        frameEwma_ = 0.0;
+    }
+    return;
+  }
+
+  overBudget_ = 0;
+  if (level_ == top_ || frameEwma_ > target_ * kOnTarget) {
+    underBudget_ = 0;
+    return;
+  }
+
+  // With vsync the interval sits at the target whatever our share is, so
+  // promotion is also a probe: taken after a long stable stretch, and
+  // much sooner when the cost measured on the better level clearly fits.
+  const double better = cost_[level_ - 1];
+  const bool fits =
+      better > 0.0 && frameEwma_ - cost + better < target_ * kHeadroom;
+  const int wait = fits ? std::max(kSettleFrames, promoteAfter_ / 4)
+                        : promoteAfter_ * 4;
+  if (++underBudget_ >= wait) {
+    frameEwma_ = better > 0.0 ? frameEwma_ - cost + better : 0.0;
+    moveTo(level_ - 1);
+    promoted_ = true;
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+// governor.h
+// Frame-time budget governor: picks the upscale mode from measured costs so
+// the pipeline never costs the game its frame rate.
+
+#include "hybrid_mode.h"
+
+// What the next frame should run.
+struct GovernorDecision {
+  UpscaleMode mode = UpscaleMode::HYBRID;
+  float inputScale = 1.0f; // fraction of the input extent fed to EASU;
+                           // 1 until the render resolution can be changed
+};
+
+// Quality ladder, best first: the neural mode, then FSR_ONLY. The governor
+// keeps smoothed frame times and a smoothed cost of our own work per level;
+// it steps down once frames have run over budget for a while and our cost
+// is a material share of the overrun (a game that is slow on its own gains
+// nothing from a cheaper level), and steps back up only when the predicted
+// frame time on the better level leaves clear headroom for much longer. A
+// promotion that gets undone straight away doubles the wait before the
+// next attempt.
+//
+// Not thread-safe; the layer keeps one per swapchain, fed from that
+// swapchain's (serialised) presents.
+class FrameGovernor {
+public:
+  // `ceiling` is the best mode the user asked for; the governor never goes
+  // above it. `targetFrameMs` is the frame time to hold (e.g. 16.7 for 60).
+  explicit FrameGovernor(UpscaleMode ceiling = UpscaleMode::HYBRID,
+                         double targetFrameMs = 1000.0 / 60.0);
+
+  void setTarget(double targetFrameMs);
+  void setCeiling(UpscaleMode ceiling);
+
+  // One call per presented frame: `frameMs` is the present-to-present
+  // interval, `pipelineMs` the time our upscaling took inside it.
+  void onFrame(double frameMs, double pipelineMs);
+
+  GovernorDecision decision() const;
+  int level() const { return level_; }
+  int levelCount() const;
+
+private:
+  void moveTo(int level);
+
+  UpscaleMode ceiling_ = UpscaleMode::HYBRID;
+  int top_ = 0; // best level the ceiling allows
+  int level_ = 0;
+  double target_ = 0.0;
+  double frameEwma_ = 0.0;
+  double cost_[8] = {}; // smoothed pipeline ms per level, 0 = unmeasured
+  int overBudget_ = 0;
+  int underBudget_ = 0;
+  int framesAtLevel_ = 0;
+  int promoteAfter_ = 0;
+  bool promoted_ = false; // last move was upwards
+};
@@ -0,0 +1,141 @@
+// hybrid_compositor.cpp
+// Tile detail classification and neural/EASU feathering.
+
+#include "hybrid_compositor.h"
+#include "../utils/thread_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Gradient (|dx| + |dy| of luma) thresholds.
+constexpr int kEdgeGradient = 12;
+constexpr int kStrongGradient = 80;
+constexpr int kFlatGradient = 2;
+
+inline int luma(const uint8_t *p) {
+  return (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+}
+
+} // namespace
+
+TileDetail measureDetail(const FrameView &input, int x0, int y0, int x1,
+                         int y1) {
+  TileDetail d;
+  if (x1 <= x0 || y1 <= y0)
+    return d;
+  uint64_t sum = 0, sumSq = 0;
+  uint32_t edges = 0, strong = 0, flat = 0;
+  for (int y = y0; y < y1; ++y) {
+    const uint8_t *row = reinterpret_cast<const uint8_t *>(input.row(y));
+    const uint8_t *below =
+        y + 1 < y1 ? reinterpret_cast<const uint8_t *>(input.row(y + 1))
+                   : row;
+    int l = luma(row + 4 * x0);
+    for (int x = x0; x < x1; ++x) {
+      const int right = x + 1 < x1 ? luma(row + 4 * (x + 1)) : l;
+      const int g = std::abs(right - l) + std::abs(luma(below + 4 * x) - l);
+      sum += l;
+      sumSq += uint32_t(l * l);
+      edges += g >= kEdgeGradient;
+      strong += g >= kStrongGradient;
+      flat += g <= kFlatGradient;
+      l = right;
+    }
+  }
+  const double n = double(x1 - x0) * (y1 - y0);
+  const double mean = sum / n;
+  d.edgeDensity = static_cast<float>(edges / n);
+  d.variance = static_cast<float>(sumSq / n - mean * mean);
+  d.strongEdges = static_cast<float>(strong / n);
+  d.flat = static_cast<float>(flat / n);
+  return d;
+}
+
+bool wantsNeural(const TileDetail &d) {
+  const bool text = d.strongEdges >= 0.03f && d.flat >= 0.5f;
+  const bool textured = d.edgeDensity >= 0.15f ||
+                        (d.variance >= 600.0f && d.edgeDensity >= 0.05f);
+  return text || textured;
+}
+
+size_t HybridClassifier::classify(const FrameView &input, const TileGrid &grid,
+                                  ThreadPool &pool) {
+  const size_t tiles = static_cast<size_t>(grid.count());
+  const bool keep = valid_ && state_.size() == tiles;
+  previous_.swap(state_);
+  if (!keep)
+    previous_.assign(tiles, kUnknown); // every tile reads as changed
+  state_.resize(tiles);
+  valid_ = true;
+
+  pool.parallelFor(tiles, [&](size_t i) {
+    // Input footprint, mapped the same way DirtyTiles does.
+    const Tile t = grid.tile(static_cast<int>(i));
+    const int x0 = static_cast<int>(int64_t(t.x0) * input.width / grid.width);
+    const int y0 = static_cast<int>(int64_t(t.y0) * input.height / grid.height);
+    const int x1 = static_cast<int>(
+        (int64_t(t.x1) * input.width + grid.width - 1) / grid.width);
+    const int y1 = static_cast<int>(
+        (int64_t(t.y1) * input.height + grid.height - 1) / grid.height);
+    state_[i] = wantsNeural(measureDetail(input, x0, y0, x1, y1)) ? kNeural : 0;
+  });
+
+  // Feather only where a neural tile meets an EASU one; frame borders and
+  // neural neighbours keep the full neural result.
+  size_t count = 0;
+  for (int r = 0; r < grid.rows; ++r) {
+    for (int c = 0; c < grid.cols; ++c) {
+      const int i = r * grid.cols + c;
+      if (!(state_[size_t(i)] & kNeural))
+        continue;
+      ++count;
+      auto easu = [&](int n) { return !(state_[size_t(n)] & kNeural); };
+      uint8_t edges = 0;
+      if (c > 0 && easu(i - 1))
+        edges |= Left;
+      if (r > 0 && easu(i - grid.cols))
+        edges |= Top;
+      if (c + 1 < grid.cols && easu(i + 1))
+        edges |= Right;
+      if (r + 1 < grid.rows && easu(i + grid.cols))
+        edges |= Bottom;
+      state_[size_t(i)] |= uint8_t(edges << 1);
+    }
+  }
+  return count;
+}
+
+void featherTile(const FrameView &neural, const FrameView &output,
+                 const Tile &t, int dx, int dy, uint8_t edges) {
+  // Weight (0..256) of the neural pixel at distance `d` from a feathered
+  // side, sampled at pixel centres.
+  auto ramp = [](int d) {
+    return d >= kHybridFeather ? 256 : (2 * d + 1) * 128 / kHybridFeather;
+  };
+  for (int y = t.y0; y < t.y1; ++y) {
+    int wy = 256;
+    if (edges & HybridClassifier::Top)
+      wy = std::min(wy, ramp(y - t.y0));
+    if (edges & HybridClassifier::Bottom)
+      wy = std::min(wy, ramp(t.y1 - 1 - y));
+    const uint8_t *src =
+        reinterpret_cast<const uint8_t *>(neural.row(y - dy) + (t.x0 - dx));
+    uint8_t *dst = reinterpret_cast<uint8_t *>(output.row(y) + t.x0);
+    for (int x = t.x0; x < t.x1; ++x, src += 4, dst += 4) {
+      int w = wy;
+      if (edges & HybridClassifier::Left)
+        w = std::min(w, ramp(x - t.x0));
+      if (edges & HybridClassifier::Right)
+        w = std::min(w, ramp(t.x1 - 1 - x));
+      if (w == 256) {
+        std::memcpy(dst, src, 4);
+        continue;
+      }
+      for (int ch = 0; ch < 4; ++ch)
+        dst[ch] = static_cast<uint8_t>(
+            (src[ch] * w + dst[ch] * (256 - w) + 128) >> 8);
+    }
+  }
+}
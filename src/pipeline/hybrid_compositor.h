@@ -0,0 +1,74 @@
+#pragma once
+// hybrid_compositor.h
+// Content-adaptive HYBRID mode: a per-tile detail classifier that decides
+// which output tiles get the neural engine, and the feathered blend where
+// a neural tile meets an EASU one.
+
+#include "frame.h"
+#include "tiling.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Cheap statistics of a tile's input footprint, on luma.
+struct TileDetail {
+  float edgeDensity = 0.0f; // share of pixels with a visible gradient
+  float variance = 0.0f;    // luma variance, in 8-bit units squared
+  float strongEdges = 0.0f; // share of pixels on a hard edge
+  float flat = 0.0f;        // share of pixels with no gradient at all
+};
+
+TileDetail measureDetail(const FrameView &input, int x0, int y0, int x1,
+                         int y1);
+
+// True for textured or edge-rich tiles and for text: hard edges on an
+// otherwise flat background, where EASU rings and cunet does not. Sky,
+// gradients and blur stay on EASU.
+bool wantsNeural(const TileDetail &detail);
+
+// Per-tile neural/EASU decision for one frame, plus which sides of each
+// neural tile face an EASU tile and are feathered. Storage is only
+// reallocated when the tile count changes.
+class HybridClassifier {
+public:
+  enum Edge : uint8_t { Left = 1, Top = 2, Right = 4, Bottom = 8 };
+
+  // Classifies every tile of `grid` (which tiles the output; `input` maps
+  // linearly onto it). Returns the number of neural tiles.
+  size_t classify(const FrameView &input, const TileGrid &grid,
+                  ThreadPool &pool);
+
+  bool neural(int tile) const { return (state(tile) & kNeural) != 0; }
+  uint8_t featherEdges(int tile) const { return state(tile) >> 1; }
+
+  // Whether the tile's class or feathering differs from the previous
+  // classify(), so a reused output tile would be stale.
+  bool changed(int tile) const {
+    return state(tile) != previous_[static_cast<size_t>(tile)];
+  }
+
+  // Forgets the previous classification; every tile reads as changed.
+  void invalidate() { valid_ = false; }
+
+private:
+  static constexpr uint8_t kNeural = 1;
+  static constexpr uint8_t kUnknown = 0xff; // no real state has bit 7
+
+  uint8_t state(int tile) const { return state_[static_cast<size_t>(tile)]; }
+
+  std::vector<uint8_t> state_; // kNeural | featherEdges << 1
+  std::vector<uint8_t> previous_;
+  bool valid_ = false;
+};
+
+// Output pixels over which a neural tile fades into its EASU neighbour.
+constexpr int kHybridFeather = 8;
+
+// Blends the neural result over the EASU result already in `output` inside
+// tile `t`: full weight in the interior, fading out towards the `edges`
+// (HybridClassifier::Edge bits) over kHybridFeather pixels. Output pixel
+// (x, y) reads `neural` at (x - dx, y - dy).
+void featherTile(const FrameView &neural, const FrameView &output,
+                 const Tile &t, int dx, int dy, uint8_t edges);
@@ -1,12 +1,8 @@
 #pragma once
 
+// FSR_ONLY: EASU + RCAS over the whole frame.
+// NEURAL_ONLY: the cunet model over the whole frame.
+// HYBRID: per tile. Tiles with edges, texture or text go through the
+// network, the rest (sky, gradients, blur) through EASU + RCAS, and neural
+// tiles fade into their EASU neighbours (see hybrid_compositor.h).
 enum class UpscaleMode { FSR_ONLY = 0, NEURAL_ONLY = 1, HYBRID = 2 };
-
-/*
-Example usage:
-// enum UpscaleMode { FSR_ONLY, NEURAL_ONLY, HYBRID };
-// void processFrame(void* input, UpscaleMode mode) {
-//     if (mode == UpscaleMode::HYBRID) { fsrUpscale(input,...); ncnnInfer(...);
-}
-// }
-*/
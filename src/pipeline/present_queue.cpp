@@ -0,0 +1,101 @@
+// present_queue.cpp
+// Dedicated upscale thread behind the present hooks.
+
+#include "present_queue.h"
+#include "upscaler.h"
+#include "../utils/trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+PresentQueue::PresentQueue(size_t framesInFlight)
+    : framesInFlight_(std::max<size_t>(1, framesInFlight)),
+      jobs_(framesInFlight_ + 1) {
+  worker_ = std::thread([this] { workerLoop(); });
+}
+
+PresentQueue::~PresentQueue() {
+  jobs_.push(Entry());
+  worker_.join();
+}
+
+uint64_t PresentQueue::submit(const PresentJob &job) {
+  std::lock_guard<std::mutex> lock(submitMutex_);
+  const uint64_t ticket = submitted_.load(std::memory_order_relaxed) + 1;
+  // Back-pressure: the frame framesInFlight ago has to be done first, so
+  // at most that many are outstanding and the ring never fills.
+  if (ticket > framesInFlight_) {
+    OMNIFORGE_TRACE_SCOPE("queue full");
+    wait(ticket - framesInFlight_);
+  }
+  submitted_.store(ticket, std::memory_order_release);
+  jobs_.push(Entry{job, ticket});
+  return ticket;
+}
+
+uint64_t PresentQueue::trySubmit(const PresentJob &job) {
+  std::lock_guard<std::mutex> lock(submitMutex_);
+  const uint64_t ticket = submitted_.load(std::memory_order_relaxed) + 1;
+  if (ticket > framesInFlight_ && !completed(ticket - framesInFlight_))
+    return 0;
+  submitted_.store(ticket, std::memory_order_release);
+  jobs_.push(Entry{job, ticket});
+  return ticket;
+}
+
+void PresentQueue::waitForRoom() {
+  const uint64_t next = submitted_.load(std::memory_order_acquire) + 1;
+  if (next > framesInFlight_) {
+    OMNIFORGE_TRACE_SCOPE("queue full");
+    wait(next - framesInFlight_);
+  }
+}
+
+void PresentQueue::wait(uint64_t ticket) {
+  if (completed(ticket))
+    return;
+  OMNIFORGE_TRACE_SCOPE("queue wait");
+  // Same handshake as LatencyQueue::park(): announce, then re-check, so
+  // the worker either sees the waiter or the waiter sees the completion.
+  std::unique_lock<std::mutex> lock(doneMutex_);
+  waiters_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  doneCv_.wait(lock, [&] { return completed(ticket); });
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void PresentQueue::workerLoop() {
+  using Clock = std::chrono::steady_clock;
+  Tracer::setThreadName("upscale");
+  for (;;) {
+    Entry e = jobs_.pop();
+    if (e.ticket == 0)
+      return;
+    const Clock::time_point start = Clock::now();
+    if (e.job.ctx)
+      processFrame(*e.job.ctx, e.job.image, e.job.width, e.job.height,
+                   e.job.outWidth, e.job.outHeight, e.job.mode,
+                   e.job.inputScale, e.job.format);
+    lastFrameNs_.store(static_cast<uint64_t>(
+                           std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               Clock::now() - start)
+                               .count()),
+                       std::memory_order_relaxed);
+
+    completed_.store(e.ticket, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) > 0) {
+      { std::lock_guard<std::mutex> lock(doneMutex_); }
+      doneCv_.notify_all();
+    }
+  }
+}
+
+PresentQueue &PresentQueue::shared() {
+  static PresentQueue queue([] {
+    const char *env = std::getenv("OMNIFORGE_FRAMES_IN_FLIGHT");
+    const int n = env ? std::atoi(env) : 0;
+    return static_cast<size_t>(n > 0 ? n : 2);
+  }());
+  return queue;
+}
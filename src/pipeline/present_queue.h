@@ -0,0 +1,93 @@
+#pragma once
+// present_queue.h
+// Hands presented frames to a dedicated upscale thread so the game's
+// present call only pays for an enqueue.
+
+#include "../utils/latency_queue.h"
+#include "frame.h"
+#include "hybrid_mode.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+class UpscaleContext;
+
+// One frame for the GPU path of processFrame().
+struct PresentJob {
+  UpscaleContext *ctx = nullptr; // owned by the caller
+  void *image = nullptr;         // VkImage
+  int width = 0;
+  int height = 0;
+  int outWidth = 0;
+  int outHeight = 0;
+  PixelFormat format = PixelFormat::RGBA8;
+  UpscaleMode mode = UpscaleMode::HYBRID;
+  float inputScale = 1.0f;
+};
+
+// Up to `framesInFlight` frames are queued or being upscaled at once; the
+// worker takes them in submission order, so jobs sharing a context never
+// overlap. Each job gets a ticket that reads as completed once its
+// processFrame() has returned, which is what a caller waits for before
+// handing the same image out again. The tiles of each frame still fan out
+// over ThreadPool::shared().
+class PresentQueue {
+public:
+  explicit PresentQueue(size_t framesInFlight = 2);
+  ~PresentQueue(); // finishes the queued frames
+
+  PresentQueue(const PresentQueue &) = delete;
+  PresentQueue &operator=(const PresentQueue &) = delete;
+
+  // Queues `job` and returns its ticket. Only waits when framesInFlight
+  // frames are already outstanding. Safe to call from several threads.
+  uint64_t submit(const PresentJob &job);
+
+  // Like submit(), but returns 0 instead of waiting for room. For callers
+  // that must not block where they submit: waitForRoom() first, outside,
+  // and retry if another thread took the room in between.
+  uint64_t trySubmit(const PresentJob &job);
+  // Blocks until fewer than framesInFlight frames are outstanding.
+  void waitForRoom();
+
+  bool completed(uint64_t ticket) const {
+    return completed_.load(std::memory_order_acquire) >= ticket;
+  }
+  // Blocks until `ticket` (0 = none) has completed.
+  void wait(uint64_t ticket);
+  // Blocks until everything submitted so far has completed.
+  void drain() { wait(submitted_.load(std::memory_order_acquire)); }
+
+  size_t framesInFlight() const { return framesInFlight_; }
+
+  // Wall time of the most recently completed frame, for the governor.
+  double lastFrameMs() const {
+    return lastFrameNs_.load(std::memory_order_relaxed) * 1e-6;
+  }
+
+  // Process-wide queue the present hooks use, sized by
+  // OMNIFORGE_FRAMES_IN_FLIGHT (default 2). Created on first use.
+  static PresentQueue &shared();
+
+private:
+  struct Entry {
+    PresentJob job;
+    uint64_t ticket = 0; // 0 stops the worker
+  };
+
+  void workerLoop();
+
+  size_t framesInFlight_;
+  std::mutex submitMutex_; // keeps tickets in queue order
+  std::atomic<uint64_t> submitted_{0};
+  std::atomic<uint64_t> completed_{0};
+  std::atomic<uint64_t> lastFrameNs_{0};
+  std::atomic<int> waiters_{0};
+  std::mutex doneMutex_;
+  std::condition_variable doneCv_;
+  LatencyQueue<Entry> jobs_;
+  std::thread worker_;
+};
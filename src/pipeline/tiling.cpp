@@ -0,0 +1,58 @@
+// tiling.cpp
+// Cache-size driven tile selection for the CPU pipeline.
+
+#include "tiling.h"
+#include "../utils/cpu_features.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Tile widths stay a multiple of one cache line of RGBA8 pixels.
+constexpr int kWidthAlign = 16;
+constexpr int kMinTileEdge = 32;
+constexpr unsigned kTilesPerWorker = 4;
+} // namespace
+
+TileGrid makeTileGrid(int outWidth, int outHeight, int inWidth, int inHeight,
+                      int halo, unsigned workers) {
+  TileGrid grid;
+  grid.width = outWidth;
+  grid.height = outHeight;
+  if (outWidth <= 0 || outHeight <= 0)
+    return grid;
+
+  // Bytes touched per output pixel: the RGBA8 output itself plus its share
+  // of the RGBA8 input footprint.
+  const double inPerOut = (inWidth > 0 && inHeight > 0)
+                              ? double(inWidth) * inHeight /
+                                    (double(outWidth) * outHeight)
+                              : 1.0;
+  const double bytesPerPixel = 4.0 * (1.0 + inPerOut);
+  const double budget = double(cpuFeatures().l2Bytes) / 2.0;
+
+  // Square tiles, minus the halo ring they also have to hold.
+  int edge = static_cast<int>(std::sqrt(budget / bytesPerPixel)) - 2 * halo;
+  edge = std::max(kMinTileEdge, edge / kWidthAlign * kWidthAlign);
+
+  int tw = std::min(edge, outWidth);
+  int th = std::min(edge, outHeight);
+
+  // Keep enough tiles around for stealing to balance the load.
+  const unsigned wanted = std::max(1u, workers) * kTilesPerWorker;
+  while (static_cast<unsigned>(((outWidth + tw - 1) / tw) *
+                               ((outHeight + th - 1) / th)) < wanted) {
+    if (th > kMinTileEdge && th >= tw)
+      th = std::max(kMinTileEdge, th / 2);
+    else if (tw > kMinTileEdge)
+      tw = std::max(kMinTileEdge, (tw / 2 + kWidthAlign - 1) / kWidthAlign *
+                                      kWidthAlign);
+    else
+      break;
+  }
+
+  grid.tileWidth = tw;
+  grid.tileHeight = th;
+  grid.cols = (outWidth + tw - 1) / tw;
+  grid.rows = (outHeight + th - 1) / th;
+  return grid;
+}
@@ -0,0 +1,35 @@
+#pragma once
+// tiling.h
+// Splits an output frame into cache-sized tiles for the CPU pipeline.
+
+struct Tile {
+  int x0, y0, x1, y1;
+};
+
+// Regular grid over a width x height extent; the last row/column of tiles
+// may be smaller. Computing a tile does not allocate.
+struct TileGrid {
+  int width = 0;
+  int height = 0;
+  int tileWidth = 0;
+  int tileHeight = 0;
+  int cols = 0;
+  int rows = 0;
+
+  int count() const { return cols * rows; }
+
+  Tile tile(int index) const {
+    const int tx = (index % cols) * tileWidth;
+    const int ty = (index / cols) * tileHeight;
+    return {tx, ty, tx + tileWidth < width ? tx + tileWidth : width,
+            ty + tileHeight < height ? ty + tileHeight : height};
+  }
+};
+
+// Grid for producing an outWidth x outHeight frame from an inWidth x
+// inHeight source. Tile edges are chosen so that one tile's output, its
+// `halo`-pixel border and the input footprint it reads fit in half of the
+// detected L2, leaving the rest for the kernels' own traffic. Tiles shrink
+// further if that would leave fewer than a few tiles per worker.
+TileGrid makeTileGrid(int outWidth, int outHeight, int inWidth, int inHeight,
+                      int halo, unsigned workers);
@@ -0,0 +1,144 @@
+// upscale_context.cpp
+// Cached per-swapchain upscaling state.
+
+#include "upscale_context.h"
+#include "../utils/thread_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+constexpr size_t kAlign = 64;
+
+bool dirtyTrackingDefault() {
+  const char *env = std::getenv("OMNIFORGE_DIRTY_TILES");
+  return !(env && std::strcmp(env, "0") == 0);
+}
+} // namespace
+
+UpscaleContext::UpscaleContext(ThreadPool *pool, FramePool *buffers)
+    : pool_(pool ? pool : &ThreadPool::shared()),
+      buffers_(buffers ? buffers : &FramePool::shared()),
+      dirtyTracking_(dirtyTrackingDefault()) {}
+
+UpscaleContext::UpscaleContext(UpscaleContext &&other) noexcept
+    : pool_(other.pool_), buffers_(other.buffers_),
+      dirtyTracking_(other.dirtyTracking_) {
+  *this = std::move(other);
+}
+
+UpscaleContext &UpscaleContext::operator=(UpscaleContext &&other) noexcept {
+  if (this != &other) {
+    pool_ = other.pool_;
+    buffers_ = other.buffers_;
+    inputWidth_ = other.inputWidth_;
+    inputHeight_ = other.inputHeight_;
+    outputWidth_ = other.outputWidth_;
+    outputHeight_ = other.outputHeight_;
+    mode_ = other.mode_;
+    inputScale_ = other.inputScale_;
+    format_ = other.format_;
+    consts_ = other.consts_;
+    grid_ = other.grid_;
+    scratch_ = std::move(other.scratch_);
+    scratchSlotBytes_ = std::exchange(other.scratchSlotBytes_, 0);
+    scratchSlots_ = std::exchange(other.scratchSlots_, 0);
+    dirtyTracking_ = other.dirtyTracking_;
+    dirty_ = std::move(other.dirty_);
+    history_ = std::move(other.history_);
+    hybrid_ = std::move(other.hybrid_);
+    other.dirty_.invalidate();
+    other.hybrid_.invalidate();
+    other.inputWidth_ = 0; // forces a rebuild if `other` is reused
+  }
+  return *this;
+}
+
+bool UpscaleContext::prepare(int inputWidth, int inputHeight, int outputWidth,
+                             int outputHeight, UpscaleMode mode,
+                             float inputScale, PixelFormat format) {
+  inputScale = std::min(std::max(inputScale, 0.25f), 1.0f);
+  if (inputWidth == inputWidth_ && inputHeight == inputHeight_ &&
+      outputWidth == outputWidth_ && outputHeight == outputHeight_ &&
+      mode == mode_ && inputScale == inputScale_ && format == format_)
+    return false;
+
+  inputWidth_ = inputWidth;
+  inputHeight_ = inputHeight;
+  outputWidth_ = outputWidth;
+  outputHeight_ = outputHeight;
+  mode_ = mode;
+  inputScale_ = inputScale;
+  format_ = format;
+  // The previous output no longer matches what this setup would produce.
+  history_.reset();
+  dirty_.invalidate();
+  hybrid_.invalidate();
+
+  // With inputScale < 1 only the top-left part of the input carries the
+  // frame; EASU stretches that viewport over the output.
+  const int viewWidth =
+      std::max(1, static_cast<int>(inputWidth * inputScale + 0.5f));
+  const int viewHeight =
+      std::max(1, static_cast<int>(inputHeight * inputScale + 0.5f));
+  setupFSR(consts_, viewWidth, viewHeight, inputWidth, inputHeight,
+           outputWidth, outputHeight);
+
+  // Neural-only frames still use the grid for dirty tracking.
+  grid_ = makeTileGrid(outputWidth, outputHeight, viewWidth, viewHeight, 1,
+                       pool_->concurrency());
+  size_t slotBytes = 0;
+  if (mode != UpscaleMode::NEURAL_ONLY) {
+    slotBytes =
+        fsrFusedScratchBytes(grid_.tileWidth, grid_.tileHeight, format);
+    slotBytes = (slotBytes + kAlign - 1) / kAlign * kAlign;
+  }
+
+  // Only grow: a smaller grid after a resize reuses the old block.
+  const size_t slots = pool_->slots();
+  if (slotBytes > scratchSlotBytes_ || slots > scratchSlots_) {
+    scratch_.reset();
+    scratchSlotBytes_ = scratchSlots_ = 0;
+    if (slotBytes > 0) {
+      scratch_ = buffers_->acquireBytes(slotBytes * slots);
+      if (!scratch_) {
+        inputWidth_ = 0; // out of memory; try again next frame
+        return true;
+      }
+      scratchSlotBytes_ = slotBytes;
+      scratchSlots_ = slots;
+    }
+  }
+  return true;
+}
+
+uint8_t *UpscaleContext::tileScratch() const {
+  if (!scratch_)
+    return nullptr;
+  return scratch_.data() +
+         static_cast<size_t>(pool_->slot()) * scratchSlotBytes_;
+}
+
+void UpscaleContext::setDirtyTracking(bool enabled) {
+  dirtyTracking_ = enabled;
+  if (!enabled) {
+    history_.reset();
+    dirty_.invalidate();
+  }
+}
+
+FrameView UpscaleContext::history() {
+  if (!dirtyTracking_ || outputWidth_ <= 0)
+    return FrameView();
+  if (!history_) {
+    history_ = buffers_->acquire({outputWidth_, outputHeight_,
+                                  pixelBytes(format_),
+                                  static_cast<uint32_t>(format_)});
+    dirty_.invalidate(); // nothing in it yet
+    if (!history_)
+      return FrameView();
+  }
+  return FrameView{history_.data(), outputWidth_, outputHeight_,
+                   history_.stride(), format_};
+}
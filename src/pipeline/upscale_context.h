@@ -0,0 +1,83 @@
+#pragma once
+// upscale_context.h
+// Per-swapchain upscaling state: constants, tile layout and scratch buffers
+// that only change when the extent or mode does.
+
+#include "../utils/frame_pool.h"
+#include "dirty_tiles.h"
+#include "frame.h"
+#include "fsr_cpu.h"
+#include "hybrid_compositor.h"
+#include "hybrid_mode.h"
+#include "tiling.h"
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// Owns everything the frame path would otherwise rebuild per call. prepare()
+// is cheap when nothing changed, so the steady-state frame does no heap
+// allocation; a new extent, mode, input scale or pixel format rebuilds the
+// lot once.
+// A context drives one frame at a time.
+class UpscaleContext {
+public:
+  // Null pools mean the process-wide ones.
+  explicit UpscaleContext(ThreadPool *pool = nullptr,
+                          FramePool *buffers = nullptr);
+
+  UpscaleContext(UpscaleContext &&other) noexcept;
+  UpscaleContext &operator=(UpscaleContext &&other) noexcept;
+  UpscaleContext(const UpscaleContext &) = delete;
+  UpscaleContext &operator=(const UpscaleContext &) = delete;
+
+  // Returns true if the cached state was rebuilt.
+  bool prepare(int inputWidth, int inputHeight, int outputWidth,
+               int outputHeight, UpscaleMode mode, float inputScale = 1.0f,
+               PixelFormat format = PixelFormat::RGBA8);
+
+  ThreadPool &pool() const { return *pool_; }
+  const FsrConstants &fsrConstants() const { return consts_; }
+  const TileGrid &tileGrid() const { return grid_; }
+
+  // Fused EASU+RCAS scratch for the calling thread's pool slot (see
+  // ThreadPool::slot()), 64-byte aligned and big enough for any grid tile.
+  // Null if the last prepare() could not get memory.
+  uint8_t *tileScratch() const;
+
+  // Reuse of unchanged tiles from the previous frame (see DirtyTiles). On
+  // unless OMNIFORGE_DIRTY_TILES=0; benchmarks, which feed the same frame
+  // over and over, turn it off.
+  void setDirtyTracking(bool enabled);
+  bool dirtyTracking() const { return dirtyTracking_; }
+  DirtyTiles &dirtyTiles() { return dirty_; }
+
+  // The previous frame's output at the prepared extent, which skipped tiles
+  // are copied from. Invalid if tracking is off or there is no memory.
+  FrameView history();
+
+  // HYBRID's per-tile neural/EASU split for the current frame.
+  HybridClassifier &hybridClassifier() { return hybrid_; }
+
+private:
+  ThreadPool *pool_;
+  FramePool *buffers_;
+  int inputWidth_ = 0;
+  int inputHeight_ = 0;
+  int outputWidth_ = 0;
+  int outputHeight_ = 0;
+  UpscaleMode mode_ = UpscaleMode::HYBRID;
+  float inputScale_ = 0.0f;
+  PixelFormat format_ = PixelFormat::RGBA8;
+  FsrConstants consts_ = {};
+  TileGrid grid_;
+
+  FramePool::Handle scratch_; // one per ThreadPool::slot()
+  size_t scratchSlotBytes_ = 0;
+  size_t scratchSlots_ = 0;
+
+  bool dirtyTracking_;
+  DirtyTiles dirty_;
+  FramePool::Handle history_;
+  HybridClassifier hybrid_;
+};
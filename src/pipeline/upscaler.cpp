@@ -1,11 +1,20 @@
 // upscaler.cpp
 // Stubs for FSR compute dispatch and neural chain (ncnn-vulkan) integration.
 
-#include "hybrid_mode.h"
+#include "upscaler.h"
+#include "../engines/neural_engine.h"
+#include "../utils/log.h"
+#include "../utils/metrics.h"
+#include "../utils/thread_pool.h"
+#include "../utils/trace.h"
+#include "fsr_cpu.h"
+#include "hybrid_compositor.h"
+#include "upscale_context.h"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
-#include <iostream>
-#include <vector>
+#include <cstring>
 
 
 #ifdef OMNIFORGE_HAVE_VULKAN
@@ -17,24 +26,17 @@
 #include "../../external/FidelityFX-FSR/ffx-fsr/ffx_a.h"
 #include "../../external/FidelityFX-FSR/ffx-fsr/ffx_fsr1.h"
 
-// Forward declarations
-bool runNcnnInference(void *input, void *output, int width, int height);
-
-struct FsrConstants {
-  uint32_t easu[4][4];
-  uint32_t rcas[4][4];
-};
-
-void setupFSR(FsrConstants &consts, int inputWidth, int inputHeight,
-              int outputWidth, int outputHeight) {
+void setupFSR(FsrConstants &consts, int viewportWidth, int viewportHeight,
+              int inputWidth, int inputHeight, int outputWidth,
+              int outputHeight) {
   // EASU setup
   // FsrEasuCon expects AU1* (uint32_t*)
   FsrEasuCon(reinterpret_cast<AU1 *>(consts.easu[0]),
              reinterpret_cast<AU1 *>(consts.easu[1]),
              reinterpret_cast<AU1 *>(consts.easu[2]),
              reinterpret_cast<AU1 *>(consts.easu[3]),
-             static_cast<AF1>(inputWidth),
-             static_cast<AF1>(inputHeight), // Viewport size
+             static_cast<AF1>(viewportWidth),
+             static_cast<AF1>(viewportHeight), // Viewport size
              static_cast<AF1>(inputWidth),
              static_cast<AF1>(inputHeight), // Input image size
              static_cast<AF1>(outputWidth),
@@ -44,33 +46,265 @@ void setupFSR(FsrConstants &consts, int inputWidth, int inputHeight,
   // RCAS setup (sharpness 0.2 default)
   const float sharpness = 0.2f;
   FsrRcasCon(reinterpret_cast<AU1 *>(consts.rcas[0]), sharpness);
+  consts.ratio = fsrRatio(viewportWidth, viewportHeight, inputWidth,
+                          inputHeight, outputWidth, outputHeight);
 }
 
-void processFrame(void *inputImage, int width, int height, UpscaleMode mode) {
-  // std::cerr << "upscaler: processFrame called (" << width << "x" << height <<
-  // ")" << std::endl;
+void processFrame(UpscaleContext &ctx, void *inputImage, int width,
+                  int height, int outWidth, int outHeight, UpscaleMode mode,
+                  float inputScale, PixelFormat format) {
+  OMNIFORGE_TRACE_SCOPE("upscale");
 
-  // Calculate output dimensions (assuming 2x upscale for this example)
-  int outWidth = width * 2;
-  int outHeight = height * 2;
+  // The network is 2x and RGBA8 only (its input is RGB-ordered, and BGRA8
+  // is not swizzled for it); anything else is FSR's alone.
+  if (outWidth != width * 2 || outHeight != height * 2 ||
+      format != PixelFormat::RGBA8)
+    mode = UpscaleMode::FSR_ONLY;
+
+  // The model loads in the background (initNcnnVulkan); until it is ready
+  // FSR carries the frames instead of stalling the present.
+  if (mode != UpscaleMode::FSR_ONLY && !neuralReady(NeuralBackend::Vulkan)) {
+    startNeuralLoad(NeuralBackend::Vulkan);
+    mode = UpscaleMode::FSR_ONLY;
+  }
+  ctx.prepare(width, height, outWidth, outHeight, mode, inputScale, format);
 
   // UpscaleMode::HYBRID = 2
   if (mode == UpscaleMode::FSR_ONLY || mode == static_cast<UpscaleMode>(2)) {
-    FsrConstants fsrConsts;
-    setupFSR(fsrConsts, width, height, outWidth, outHeight);
-
     // In a real implementation:
-    // 1. Update Uniform Buffer with fsrConsts
-    // 2. Bind FSR pipeline
+    // 1. Update Uniform Buffer with ctx.fsrConstants() (only after prepare()
+    //    reported a change)
+    // 2. Bind the FSR pipeline built for `format`, which reads and writes
+    //    the swapchain image directly
     // 3. Dispatch Compute Shader
     // vkCmdDispatch(cmdBuffer, (outWidth + 15)/16, (outHeight + 15)/16, 1);
-    // std::cout << "FSR Constants generated. Dispatching FSR..." << std::endl;
+    OMNIFORGE_LOG_DEBUG(
+        "FSR constants generated. Dispatching FSR {}x{} (format {})...",
+        outWidth, outHeight, format);
   }
 
   if (mode == UpscaleMode::NEURAL_ONLY || mode == static_cast<UpscaleMode>(2)) {
     // Call ncnn-vulkan inference path
-    // For hybrid, input might be the output of FSR (if doing RCAS -> Neural, or
-    // Neural -> RCAS) Here we assume parallel or sequential based on mode.
+    // For hybrid this should, like the CPU path, only cover the tiles
+    // HybridClassifier marks as detailed.
     runNcnnInference(inputImage, nullptr, width, height);
   }
 }
+
+void processFrame(void *inputImage, int width, int height, int outWidth,
+                  int outHeight, UpscaleMode mode, float inputScale,
+                  PixelFormat format) {
+  thread_local UpscaleContext ctx;
+  processFrame(ctx, inputImage, width, height, outWidth, outHeight, mode,
+               inputScale, format);
+}
+
+namespace {
+
+// Input pixels beyond an output tile's footprint that EASU (12-tap, +-2)
+// and RCAS (one output pixel) can read.
+constexpr int kFsrHalo = 3;
+
+// Copies the [x0, x1) x [y0, y1) rectangle of `src`, shifted by (dx, dy),
+// into `dst`.
+void copyRect(const FrameView &src, const FrameView &dst, int x0, int y0,
+              int x1, int y1, int dx = 0, int dy = 0) {
+  const size_t bytes = static_cast<size_t>(pixelBytes(src.format));
+  for (int y = y0; y < y1; ++y)
+    std::memcpy(dst.data + size_t(y) * dst.stride + x0 * bytes,
+                src.data + size_t(y - dy) * src.stride + (x0 - dx) * bytes,
+                static_cast<size_t>(x1 - x0) * bytes);
+}
+
+// Runs the network over each horizontal run of `selected` tiles only. Every
+// run gets `halo` pixels of real context, so its interior matches a
+// whole-frame pass up to tile blending. With a `hybrid` classifier, tiles
+// with EASU neighbours are feathered into the EASU result already there.
+template <typename Selected>
+bool neuralRuns(UpscaleContext &ctx, const FrameView &input,
+                const FrameView &output, int halo, Selected selected,
+                const HybridClassifier *hybrid) {
+  const TileGrid &grid = ctx.tileGrid();
+  // One band-sized buffer, the same shape every frame so the pool
+  // recycles it.
+  const int maxRows = 2 * ((grid.tileHeight + 1) / 2 + 1 + 2 * halo);
+  FramePool::Handle band =
+      FramePool::shared().acquire({output.width, maxRows, 4, 0});
+  if (!band)
+    return false;
+
+  for (int row = 0; row < grid.rows; ++row) {
+    for (int col = 0; col < grid.cols;) {
+      if (!selected(row * grid.cols + col)) {
+        ++col;
+        continue;
+      }
+      const int first = col;
+      while (col < grid.cols && selected(row * grid.cols + col))
+        ++col;
+      const Tile a = grid.tile(row * grid.cols + first);
+      const Tile b = grid.tile(row * grid.cols + col - 1);
+
+      const int sx0 = std::max(0, a.x0 / 2 - halo);
+      const int sy0 = std::max(0, a.y0 / 2 - halo);
+      const int sx1 = std::min(input.width, (b.x1 + 1) / 2 + halo);
+      const int sy1 = std::min(input.height, (b.y1 + 1) / 2 + halo);
+      const FrameView sub{input.data + size_t(sy0) * input.stride +
+                              size_t(sx0) * 4,
+                          sx1 - sx0, sy1 - sy0, input.stride};
+      const FrameView subOut{band.data(), 2 * sub.width, 2 * sub.height,
+                             band.stride()};
+      OMNIFORGE_TRACE_SCOPE("neural run");
+      if (!runNcnnInferenceCpu(sub, subOut, ctx.pool()))
+        return false;
+      for (int c = first; c < col; ++c) {
+        const int i = row * grid.cols + c;
+        const Tile t = grid.tile(i);
+        const uint8_t edges = hybrid ? hybrid->featherEdges(i) : 0;
+        if (edges)
+          featherTile(subOut, output, t, 2 * sx0, 2 * sy0, edges);
+        else
+          copyRect(subOut, output, t.x0, t.y0, t.x1, t.y1, 2 * sx0, 2 * sy0);
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool processFrame(UpscaleContext &ctx, const FrameView &input,
+                  const FrameView &output, UpscaleMode mode) {
+  if (!input.valid() || !output.valid() || input.format != output.format ||
+      output.width < input.width || output.height < input.height)
+    return false;
+  if (output.width != input.width * 2 || output.height != input.height * 2 ||
+      input.format != PixelFormat::RGBA8) {
+    // The network is 2x and RGBA8 only.
+    if (mode == UpscaleMode::NEURAL_ONLY)
+      return false;
+    mode = UpscaleMode::FSR_ONLY;
+  }
+
+  OMNIFORGE_TRACE_SCOPE("upscale");
+  ctx.prepare(input.width, input.height, output.width, output.height, mode,
+              1.0f, input.format);
+  // Hybrid degrades to EASU everywhere without a model (which, once it
+  // fails to load, it stays).
+  const bool neuralUp =
+      mode != UpscaleMode::FSR_ONLY && waitNeuralReady(NeuralBackend::Cpu);
+  if (!neuralUp && mode == UpscaleMode::NEURAL_ONLY)
+    return false;
+  const bool hybrid = neuralUp && mode == UpscaleMode::HYBRID;
+  const bool neuralOnly = mode == UpscaleMode::NEURAL_ONLY;
+
+  ThreadPool &pool = ctx.pool();
+  const TileGrid &grid = ctx.tileGrid();
+  const size_t tiles = grid.count();
+
+  // Hybrid sends only detailed tiles through the network; the rest, and
+  // the feathered rims of neural tiles next to them, get EASU.
+  HybridClassifier &classes = ctx.hybridClassifier();
+  size_t neuralTiles = 0;
+  if (hybrid) {
+    OMNIFORGE_TRACE_SCOPE("classify");
+    StageTimer timer(Metrics::shared(), Stage::Compose);
+    neuralTiles = classes.classify(input, grid, pool);
+  }
+
+  // Tiles whose input footprint is unchanged since the previous frame are
+  // copied from its output instead of being recomputed, unless hybrid
+  // reclassified them or their neighbours. A mostly-dirty frame is done
+  // whole: the neural runs would pay their halo for little.
+  const FrameView history = ctx.history();
+  DirtyTiles &dirty = ctx.dirtyTiles();
+  size_t dirtyTiles = tiles;
+  if (history.valid()) {
+    OMNIFORGE_TRACE_SCOPE("dirty tiles");
+    dirtyTiles = dirty.update(input, grid,
+                              neuralUp ? neuralHalo() : kFsrHalo, pool);
+  }
+  const bool partial = dirtyTiles * 4 < tiles * 3;
+  auto needed = [&](size_t i) {
+    const int t = static_cast<int>(i);
+    return !partial || dirty.dirty(t) || (hybrid && classes.changed(t));
+  };
+  auto neuralTile = [&](size_t i) {
+    return neuralOnly || (hybrid && classes.neural(static_cast<int>(i)));
+  };
+
+  // EASU and RCAS fused per output tile; each pool thread has its own
+  // scratch tile in the context, so the upscaled intermediate never goes
+  // out to memory.
+  auto runFsr = [&](auto &&selected) {
+    const FsrConstants &fsrConsts = ctx.fsrConstants();
+    std::atomic<uint64_t> easuNs{0}, rcasNs{0};
+    pool.parallelFor(tiles, [&](size_t i) {
+      if (!selected(i))
+        return;
+      OMNIFORGE_TRACE_SCOPE("easu+rcas tile");
+      const Tile t = grid.tile(static_cast<int>(i));
+      FsrTileTiming timing;
+      fsrEasuRcasTile(fsrConsts, input, output, t.x0, t.y0, t.x1, t.y1,
+                      ctx.tileScratch(), &timing);
+      easuNs.fetch_add(timing.easuNs, std::memory_order_relaxed);
+      rcasNs.fetch_add(timing.rcasNs, std::memory_order_relaxed);
+    });
+    Metrics::shared().record(Stage::Easu, easuNs.load());
+    Metrics::shared().record(Stage::Rcas, rcasNs.load());
+  };
+
+  if (!neuralOnly) {
+    if (!ctx.tileScratch())
+      return false;
+    runFsr([&](size_t i) {
+      return needed(i) &&
+             (!neuralTile(i) || classes.featherEdges(static_cast<int>(i)));
+    });
+  }
+
+  if (neuralOnly || neuralTiles > 0) {
+    bool upscaled;
+    {
+      OMNIFORGE_TRACE_SCOPE("neural");
+      StageTimer timer(Metrics::shared(), Stage::Neural);
+      upscaled =
+          (partial || hybrid)
+              ? neuralRuns(
+                    ctx, input, output, neuralHalo(),
+                    [&](int i) { return neuralTile(i) && needed(i); },
+                    hybrid ? &classes : nullptr)
+              : runNcnnInferenceCpu(input, output, pool);
+    }
+    if (!upscaled) {
+      // Nothing can be reused after a half-finished frame.
+      dirty.invalidate();
+      classes.invalidate();
+      if (neuralOnly)
+        return false;
+      runFsr([&](size_t i) { return needed(i) && neuralTile(i); });
+    }
+  }
+
+  if (history.valid()) {
+    OMNIFORGE_TRACE_SCOPE("history");
+    pool.parallelFor(tiles, [&](size_t i) {
+      const Tile t = grid.tile(static_cast<int>(i));
+      if (needed(i))
+        copyRect(output, history, t.x0, t.y0, t.x1, t.y1);
+      else
+        copyRect(history, output, t.x0, t.y0, t.x1, t.y1);
+    });
+  }
+  size_t recomputed = 0;
+  for (size_t i = 0; i < tiles; ++i)
+    recomputed += needed(i);
+  Metrics::shared().recordTiles(tiles, tiles - recomputed, neuralTiles);
+  return true;
+}
+
+bool processFrame(const FrameView &input, const FrameView &output,
+                  UpscaleMode mode) {
+  thread_local UpscaleContext ctx;
+  return processFrame(ctx, input, output, mode);
+}
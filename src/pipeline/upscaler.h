@@ -1,9 +1,34 @@
 #pragma once
+#include "frame.h"
 #include "hybrid_mode.h"
+#include "upscale_context.h"
 
 // Forward declaration for Vulkan handles if not already included
 // But usually we include vulkan.h before this if needed, or use void*
 // For simplicity in the header, we can use void* for the image handle
 // or include vulkan if OMNIFORGE_HAVE_VULKAN is defined.
 
-void processFrame(void *inputImage, int width, int height, UpscaleMode mode);
+// Upscales a width x height image to outWidth x outHeight, any ratio of 1x
+// or more, in the swapchain's pixel format. `inputScale` < 1 upscales only
+// that top-left fraction of the input extent, for a renderer that draws
+// into a sub-rectangle of its images; the layer cannot make a game do
+// that and passes 1. The network takes RGBA8 only; BGRA8 and HDR frames
+// are upscaled by FSR alone.
+void processFrame(UpscaleContext &ctx, void *inputImage, int width,
+                  int height, int outWidth, int outHeight, UpscaleMode mode,
+                  float inputScale = 1.0f,
+                  PixelFormat format = PixelFormat::RGBA8);
+
+// CPU path: upscales a frame into `output`, which has the same pixel format
+// and may be any extent at least as large as the input. The network only
+// upscales RGBA8 by exactly 2x; otherwise HYBRID runs as FSR_ONLY and
+// NEURAL_ONLY fails. Returns false if the views are unusable.
+bool processFrame(UpscaleContext &ctx, const FrameView &input,
+                  const FrameView &output, UpscaleMode mode);
+
+// Same, with a context private to the calling thread.
+void processFrame(void *inputImage, int width, int height, int outWidth,
+                  int outHeight, UpscaleMode mode, float inputScale = 1.0f,
+                  PixelFormat format = PixelFormat::RGBA8);
+bool processFrame(const FrameView &input, const FrameView &output,
+                  UpscaleMode mode);
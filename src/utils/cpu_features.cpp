@@ -0,0 +1,123 @@
+// cpu_features.cpp - CPUID based feature and cache detection
+#include "cpu_features.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define OMNIFORGE_CPUID_X86 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define OMNIFORGE_CPUID_X86 1
+#endif
+
+#ifdef OMNIFORGE_CPUID_X86
+namespace {
+
+struct Regs { uint32_t eax, ebx, ecx, edx; };
+
+Regs cpuid(uint32_t leaf, uint32_t subleaf = 0) {
+    Regs r{};
+#ifdef _MSC_VER
+    int out[4];
+    __cpuidex(out, static_cast<int>(leaf), static_cast<int>(subleaf));
+    r = {uint32_t(out[0]), uint32_t(out[1]), uint32_t(out[2]), uint32_t(out[3])};
+#else
+    __cpuid_count(leaf, subleaf, r.eax, r.ebx, r.ecx, r.edx);
+#endif
+    return r;
+}
+
+uint64_t xgetbv0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+// Walks the deterministic cache parameter leaf (4 on Intel, 0x8000001D on
+// AMD) and records the L1 data and L2 sizes.
+bool readCacheLeaf(uint32_t leaf, CpuFeatures &f) {
+    bool found = false;
+    for (uint32_t i = 0; i < 16; ++i) {
+        Regs r = cpuid(leaf, i);
+        uint32_t type = r.eax & 0x1f;
+        if (type == 0) break;
+        uint32_t level = (r.eax >> 5) & 0x7;
+        size_t ways = ((r.ebx >> 22) & 0x3ff) + 1;
+        size_t parts = ((r.ebx >> 12) & 0x3ff) + 1;
+        size_t line = (r.ebx & 0xfff) + 1;
+        size_t sets = size_t(r.ecx) + 1;
+        size_t bytes = ways * parts * line * sets;
+        if (level == 1 && type == 1) { f.l1dBytes = bytes; found = true; }
+        if (level == 2 && (type == 1 || type == 3)) { f.l2Bytes = bytes; found = true; }
+    }
+    return found;
+}
+
+CpuFeatures detect() {
+    CpuFeatures f;
+    uint32_t maxLeaf = cpuid(0).eax;
+    uint32_t maxExt = cpuid(0x80000000u).eax;
+
+    if (maxLeaf >= 1) {
+        Regs r1 = cpuid(1);
+        f.sse41 = (r1.ecx >> 19) & 1;
+        bool fma = (r1.ecx >> 12) & 1;
+        bool osxsave = (r1.ecx >> 27) & 1;
+        bool avx = (r1.ecx >> 28) & 1;
+        f.f16c = (r1.ecx >> 29) & 1;
+
+        uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+        bool ymm = (xcr0 & 0x6) == 0x6;
+        bool zmm = (xcr0 & 0xe6) == 0xe6;
+        if (maxLeaf >= 7) {
+            Regs r7 = cpuid(7);
+            f.avx2 = avx && ymm && fma && ((r7.ebx >> 5) & 1);
+            f.avx512f = zmm && ((r7.ebx >> 16) & 1);
+            f.avx512fp16 = f.avx512f && ((r7.edx >> 23) & 1);
+        }
+        f.f16c = f.f16c && ymm;
+    }
+
+    if (!(maxLeaf >= 4 && readCacheLeaf(4, f)) &&
+        !(maxExt >= 0x8000001Du && readCacheLeaf(0x8000001Du, f))) {
+        if (maxExt >= 0x80000006u)
+            f.l2Bytes = size_t(cpuid(0x80000006u).ecx >> 16) * 1024;
+        if (maxExt >= 0x80000005u)
+            f.l1dBytes = size_t(cpuid(0x80000005u).ecx >> 24) * 1024;
+    }
+    return f;
+}
+
+} // namespace
+#endif
+
+const CpuFeatures &cpuFeatures() {
+    static const CpuFeatures features = [] {
+#ifdef OMNIFORGE_CPUID_X86
+        CpuFeatures f = detect();
+#else
+        CpuFeatures f;
+#endif
+        unsigned n = std::thread::hardware_concurrency();
+        f.logicalCores = n ? n : 1;
+        if (f.l1dBytes == 0) f.l1dBytes = 32 * 1024;
+        if (f.l2Bytes == 0) f.l2Bytes = 256 * 1024;
+        if (const char *isa = std::getenv("OMNIFORGE_CPU_ISA")) {
+            const bool scalar = std::strcmp(isa, "scalar") == 0;
+            const bool sse41 = scalar || std::strcmp(isa, "sse41") == 0;
+            const bool avx2 = sse41 || std::strcmp(isa, "avx2") == 0;
+            if (scalar) f.sse41 = false;
+            if (sse41) f.avx2 = f.f16c = false;
+            if (avx2) f.avx512f = f.avx512fp16 = false;
+        }
+        return f;
+    }();
+    return features;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+// Host CPU capabilities, detected once via CPUID on first use.
+// OMNIFORGE_CPU_ISA=scalar|sse41|avx2 hides everything wider, so the tests
+// and benchmarks can run the narrower kernel builds on a wide host.
+struct CpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;     // AVX2 + FMA, with OS support for YMM state
+    bool f16c = false;
+    bool avx512f = false;  // with OS support for ZMM state
+    bool avx512fp16 = false;
+    size_t l1dBytes = 32 * 1024;
+    size_t l2Bytes = 256 * 1024;
+    unsigned logicalCores = 1;
+};
+
+const CpuFeatures &cpuFeatures();
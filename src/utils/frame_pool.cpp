@@ -0,0 +1,245 @@
+// frame_pool.cpp - recycling, huge-page backed frame buffers
+#include "frame_pool.h"
+#include <algorithm>
+#include <iterator>
+#include <new>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+constexpr size_t kAlign = 64;
+constexpr size_t kHugePage = size_t(2) << 20;
+// Format tag for acquireBytes() blocks.
+constexpr uint32_t kRawFormat = 0xffffffffu;
+
+size_t roundUp(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+#ifdef _WIN32
+// Large pages need SeLockMemoryPrivilege; try to enable it once and
+// remember whether that worked.
+size_t largePageSize() {
+    static const size_t size = [] {
+        const size_t min = GetLargePageMinimum();
+        if (min == 0) return size_t(0);
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(),
+                              TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+            return size_t(0);
+        TOKEN_PRIVILEGES tp = {};
+        tp.PrivilegeCount = 1;
+        tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool ok = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege",
+                                        &tp.Privileges[0].Luid) &&
+                  AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr) &&
+                  GetLastError() == ERROR_SUCCESS;
+        CloseHandle(token);
+        return ok ? min : size_t(0);
+    }();
+    return size;
+}
+#endif
+
+} // namespace
+
+FramePool::Handle &FramePool::Handle::operator=(Handle &&o) noexcept {
+    if (this != &o) {
+        reset();
+        pool_ = o.pool_;
+        data_ = o.data_;
+        stride_ = o.stride_;
+        bytes_ = o.bytes_;
+        mapped_ = o.mapped_;
+        shape_ = o.shape_;
+        huge_ = o.huge_;
+        o.pool_ = nullptr;
+        o.data_ = nullptr;
+    }
+    return *this;
+}
+
+void FramePool::Handle::reset() {
+    if (data_ && pool_) pool_->release(*this);
+    pool_ = nullptr;
+    data_ = nullptr;
+}
+
+FramePool::FramePool(size_t maxCachedBytes) : maxCached_(maxCachedBytes) {}
+
+FramePool::~FramePool() { trim(); }
+
+bool FramePool::allocate(Block &b) {
+    b.huge = false;
+    b.mapped = 0;
+    if (b.bytes < kHugePage) {
+        b.data = static_cast<uint8_t *>(
+            ::operator new(b.bytes, std::align_val_t(kAlign), std::nothrow));
+        return b.data != nullptr;
+    }
+
+#ifdef _WIN32
+    if (const size_t large = largePageSize()) {
+        const size_t len = roundUp(b.bytes, large);
+        void *p = VirtualAlloc(nullptr, len,
+                               MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                               PAGE_READWRITE);
+        if (p) {
+            b.data = static_cast<uint8_t *>(p);
+            b.mapped = len;
+            b.huge = true;
+            return true;
+        }
+    }
+    const size_t len = roundUp(b.bytes, 4096);
+    void *p = VirtualAlloc(nullptr, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!p) return false;
+    // Fault the pages in now rather than on the frame path.
+    for (size_t off = 0; off < len; off += 4096)
+        static_cast<volatile uint8_t *>(p)[off] = 0;
+    b.data = static_cast<uint8_t *>(p);
+    b.mapped = len;
+    return true;
+#else
+    const size_t len = roundUp(b.bytes, kHugePage);
+    void *p;
+#ifdef MAP_HUGETLB
+    int populate = 0;
+#ifdef MAP_POPULATE
+    populate = MAP_POPULATE;
+#endif
+    // Only succeeds if the admin reserved huge pages (vm.nr_hugepages).
+    p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+    if (p != MAP_FAILED) {
+        b.data = static_cast<uint8_t *>(p);
+        b.mapped = len;
+        b.huge = true;
+        return true;
+    }
+#endif
+    // Transparent huge pages: advise before touching, then pre-fault.
+    p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return false;
+#ifdef MADV_HUGEPAGE
+    b.huge = madvise(p, len, MADV_HUGEPAGE) == 0;
+#endif
+    for (size_t off = 0; off < len; off += 4096)
+        static_cast<volatile uint8_t *>(p)[off] = 0;
+    b.data = static_cast<uint8_t *>(p);
+    b.mapped = len;
+    return true;
+#endif
+}
+
+void FramePool::deallocate(const Block &b) {
+    if (b.mapped == 0) {
+        ::operator delete(b.data, std::align_val_t(kAlign));
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(b.data, 0, MEM_RELEASE);
+#else
+    munmap(b.data, b.mapped);
+#endif
+}
+
+FramePool::Handle FramePool::acquire(const Shape &shape) {
+    Handle h;
+    if (shape.width <= 0 || shape.height <= 0 || shape.bytesPerPixel <= 0)
+        return h;
+
+    Block b{};
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        // Most recently released first: its pages are the likeliest to
+        // still be in cache.
+        auto it = std::find_if(free_.rbegin(), free_.rend(),
+                               [&](const Block &f) { return f.shape == shape; });
+        if (it != free_.rend()) {
+            b = *it;
+            cached_ -= b.mapped ? b.mapped : b.bytes;
+            free_.erase(std::next(it).base());
+        }
+    }
+
+    if (!b.data) {
+        b.shape = shape;
+        b.stride = roundUp(size_t(shape.width) * size_t(shape.bytesPerPixel), kAlign);
+        b.bytes = b.stride * size_t(shape.height);
+        if (!allocate(b)) {
+            // Out of memory: drop the cache and try once more.
+            trim();
+            if (!allocate(b)) return h;
+        }
+    }
+
+    h.pool_ = this;
+    h.data_ = b.data;
+    h.stride_ = b.stride;
+    h.bytes_ = b.bytes;
+    h.mapped_ = b.mapped;
+    h.shape_ = b.shape;
+    h.huge_ = b.huge;
+    return h;
+}
+
+FramePool::Handle FramePool::acquireBytes(size_t bytes) {
+    Shape s;
+    s.width = static_cast<int>(roundUp(std::max<size_t>(bytes, 1), kAlign));
+    s.height = 1;
+    s.bytesPerPixel = 1;
+    s.format = kRawFormat;
+    return acquire(s);
+}
+
+void FramePool::release(Handle &h) {
+    const Block b{h.data_, h.stride_, h.bytes_, h.mapped_, h.shape_, h.huge_};
+    std::vector<Block> evicted;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        free_.push_back(b);
+        cached_ += b.mapped ? b.mapped : b.bytes;
+        evictLocked(maxCached_, evicted);
+    }
+    for (const Block &e : evicted) deallocate(e);
+}
+
+void FramePool::evictLocked(size_t budget, std::vector<Block> &evicted) {
+    // free_ is in release order, so the front is least recently used.
+    size_t n = 0;
+    while (cached_ > budget && n < free_.size()) {
+        cached_ -= free_[n].mapped ? free_[n].mapped : free_[n].bytes;
+        ++n;
+    }
+    evicted.insert(evicted.end(), free_.begin(), free_.begin() + n);
+    free_.erase(free_.begin(), free_.begin() + n);
+}
+
+void FramePool::trim() {
+    std::vector<Block> evicted;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        evictLocked(0, evicted);
+    }
+    for (const Block &e : evicted) deallocate(e);
+}
+
+size_t FramePool::cachedBytes() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return cached_;
+}
+
+FramePool &FramePool::shared() {
+    // Never destroyed: file-scope statics elsewhere (parked frames, the
+    // swapchain table) may still return Handles during exit, after a
+    // function-local static pool would already be gone.
+    static FramePool *pool = new FramePool();
+    return *pool;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Recycling pool for frame-sized buffers. Buffers are 64-byte aligned with
+// 64-byte aligned rows; anything of 2 MB or more is mapped directly, on
+// huge pages where the OS allows it (MAP_HUGETLB, then transparent huge
+// pages; MEM_LARGE_PAGES on Windows) and pre-faulted, so neither the
+// first frame at a new resolution nor the kernels' TLB pay per 4 KB page.
+// Released buffers go back to a per-shape free list; the least recently
+// used ones are unmapped once the cache outgrows its budget.
+class FramePool {
+public:
+    // What a buffer is for: extent, bytes per pixel and a caller-defined
+    // format tag (buffers of different formats are never mixed up).
+    struct Shape {
+        int width = 0;
+        int height = 0;
+        int bytesPerPixel = 4;
+        uint32_t format = 0;
+
+        bool operator==(const Shape &o) const {
+            return width == o.width && height == o.height &&
+                   bytesPerPixel == o.bytesPerPixel && format == o.format;
+        }
+    };
+
+    // Move-only owner of one buffer; returns it to the pool on destruction.
+    class Handle {
+    public:
+        Handle() = default;
+        ~Handle() { reset(); }
+        Handle(Handle &&o) noexcept { *this = std::move(o); }
+        Handle &operator=(Handle &&o) noexcept;
+        Handle(const Handle &) = delete;
+        Handle &operator=(const Handle &) = delete;
+
+        explicit operator bool() const { return data_ != nullptr; }
+        uint8_t *data() const { return data_; }
+        size_t stride() const { return stride_; }
+        size_t bytes() const { return bytes_; }
+        const Shape &shape() const { return shape_; }
+        bool hugePages() const { return huge_; }
+
+        void reset();
+
+    private:
+        friend class FramePool;
+        FramePool *pool_ = nullptr;
+        uint8_t *data_ = nullptr;
+        size_t stride_ = 0;
+        size_t bytes_ = 0;    // usable bytes
+        size_t mapped_ = 0;   // bytes actually reserved, 0 for heap blocks
+        Shape shape_;
+        bool huge_ = false;
+    };
+
+    explicit FramePool(size_t maxCachedBytes = size_t(512) << 20);
+    ~FramePool();
+
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    // A buffer of the given shape; an empty handle if memory is exhausted.
+    Handle acquire(const Shape &shape);
+
+    // Flat scratch block of at least `bytes`, pooled under its own shape.
+    Handle acquireBytes(size_t bytes);
+
+    // Frees every cached buffer (outstanding handles are unaffected).
+    void trim();
+
+    size_t cachedBytes() const;
+
+    // Process-wide pool used by the pipeline and the batch tools. Lives
+    // until the process exits, so Handles may outlive static destruction.
+    static FramePool &shared();
+
+private:
+    struct Block {
+        uint8_t *data;
+        size_t stride;
+        size_t bytes;
+        size_t mapped;
+        Shape shape;
+        bool huge;
+    };
+
+    void release(Handle &h);
+    // Moves least recently used blocks into `evicted` until the cache fits
+    // `budget`; the caller frees them after dropping the lock, so munmap
+    // never runs under it.
+    void evictLocked(size_t budget, std::vector<Block> &evicted);
+    static bool allocate(Block &b);
+    static void deallocate(const Block &b);
+
+    mutable std::mutex mutex_;
+    std::vector<Block> free_;  // in release order, oldest first
+    size_t cached_ = 0;
+    size_t maxCached_;
+};
@@ -1,78 +1,217 @@
 #pragma once
-#include <queue>
-#include <mutex>
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// What push() does when the ring is full.
+enum class OverflowPolicy {
+    Block,       // wait for the consumer to make room
+    DropOldest,  // discard the oldest pending item
+    LatestWins,  // discard everything pending; only the newest item survives
+};
 
-// Simple thread-safe queue for passing frame handles between threads.
+// Bounded lock-free ring for handing frames between threads (SPSC or MPSC;
+// any number of consumers is also safe). It holds at most the capacity it
+// was created with, not that rounded up, so a frame queue's bound is also
+// its memory bound. Slots carry a sequence number (Vyukov's bounded
+// queue), head and tail live on separate cache lines, and full/empty never
+// touch a lock. A thread that has to wait spins briefly and only then
+// parks on a condition variable; the other side pays for a wake-up only
+// when somebody is actually parked, so a producer on the present path
+// never makes a futex call while the consumer keeps up.
 template<typename T>
 class LatencyQueue {
 public:
+    explicit LatencyQueue(size_t capacity = 4,
+                          OverflowPolicy policy = OverflowPolicy::Block)
+        : capacity_(capacity > 0 ? capacity : 1),
+          // Sequence numbers cannot tell a full one-cell ring from an
+          // empty one; capacity 1 gets two cells and a check on the count.
+          cellCount_(capacity_ > 1 ? capacity_ : 2), policy_(policy) {
+        cells_.reset(new Cell[cellCount_]);
+        for (size_t i = 0; i < cellCount_; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    LatencyQueue(const LatencyQueue &) = delete;
+    LatencyQueue &operator=(const LatencyQueue &) = delete;
+
+    // Enqueues `item`, applying the overflow policy if the ring is full.
     void push(T item) {
-        {
-            std::lock_guard<std::mutex> lk(m_);
-            q_.push(std::move(item));
+        switch (policy_) {
+        case OverflowPolicy::Block:
+            if (!spinUntil([&] { return tryEnqueue(item); })) {
+                park(producersParked_, notFull_, [&] { return tryEnqueue(item); });
+            }
+            break;
+        case OverflowPolicy::DropOldest:
+            while (!tryEnqueue(item)) {
+                T stale;
+                if (tryDequeue(stale)) dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+            break;
+        case OverflowPolicy::LatestWins:
+            do {
+                T stale;
+                while (tryDequeue(stale)) dropped_.fetch_add(1, std::memory_order_relaxed);
+            } while (!tryEnqueue(item));
+            break;
         }
-        cv_.notify_one();
+        wake(consumersParked_, notEmpty_);
     }
 
-    // Blocks until item available
+    // Enqueues without waiting or dropping; false if the ring is full.
+    bool try_push(T &item) {
+        if (!tryEnqueue(item)) return false;
+        wake(consumersParked_, notEmpty_);
+        return true;
+    }
+
+    // Blocks until an item is available.
     T pop() {
-        std::unique_lock<std::mutex> lk(m_);
-        cv_.wait(lk, [this]{ return !q_.empty(); });
-        T v = std::move(q_.front());
-        q_.pop();
+        T v;
+        if (!spinUntil([&] { return tryDequeue(v); })) {
+            park(consumersParked_, notEmpty_, [&] { return tryDequeue(v); });
+        }
+        wake(producersParked_, notFull_);
         return v;
     }
 
     bool try_pop(T &out) {
-        std::lock_guard<std::mutex> lk(m_);
-        if (q_.empty()) return false;
-        out = std::move(q_.front());
-        q_.pop();
+        if (!tryDequeue(out)) return false;
+        wake(producersParked_, notFull_);
         return true;
     }
 
+    // Snapshot; may be stale by the time it is read.
     size_t size() const {
-        std::lock_guard<std::mutex> lk(m_);
-        return q_.size();
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
     }
 
+    // Exactly the capacity the queue was created with (at least 1).
+    size_t capacity() const { return capacity_; }
+
+    // Items discarded by DropOldest/LatestWins so far.
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
 private:
-    mutable std::mutex m_;
-    std::condition_variable cv_;
-    std::queue<T> q_;
-};
-#pragma once
+    static constexpr int kSpinIterations = 256;
 
-#include <mutex>
-#include <condition_variable>
-#include <queue>
+    struct alignas(64) Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
 
-template<typename T>
-class LatencyQueue {
-public:
-    void push(T item) {
-        std::lock_guard<std::mutex> lk(m_);
-        q_.push(std::move(item));
-        cv_.notify_one();
+    static void cpuRelax() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
     }
 
-    T pop() {
-        std::unique_lock<std::mutex> lk(m_);
-        cv_.wait(lk, [&]{ return !q_.empty(); });
-        T item = std::move(q_.front()); q_.pop();
-        return item;
+    bool tryEnqueue(T &item) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            if (cellCount_ != capacity_) {
+                // A head past `pos` means `pos` is stale; the sequence
+                // check below catches that.
+                const size_t head = head_.load(std::memory_order_acquire);
+                if (pos >= head && pos - head >= capacity_)
+                    return false;
+            }
+            cell = &cells_[pos % cellCount_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(item);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
     }
 
-    bool try_pop(T &out) {
-        std::lock_guard<std::mutex> lk(m_);
-        if (q_.empty()) return false;
-        out = std::move(q_.front()); q_.pop();
+    bool tryDequeue(T &out) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &cells_[pos % cellCount_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->seq.store(pos + cellCount_, std::memory_order_release);
         return true;
     }
 
-private:
-    std::mutex m_;
-    std::condition_variable cv_;
-    std::queue<T> q_;
+    template<typename Pred>
+    static bool spinUntil(Pred pred) {
+        for (int i = 0; i < kSpinIterations; ++i) {
+            if (pred()) return true;
+            cpuRelax();
+        }
+        return false;
+    }
+
+    // Announce ourselves before re-checking, and the waker checks for
+    // parked threads after publishing; the fences make sure at least one
+    // side sees the other.
+    template<typename Pred>
+    void park(std::atomic<int> &parked, std::condition_variable &cv, Pred pred) {
+        std::unique_lock<std::mutex> lk(parkMutex_);
+        parked.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lk, pred);
+        parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake(std::atomic<int> &parked, std::condition_variable &cv) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) == 0) return;
+        {
+            std::lock_guard<std::mutex> lk(parkMutex_);
+        }
+        cv.notify_all();
+    }
+
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::unique_ptr<Cell[]> cells_;
+    size_t capacity_;
+    size_t cellCount_;
+    OverflowPolicy policy_;
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<int> consumersParked_{0};
+    std::atomic<int> producersParked_{0};
+    std::mutex parkMutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
 };
@@ -0,0 +1,266 @@
+// log.cpp - per-thread log rings, drained and formatted by a background thread
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t kRingRecords = 512;
+static_assert((kRingRecords & (kRingRecords - 1)) == 0, "ring index is masked");
+static_assert(sizeof(LogRecord) == 256, "records are four cache lines");
+
+constexpr milliseconds kDrainPeriod(10);
+
+// One thread's messages. The owning thread is the only producer; whoever
+// holds the drain mutex is the only consumer.
+struct Ring {
+    std::atomic<uint64_t> head{0};     // next record the owner fills
+    std::atomic<uint64_t> tail{0};     // next record to format
+    std::atomic<uint64_t> dropped{0};  // messages lost to a full ring
+    LogRecord records[kRingRecords];
+    // Guarded by the registry mutex.
+    bool inUse = false;
+};
+
+// The calling thread's ring, handed back for reuse when the thread exits.
+struct RingOwner {
+    Ring *ring = nullptr;
+    uint32_t tid = 0;
+    ~RingOwner();
+};
+
+thread_local RingOwner t_owner;
+
+// Every ring ever handed out. Never freed, like the logger itself.
+struct Registry {
+    std::mutex mutex;
+    std::vector<Ring *> rings;
+    uint32_t nextTid = 1;
+
+    Ring *acquire();
+};
+
+Registry &registry() {
+    static Registry *r = new Registry();
+    return *r;
+}
+
+RingOwner::~RingOwner() {
+    if (!ring) return;
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring->inUse = false;
+}
+
+Ring *Registry::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    t_owner.tid = nextTid++;
+    // Records a finished thread left behind stay queued; each carries its
+    // own thread id.
+    for (Ring *r : rings) {
+        if (!r->inUse) {
+            r->inUse = true;
+            return r;
+        }
+    }
+    Ring *r = new Ring();
+    r->inUse = true;
+    rings.push_back(r);
+    return r;
+}
+
+LogLevel levelFromEnv() {
+    static const char *const kNames[] = {"debug", "info", "warn", "error",
+                                         "off"};
+    const char *env = std::getenv("OMNIFORGE_LOG");
+    if (!env || !*env) return LogLevel::Info;
+    for (int i = 0; i < 5; ++i) {
+        if (std::string(env) == kNames[i]) return static_cast<LogLevel>(i);
+    }
+    std::fprintf(stderr, "log: unknown OMNIFORGE_LOG '%s', using info\n", env);
+    return LogLevel::Info;
+}
+
+void appendArg(std::string &line, const LogRecord &r, const LogArg &a) {
+    char buf[32];
+    switch (a.type) {
+    case LogArg::Bool:
+        line += a.u ? "true" : "false";
+        return;
+    case LogArg::Int:
+        std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(a.i));
+        break;
+    case LogArg::UInt:
+        std::snprintf(buf, sizeof(buf), "%llu",
+                      static_cast<unsigned long long>(a.u));
+        break;
+    case LogArg::Double:
+        std::snprintf(buf, sizeof(buf), "%g", a.d);
+        break;
+    case LogArg::Ptr:
+        std::snprintf(buf, sizeof(buf), "%p", a.p);
+        break;
+    case LogArg::Text:
+        line.append(r.text + a.text.offset, a.text.size);
+        return;
+    }
+    line += buf;
+}
+
+void formatRecord(std::string &line, const LogRecord &r) {
+    static const char kLevels[] = "DIWE";
+    char prefix[48];
+    std::snprintf(prefix, sizeof(prefix), "%10.3f %c [%u] ",
+                  static_cast<double>(r.timeNs) * 1e-9,
+                  kLevels[static_cast<int>(r.level) & 3], r.tid);
+    line += prefix;
+    size_t next = 0;
+    for (const char *c = r.format; *c; ++c) {
+        if (c[0] == '{' && c[1] == '}' && next < r.argCount) {
+            appendArg(line, r, r.args[next++]);
+            ++c;
+        } else {
+            line += *c;
+        }
+    }
+    line += '\n';
+}
+
+} // namespace
+
+struct Logger::Impl {
+    steady_clock::time_point origin = steady_clock::now();
+    std::FILE *out = stderr;
+
+    // One consumer at a time; the rest is scratch space for it.
+    std::mutex drainMutex;
+    std::vector<Ring *> rings;
+    std::vector<const LogRecord *> pending;
+    std::vector<uint64_t> heads;
+    std::string line;
+
+    std::mutex startMutex;
+    std::thread drainer;
+    std::atomic<bool> async{false};
+    std::atomic<bool> stopping{false};
+
+    void start();
+    void drainLocked();
+};
+
+void Logger::Impl::start() {
+    std::lock_guard<std::mutex> lock(startMutex);
+    if (drainer.joinable() || stopping.load()) return;
+    async.store(true, std::memory_order_relaxed);
+    drainer = std::thread([this] {
+        while (!stopping.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(kDrainPeriod);
+            std::lock_guard<std::mutex> drainLock(drainMutex);
+            drainLocked();
+        }
+    });
+}
+
+void Logger::Impl::drainLocked() {
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        rings = registry().rings;
+    }
+    bool wrote = false;
+    pending.clear();
+    heads.resize(rings.size());
+    for (size_t i = 0; i < rings.size(); ++i) {
+        Ring *r = rings[i];
+        if (const uint64_t n = r->dropped.exchange(0, std::memory_order_relaxed)) {
+            std::fprintf(out, "log: %llu messages dropped (ring full)\n",
+                         static_cast<unsigned long long>(n));
+            wrote = true;
+        }
+        heads[i] = r->head.load(std::memory_order_acquire);
+        for (uint64_t j = r->tail.load(std::memory_order_relaxed); j < heads[i]; ++j)
+            pending.push_back(&r->records[j & (kRingRecords - 1)]);
+    }
+    // Interleave the threads' messages in the order they were logged.
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const LogRecord *a, const LogRecord *b) {
+                         return a->timeNs < b->timeNs;
+                     });
+    for (const LogRecord *r : pending) {
+        line.clear();
+        formatRecord(line, *r);
+        std::fwrite(line.data(), 1, line.size(), out);
+        wrote = true;
+    }
+    for (size_t i = 0; i < rings.size(); ++i)
+        rings[i]->tail.store(heads[i], std::memory_order_release);
+    if (wrote) std::fflush(out);
+}
+
+Logger::Logger() : p(new Impl) {
+    level_.store(levelFromEnv(), std::memory_order_relaxed);
+    if (const char *path = std::getenv("OMNIFORGE_LOG_FILE")) {
+        if (std::FILE *f = *path ? std::fopen(path, "a") : nullptr)
+            p->out = f;
+        else
+            std::fprintf(stderr, "log: cannot open %s, using stderr\n", path);
+    }
+    // Executables and the Linux layer get their last messages out here;
+    // the injected DLL shuts the logger down with the hooks.
+    std::atexit([] { Logger::shared().shutdown(); });
+}
+
+Logger &Logger::shared() {
+    static Logger *logger = new Logger();
+    return *logger;
+}
+
+LogRecord *Logger::claim() {
+    Ring *ring = t_owner.ring;
+    if (!ring) {
+        ring = t_owner.ring = registry().acquire();
+        p->start();
+    }
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= kRingRecords) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    LogRecord *r = &ring->records[head & (kRingRecords - 1)];
+    r->timeNs = static_cast<uint64_t>(
+        duration_cast<nanoseconds>(steady_clock::now() - p->origin).count());
+    r->tid = t_owner.tid;
+    return r;
+}
+
+void Logger::commit() {
+    Ring *ring = t_owner.ring;
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+    if (!p->async.load(std::memory_order_relaxed)) flush();
+}
+
+void Logger::flush() {
+    std::lock_guard<std::mutex> lock(p->drainMutex);
+    p->drainLocked();
+}
+
+void Logger::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(p->startMutex);
+        p->stopping.store(true);
+        p->async.store(false, std::memory_order_relaxed);
+        if (p->drainer.joinable()) p->drainer.join();
+    }
+    // try_lock: at process exit on Windows the drainer may have been
+    // killed while holding the lock.
+    if (p->drainMutex.try_lock()) {
+        p->drainLocked();
+        p->drainMutex.unlock();
+    }
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Asynchronous logger for the hooks and engines. A call site copies its
+// format string pointer and raw arguments into a fixed-size record in the
+// calling thread's own ring, so logging from the present path or an
+// inference tile costs a clock read and a few stores: no lock, no syscall,
+// no formatting, no allocation after the thread's first message. A
+// background thread drains the rings every few milliseconds and formats
+// the lines. A full ring drops the message (and says so later) rather
+// than wait.
+//
+// Messages use "{}" placeholders:
+//
+//   OMNIFORGE_LOG_INFO("ncnn: {} model ready after {} s.", name, seconds);
+//
+// The format must be a string literal. Arguments may be integers, enums,
+// floating point, bool, pointers, C strings or std::string; strings are
+// copied (up to the record's text space), everything else by value.
+//
+// OMNIFORGE_LOG (debug, info, warn, error, off) sets the runtime level,
+// default info; OMNIFORGE_LOG_FILE appends to a file instead of stderr.
+// Levels below OMNIFORGE_LOG_MIN_LEVEL are compiled out.
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error, Off };
+
+#ifndef OMNIFORGE_LOG_MIN_LEVEL
+#define OMNIFORGE_LOG_MIN_LEVEL 0
+#endif
+
+// One argument as captured at the call site.
+struct LogArg {
+    enum Type : uint8_t { Bool, Int, UInt, Double, Ptr, Text };
+    Type type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const void *p;
+        struct {
+            uint16_t offset;
+            uint16_t size;
+        } text;
+    };
+};
+
+// One message waiting to be formatted.
+struct LogRecord {
+    static constexpr size_t kMaxArgs = 8;
+    static constexpr size_t kTextBytes = 104;
+
+    const char *format;
+    uint64_t timeNs;
+    LogArg args[kMaxArgs];
+    uint32_t tid;
+    LogLevel level;
+    uint8_t argCount;
+    uint16_t textUsed;
+    char text[kTextBytes];
+
+    template <typename T> void add(const T &value);
+
+private:
+    void addText(LogArg &a, const char *s, size_t n) {
+        n = s ? std::min(n, kTextBytes - textUsed) : 0;
+        a.type = LogArg::Text;
+        a.text.offset = textUsed;
+        a.text.size = static_cast<uint16_t>(n);
+        if (n) std::memcpy(text + textUsed, s, n);
+        textUsed = static_cast<uint16_t>(textUsed + n);
+    }
+};
+
+class Logger {
+public:
+    bool enabled(LogLevel level) const {
+        return level >= level_.load(std::memory_order_relaxed);
+    }
+    void setLevel(LogLevel level) {
+        level_.store(level, std::memory_order_relaxed);
+    }
+
+    // Queues a message on the calling thread's ring; see OMNIFORGE_LOG_*.
+    template <typename... Args>
+    void write(LogLevel level, const char *format, const Args &...args) {
+        static_assert(sizeof...(Args) <= LogRecord::kMaxArgs,
+                      "too many log arguments");
+        LogRecord *r = claim();
+        if (!r) return;
+        r->format = format;
+        r->level = level;
+        r->argCount = 0;
+        r->textUsed = 0;
+        (r->add(args), ...);
+        commit();
+    }
+
+    // Formats everything queued so far on the calling thread.
+    void flush();
+    // Drains the rings and stops the background thread; messages after
+    // this are formatted by the thread that logs them. Called from the
+    // hooks' shutdown and at exit.
+    void shutdown();
+
+    // Process-wide logger. Never destroyed, so threads may log during
+    // static destruction.
+    static Logger &shared();
+
+private:
+    Logger();
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    // The next free record of the calling thread's ring, or null if the
+    // ring is full.
+    LogRecord *claim();
+    // Publishes the record claim() returned.
+    void commit();
+
+    struct Impl;
+    Impl *p;
+    std::atomic<LogLevel> level_{LogLevel::Info};
+};
+
+template <typename T> void LogRecord::add(const T &value) {
+    using D = std::decay_t<T>;
+    LogArg &a = args[argCount++];
+    if constexpr (std::is_same_v<D, bool>) {
+        a.type = LogArg::Bool;
+        a.u = value;
+    } else if constexpr (std::is_enum_v<D>) {
+        using U = std::underlying_type_t<D>;
+        a.type = std::is_signed_v<U> ? LogArg::Int : LogArg::UInt;
+        a.i = static_cast<int64_t>(value);
+    } else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>) {
+        a.type = LogArg::Int;
+        a.i = value;
+    } else if constexpr (std::is_integral_v<D>) {
+        a.type = LogArg::UInt;
+        a.u = value;
+    } else if constexpr (std::is_floating_point_v<D>) {
+        a.type = LogArg::Double;
+        a.d = value;
+    } else if constexpr (std::is_same_v<D, const char *> ||
+                         std::is_same_v<D, char *>) {
+        const char *s = value;
+        addText(a, s, s ? std::strlen(s) : 0);
+    } else if constexpr (std::is_same_v<D, std::string>) {
+        addText(a, value.data(), value.size());
+    } else if constexpr (std::is_pointer_v<D>) {
+        a.type = LogArg::Ptr;
+        a.p = reinterpret_cast<const void *>(value);
+    } else {
+        static_assert(!sizeof(T *), "unsupported log argument type");
+    }
+}
+
+constexpr bool logCompiledIn(LogLevel level) {
+    return static_cast<int>(level) + 1 > OMNIFORGE_LOG_MIN_LEVEL;
+}
+
+#define OMNIFORGE_LOG_AT(level, ...)                                          \
+    do {                                                                      \
+        if constexpr (logCompiledIn(level)) {                                 \
+            if (Logger::shared().enabled(level))                              \
+                Logger::shared().write(level, __VA_ARGS__);                   \
+        }                                                                     \
+    } while (0)
+#define OMNIFORGE_LOG_DEBUG(...) OMNIFORGE_LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define OMNIFORGE_LOG_INFO(...) OMNIFORGE_LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define OMNIFORGE_LOG_WARN(...) OMNIFORGE_LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define OMNIFORGE_LOG_ERROR(...) OMNIFORGE_LOG_AT(LogLevel::Error, __VA_ARGS__)
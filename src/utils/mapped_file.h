@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Read-only memory mapping of a whole file. The mapping is shared and
+// file-backed, so every process mapping the same file shares its physical
+// pages, and nothing is read from disk until a page is touched.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(MappedFile &&o) noexcept { *this = std::move(o); }
+    MappedFile &operator=(MappedFile &&o) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Maps `path`; false (and an empty mapping) on failure.
+    bool open(const std::string &path);
+    void close();
+
+    // Asks the OS to start reading the whole file in the background.
+    void prefetch() const;
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void *mapping_ = nullptr;
+#endif
+};
@@ -1,33 +1,223 @@
-// metrics.cpp - simple FPS/latency counters (stub)
+// metrics.cpp - FPS and per-stage latency histograms
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <mutex>
 #include "metrics.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 using namespace std::chrono;
 
+namespace {
+
+// Log-linear buckets: exact below 32 ns, then 32 sub-buckets per power of
+// two up to 2^41 ns (~36 minutes); anything above lands in the last bucket.
+constexpr int kSubBits = 5;
+constexpr int kSub = 1 << kSubBits;
+constexpr int kMaxMsb = 40;
+constexpr int kBuckets = kSub + (kMaxMsb - kSubBits + 1) * kSub;
+
+// Threads are spread over a fixed set of shards so concurrent recorders
+// rarely share a cache line and nothing needs registering.
+constexpr int kShards = 8;
+constexpr int kHistograms = static_cast<int>(Stage::Count) + 1;  // + frame times
+
+int msb64(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return static_cast<int>(idx);
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+int bucketOf(uint64_t v) {
+    if (v < static_cast<uint64_t>(kSub)) return static_cast<int>(v);
+    const int msb = msb64(v);
+    if (msb > kMaxMsb) return kBuckets - 1;
+    const int shift = msb - kSubBits;
+    return kSub + shift * kSub + static_cast<int>((v >> shift) & (kSub - 1));
+}
+
+// Midpoint of the values a bucket covers, in nanoseconds.
+double bucketValue(int idx) {
+    if (idx < kSub) return idx;
+    const int shift = (idx - kSub) / kSub;
+    const uint64_t mant = static_cast<uint64_t>((idx - kSub) % kSub);
+    const uint64_t lo = (static_cast<uint64_t>(kSub) + mant) << shift;
+    return static_cast<double>(lo) + static_cast<double>((uint64_t(1) << shift) - 1) / 2.0;
+}
+
+struct alignas(64) Histogram {
+    std::atomic<uint32_t> buckets[kBuckets] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+
+    void add(uint64_t ns) {
+        buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t cur = max.load(std::memory_order_relaxed);
+        while (ns > cur && !max.compare_exchange_weak(cur, ns, std::memory_order_relaxed)) {}
+    }
+
+    void clear() {
+        for (auto &b : buckets) b.store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+};
+
+std::atomic<unsigned> g_nextShard{0};
+
+int threadShard() {
+    thread_local const int shard =
+        static_cast<int>(g_nextShard.fetch_add(1, std::memory_order_relaxed) % kShards);
+    return shard;
+}
+
+int64_t nowNs() {
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+const char *stageName(Stage stage) {
+    switch (stage) {
+    case Stage::Capture: return "capture";
+    case Stage::Easu: return "easu";
+    case Stage::Rcas: return "rcas";
+    case Stage::Neural: return "neural";
+    case Stage::Compose: return "compose";
+    case Stage::Present: return "present";
+    default: return "unknown";
+    }
+}
+
 struct Metrics::Impl {
-    std::mutex m;
-    steady_clock::time_point last = steady_clock::now();
-    int frames = 0;
-    double fps = 0.0;
+    Histogram hist[kHistograms][kShards];
+    std::atomic<int64_t> lastPresent{0};
+    std::atomic<int64_t> windowStart{0};
+    std::atomic<int> frames{0};
+    std::atomic<double> fps{0.0};
+    std::atomic<uint64_t> tilesTotal{0};
+    std::atomic<uint64_t> tilesSkipped{0};
+    std::atomic<uint64_t> tilesNeural{0};
+
+    LatencyStats stats(int which) const;
 };
 
+LatencyStats Metrics::Impl::stats(int which) const {
+    static_assert(kBuckets * sizeof(uint64_t) <= 16 * 1024, "merge buffer lives on the stack");
+    uint64_t merged[kBuckets] = {};
+    LatencyStats s;
+    uint64_t sum = 0, maxNs = 0;
+    for (const Histogram &h : hist[which]) {
+        for (int i = 0; i < kBuckets; ++i)
+            merged[i] += h.buckets[i].load(std::memory_order_relaxed);
+        sum += h.sum.load(std::memory_order_relaxed);
+        maxNs = std::max(maxNs, h.max.load(std::memory_order_relaxed));
+    }
+    for (uint64_t c : merged) s.count += c;
+    if (s.count == 0) return s;
+
+    const double maxD = static_cast<double>(maxNs);
+    auto percentile = [&](double q) {
+        const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * s.count + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            seen += merged[i];
+            if (seen >= target) return std::min(bucketValue(i), maxD);
+        }
+        return maxD;
+    };
+    s.meanMs = static_cast<double>(sum) / s.count / 1e6;
+    s.p50Ms = percentile(0.50) / 1e6;
+    s.p95Ms = percentile(0.95) / 1e6;
+    s.p99Ms = percentile(0.99) / 1e6;
+    s.maxMs = maxD / 1e6;
+
+    // Mean of the slowest 1%, walked down from the top bucket.
+    const uint64_t worst = std::max<uint64_t>(1, s.count / 100);
+    uint64_t taken = 0;
+    double total = 0.0;
+    for (int i = kBuckets - 1; i >= 0 && taken < worst; --i) {
+        const uint64_t n = std::min(merged[i], worst - taken);
+        total += static_cast<double>(n) * std::min(bucketValue(i), maxD);
+        taken += n;
+    }
+    if (total > 0.0) s.low1PctFps = 1e9 / (total / taken);
+    return s;
+}
+
 Metrics::Metrics() : p(new Impl) {}
-Metrics::~Metrics() = default;
+Metrics::~Metrics() { delete p; }
 
 void Metrics::framePresented() {
-    std::lock_guard<std::mutex> lk(p->m);
-    ++p->frames;
-    auto now = steady_clock::now();
-    double dt = duration_cast<duration<double>>(now - p->last).count();
-    if (dt >= 1.0) {
-        p->fps = p->frames / dt;
-        p->frames = 0;
-        p->last = now;
+    const int64_t now = nowNs();
+    const int64_t prev = p->lastPresent.exchange(now, std::memory_order_relaxed);
+    if (prev != 0 && now > prev)
+        p->hist[static_cast<int>(Stage::Count)][threadShard()].add(static_cast<uint64_t>(now - prev));
+
+    p->frames.fetch_add(1, std::memory_order_relaxed);
+    int64_t start = p->windowStart.load(std::memory_order_relaxed);
+    if (start == 0) {
+        p->windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed);
+        return;
     }
+    const double dt = (now - start) / 1e9;
+    if (dt >= 1.0 && p->windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed))
+        p->fps.store(p->frames.exchange(0, std::memory_order_relaxed) / dt, std::memory_order_relaxed);
 }
 
 double Metrics::getFPS() const {
-    std::lock_guard<std::mutex> lk(p->m);
-    return p->fps;
+    return p->fps.load(std::memory_order_relaxed);
+}
+
+void Metrics::record(Stage stage, uint64_t nanoseconds) {
+    const int which = static_cast<int>(stage);
+    if (which < 0 || which >= static_cast<int>(Stage::Count)) return;
+    p->hist[which][threadShard()].add(nanoseconds);
+}
+
+LatencyStats Metrics::stageStats(Stage stage) const {
+    const int which = static_cast<int>(stage);
+    if (which < 0 || which >= static_cast<int>(Stage::Count)) return {};
+    return p->stats(which);
+}
+
+LatencyStats Metrics::frameStats() const {
+    return p->stats(static_cast<int>(Stage::Count));
+}
+
+void Metrics::recordTiles(uint64_t total, uint64_t skipped, uint64_t neural) {
+    p->tilesTotal.fetch_add(total, std::memory_order_relaxed);
+    p->tilesSkipped.fetch_add(skipped, std::memory_order_relaxed);
+    p->tilesNeural.fetch_add(neural, std::memory_order_relaxed);
+}
+
+TileCounts Metrics::tileCounts() const {
+    TileCounts c;
+    c.total = p->tilesTotal.load(std::memory_order_relaxed);
+    c.skipped = p->tilesSkipped.load(std::memory_order_relaxed);
+    c.neural = p->tilesNeural.load(std::memory_order_relaxed);
+    return c;
+}
+
+void Metrics::reset() {
+    for (auto &shards : p->hist)
+        for (Histogram &h : shards) h.clear();
+    p->tilesTotal.store(0, std::memory_order_relaxed);
+    p->tilesSkipped.store(0, std::memory_order_relaxed);
+    p->tilesNeural.store(0, std::memory_order_relaxed);
+}
+
+Metrics &Metrics::shared() {
+    static Metrics metrics;
+    return metrics;
 }
@@ -1,12 +1,91 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
 
+// Pipeline stages that get their own latency histogram. Tiled stages record
+// the CPU time summed over their tiles, so on N cores a stage can exceed
+// the frame's wall time.
+enum class Stage {
+    Capture,
+    Easu,
+    Rcas,
+    Neural,
+    Compose,
+    Present,
+    Count
+};
+
+const char *stageName(Stage stage);
+
+// Percentiles of one histogram. Values are accurate to ~3% (HDR-style
+// log-linear buckets with 32 sub-buckets per power of two).
+struct LatencyStats {
+    uint64_t count = 0;
+    double meanMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+    double low1PctFps = 0.0;  // rate implied by the slowest 1% of samples
+};
+
+// Tiles seen by the CPU frame path, how many of them were skipped because
+// their input had not changed since the previous frame, and how many of
+// them HYBRID sent through the neural engine.
+struct TileCounts {
+    uint64_t total = 0;
+    uint64_t skipped = 0;
+    uint64_t neural = 0;
+};
+
+// Frame pacing and per-stage cost counters. Recording is wait-free: every
+// thread writes to its own shard with relaxed atomic increments, nothing
+// allocates or locks. Readers merge the shards on demand.
 class Metrics {
 public:
     Metrics();
     ~Metrics();
+
+    // Marks a present; the interval since the previous one feeds
+    // frameStats() and the one-second getFPS() average.
     void framePresented();
     double getFPS() const;
+
+    void record(Stage stage, uint64_t nanoseconds);
+
+    LatencyStats stageStats(Stage stage) const;
+    LatencyStats frameStats() const;
+
+    void recordTiles(uint64_t total, uint64_t skipped, uint64_t neural = 0);
+    TileCounts tileCounts() const;
+
+    // Clears all histograms and tile counts (not the FPS average), e.g. per
+    // benchmark run.
+    void reset();
+
+    // Process-wide instance the capture hooks and pipeline record into.
+    static Metrics &shared();
+
 private:
     struct Impl;
     Impl* p;
 };
+
+// Records the lifetime of the scope into `stage`.
+class StageTimer {
+public:
+    StageTimer(Metrics &m, Stage stage)
+        : m_(m), stage_(stage), start_(std::chrono::steady_clock::now()) {}
+    ~StageTimer() {
+        auto dt = std::chrono::steady_clock::now() - start_;
+        m_.record(stage_, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count()));
+    }
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+    Metrics &m_;
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,157 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Read-mostly map for state the present hooks look up on every frame but
+// that only changes when a swapchain is created or destroyed. Readers never
+// lock: they bump a reader counter, probe an immutable open-addressed table
+// and drop the counter again. Writers copy the table, publish the copy with
+// one atomic store and free the old one after a grace period in which every
+// reader that might still see it has left (RCU with two counter phases, so
+// a steady stream of new readers cannot hold a writer off).
+//
+// Values are owned by the map and never move. A value removed by insert()
+// or erase() is handed back only after the grace period, so the caller can
+// take it apart knowing no with() call is still inside it.
+template<typename K, typename V, typename Hash = std::hash<K>>
+class SnapshotMap {
+public:
+    SnapshotMap() : current_(new Table()) {
+        for (Counter &c : counters_) {
+            c.active[0].store(0, std::memory_order_relaxed);
+            c.active[1].store(0, std::memory_order_relaxed);
+        }
+    }
+    ~SnapshotMap() { delete current_.load(std::memory_order_relaxed); }
+
+    SnapshotMap(const SnapshotMap &) = delete;
+    SnapshotMap &operator=(const SnapshotMap &) = delete;
+
+    // Runs fn(V &) on the value for `key`; false if there is none. `fn`
+    // runs inside the read-side section, so a writer waits for it: keep it
+    // short. Calls for the same key from several threads are not
+    // serialised against each other.
+    template<typename Fn>
+    bool with(const K &key, Fn &&fn) const {
+        ReadSection section(*this);
+        V *value = current_.load(std::memory_order_seq_cst)->find(key, hash_);
+        if (!value) return false;
+        fn(*value);
+        return true;
+    }
+
+    // Adds or replaces the value for `key`; returns the replaced one.
+    std::unique_ptr<V> insert(const K &key, std::unique_ptr<V> value) {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        std::unique_ptr<V> &slot = owned_[key];
+        std::unique_ptr<V> old = std::move(slot);
+        slot = std::move(value);
+        publish();
+        return old;
+    }
+
+    // Removes the value for `key` and returns it (null if there was none).
+    std::unique_ptr<V> erase(const K &key) {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        auto it = owned_.find(key);
+        if (it == owned_.end()) return nullptr;
+        std::unique_ptr<V> old = std::move(it->second);
+        owned_.erase(it);
+        publish();
+        return old;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        return owned_.size();
+    }
+
+private:
+    static constexpr size_t kCounters = 16;
+
+    // Open addressing, at most half full; a null value marks a free slot.
+    struct Table {
+        std::vector<std::pair<K, V *>> slots;
+        size_t mask = 0;
+
+        V *find(const K &key, const Hash &hash) const {
+            if (slots.empty()) return nullptr;
+            for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+                const std::pair<K, V *> &s = slots[i];
+                if (!s.second) return nullptr;
+                if (s.first == key) return s.second;
+            }
+        }
+    };
+
+    // Readers of both phases, per group of threads. Threads hash onto the
+    // counters, so sharing one is fine; each sits on its own cache line.
+    struct alignas(64) Counter {
+        std::atomic<int64_t> active[2];
+    };
+
+    class ReadSection {
+    public:
+        explicit ReadSection(const SnapshotMap &map)
+            : counter_(map.counters_[threadSlot()].active[
+                  map.phase_.load(std::memory_order_relaxed) & 1]) {
+            counter_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        ~ReadSection() { counter_.fetch_sub(1, std::memory_order_release); }
+
+    private:
+        std::atomic<int64_t> &counter_;
+    };
+
+    static size_t threadSlot() {
+        static thread_local const size_t slot =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) % kCounters;
+        return slot;
+    }
+
+    // Called with writeMutex_ held.
+    void publish() {
+        Table *next = new Table();
+        size_t n = 2;
+        while (n < owned_.size() * 2) n <<= 1;
+        next->slots.assign(n, std::pair<K, V *>(K(), nullptr));
+        next->mask = n - 1;
+        for (const auto &kv : owned_) {
+            size_t i = hash_(kv.first) & next->mask;
+            while (next->slots[i].second) i = (i + 1) & next->mask;
+            next->slots[i] = {kv.first, kv.second.get()};
+        }
+        Table *old = current_.exchange(next, std::memory_order_seq_cst);
+        synchronize();
+        delete old;
+    }
+
+    // Waits until every reader that could have loaded the old table has
+    // left. A reader bumps its counter before loading the table, so one
+    // that still sees the old table is counted in one of the two phases;
+    // flipping first sends new readers to the other phase.
+    void synchronize() {
+        for (int flip = 0; flip < 2; ++flip) {
+            const unsigned old = phase_.fetch_add(1, std::memory_order_seq_cst) & 1;
+            for (const Counter &c : counters_)
+                while (c.active[old].load(std::memory_order_seq_cst) != 0)
+                    std::this_thread::yield();
+        }
+    }
+
+    std::atomic<Table *> current_;
+    std::atomic<unsigned> phase_{0};
+    mutable Counter counters_[kCounters];
+    Hash hash_;
+
+    mutable std::mutex writeMutex_;
+    std::unordered_map<K, std::unique_ptr<V>, Hash> owned_;
+};
@@ -0,0 +1,304 @@
+// telemetry.cpp - shared-memory stats channel for the dashboard
+#include "telemetry.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr uint32_t kMagic = 0x4f465431;  // "OFT1"
+constexpr uint32_t kVersion = 1;
+constexpr milliseconds kStatsInterval(250);
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "atomics in shared memory must not need a lock");
+
+// A seqlocked copy of T, stored as relaxed atomic words so a reader racing
+// the writer is well-defined; `seq` is odd while a write is in progress.
+template<typename T>
+struct SeqSlot {
+    static constexpr size_t kWords = (sizeof(T) + 3) / 4;
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint32_t> words[kWords];
+
+    void store(const T &value) {
+        uint32_t buf[kWords] = {};
+        std::memcpy(buf, &value, sizeof(T));
+        const uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i)
+            words[i].store(buf[i], std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    bool load(T &out) const {
+        for (int attempt = 0; attempt < 64; ++attempt) {
+            const uint32_t before = seq.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            uint32_t buf[kWords];
+            for (size_t i = 0; i < kWords; ++i)
+                buf[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) != before) continue;
+            if (before == 0) return false;  // never written
+            std::memcpy(&out, buf, sizeof(T));
+            return true;
+        }
+        return false;
+    }
+};
+
+// The segment. Both sides are built from this file, so the layout only has
+// to agree with itself; `version` guards against a stale dashboard.
+struct Block {
+    std::atomic<uint32_t> magic{0};  // set last, once the rest is ready
+    uint32_t version = kVersion;
+    uint32_t size = sizeof(Block);
+    uint32_t pid = 0;
+    alignas(64) std::atomic<uint64_t> frames{0};
+    alignas(64) SeqSlot<StatsSample> stats;
+    SeqSlot<FrameSample> ring[kTelemetryFrames];
+};
+
+std::string segmentName(uint32_t pid) {
+#ifdef _WIN32
+    return "Local\\omniforge-telemetry-" + std::to_string(pid);
+#else
+    return "/omniforge-telemetry-" + std::to_string(pid);
+#endif
+}
+
+uint32_t currentPid() {
+#ifdef _WIN32
+    return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+StatsSample collectStats() {
+    const Metrics &m = Metrics::shared();
+    StatsSample s;
+    s.timeNs = nowNs();
+    s.fps = m.getFPS();
+    s.frames = m.frameStats();
+    for (int i = 0; i < static_cast<int>(Stage::Count); ++i)
+        s.stages[i] = m.stageStats(static_cast<Stage>(i));
+    s.tiles = m.tileCounts();
+    return s;
+}
+
+} // namespace
+
+// --- Writer ------------------------------------------------------------------
+
+struct TelemetryWriter::Impl {
+    Block *block = nullptr;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+    std::string name;
+    std::thread publisher;
+    std::mutex stopMutex;
+    std::condition_variable stopCv;
+    bool stop = false;
+};
+
+TelemetryWriter::~TelemetryWriter() { close(); }
+
+TelemetryWriter &TelemetryWriter::shared() {
+    static TelemetryWriter writer;
+    return writer;
+}
+
+bool TelemetryWriter::open() {
+    std::lock_guard<std::mutex> guard(openMutex_);
+    if (p.load(std::memory_order_relaxed)) return true;
+    if (const char *env = std::getenv("OMNIFORGE_TELEMETRY"))
+        if (std::strcmp(env, "0") == 0) return false;
+
+    const uint32_t pid = currentPid();
+    const std::string name = segmentName(pid);
+    void *view = nullptr;
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+                                        PAGE_READWRITE, 0, sizeof(Block),
+                                        name.c_str());
+    if (!mapping) return false;
+    view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Block));
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+#else
+    // A segment left by an earlier process with the same pid is replaced.
+    const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC,
+                            0600);
+    if (fd < 0) return false;
+    if (ftruncate(fd, sizeof(Block)) == 0)
+        view = mmap(nullptr, sizeof(Block), PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0);
+    ::close(fd);  // the mapping keeps the segment
+    if (!view || view == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+#endif
+
+    Block *block = new (view) Block();
+    block->pid = pid;
+    block->magic.store(kMagic, std::memory_order_release);
+
+    Impl *impl = new Impl;
+    impl->block = block;
+    impl->name = name;
+#ifdef _WIN32
+    impl->mapping = mapping;
+#endif
+    // Merging the histograms is too slow for the present path, so a
+    // thread of its own republishes them.
+    impl->publisher = std::thread([impl] {
+        std::unique_lock<std::mutex> lock(impl->stopMutex);
+        while (!impl->stopCv.wait_for(lock, kStatsInterval,
+                                      [impl] { return impl->stop; }))
+            impl->block->stats.store(collectStats());
+    });
+    p.store(impl, std::memory_order_release);
+    return true;
+}
+
+void TelemetryWriter::close() {
+    std::lock_guard<std::mutex> guard(openMutex_);
+    Impl *impl = p.exchange(nullptr, std::memory_order_acq_rel);
+    if (!impl) return;
+    {
+        std::lock_guard<std::mutex> lock(impl->stopMutex);
+        impl->stop = true;
+    }
+    impl->stopCv.notify_all();
+    impl->publisher.join();
+#ifdef _WIN32
+    UnmapViewOfFile(impl->block);
+    CloseHandle(impl->mapping);
+#else
+    munmap(impl->block, sizeof(Block));
+    shm_unlink(impl->name.c_str());
+#endif
+    delete impl;
+}
+
+void TelemetryWriter::recordFrame(const FrameSample &sample) {
+    Impl *impl = p.load(std::memory_order_acquire);
+    if (!impl) return;
+    Block &b = *impl->block;
+    // Several presenting threads each claim their own slot.
+    const uint64_t n = b.frames.fetch_add(1, std::memory_order_relaxed);
+    FrameSample s = sample;
+    s.frame = n;
+    b.ring[n % kTelemetryFrames].store(s);
+}
+
+// --- Reader ------------------------------------------------------------------
+
+bool TelemetryReader::open(uint32_t pid) {
+    close();
+    const std::string name = segmentName(pid);
+    const void *view = nullptr;
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (!mapping) return false;
+    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(Block));
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    mapping_ = mapping;
+#else
+    const int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    void *v = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Block))
+        v = mmap(nullptr, sizeof(Block), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (v == MAP_FAILED) return false;
+    view = v;
+#endif
+    block_ = view;
+    const Block &b = *static_cast<const Block *>(block_);
+    if (b.magic.load(std::memory_order_acquire) != kMagic ||
+        b.version != kVersion || b.size != sizeof(Block)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TelemetryReader::close() {
+    if (!block_) return;
+#ifdef _WIN32
+    UnmapViewOfFile(block_);
+    CloseHandle(mapping_);
+    mapping_ = nullptr;
+#else
+    munmap(const_cast<void *>(block_), sizeof(Block));
+#endif
+    block_ = nullptr;
+}
+
+uint64_t TelemetryReader::frameCount() const {
+    if (!block_) return 0;
+    return static_cast<const Block *>(block_)->frames.load(std::memory_order_acquire);
+}
+
+size_t TelemetryReader::readFrames(uint64_t first, FrameSample *out,
+                                   size_t max) const {
+    if (!block_) return 0;
+    const Block &b = *static_cast<const Block *>(block_);
+    const uint64_t end = b.frames.load(std::memory_order_acquire);
+    uint64_t begin = end > kTelemetryFrames ? end - kTelemetryFrames : 0;
+    if (first > begin) begin = first;
+    size_t n = 0;
+    for (uint64_t i = begin; i < end && n < max; ++i) {
+        FrameSample s;
+        const bool ok = b.ring[i % kTelemetryFrames].load(s);
+        // Claimed but not written yet: stop, so the next poll picks it up.
+        if (!ok || s.frame < i) break;
+        // Already reused by a newer frame.
+        if (s.frame > i) continue;
+        out[n++] = s;
+    }
+    return n;
+}
+
+bool TelemetryReader::readStats(StatsSample &out) const {
+    if (!block_) return false;
+    return static_cast<const Block *>(block_)->stats.load(out);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "metrics.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Live stats from a hooked process to the dashboard (or omniforge_telemetry)
+// through a named shared-memory segment, one per process id: shm_open on
+// Linux (a memfd could not be found by pid), a pagefile-backed mapping on
+// Windows. The segment holds a ring of the last kTelemetryFrames frames and
+// the latest merge of the Metrics histograms. Every slot is a seqlock, so
+// the writer never waits for a reader and a reader simply retries a slot it
+// caught mid-write.
+
+constexpr size_t kTelemetryFrames = 1024;
+
+// One presented frame.
+struct FrameSample {
+    uint64_t frame = 0;      // running present count, set by recordFrame()
+    uint64_t timeNs = 0;     // steady_clock at present
+    float frameMs = 0.0f;    // present-to-present interval
+    float upscaleMs = 0.0f;  // the upscale thread's latest frame
+    float inputScale = 1.0f;
+    uint32_t mode = 0;       // UpscaleMode
+};
+
+// Metrics as of `timeNs`, republished a few times per second.
+struct StatsSample {
+    uint64_t timeNs = 0;
+    double fps = 0.0;
+    LatencyStats frames;
+    LatencyStats stages[static_cast<int>(Stage::Count)];
+    TileCounts tiles;
+};
+
+// Hook side. open() creates the segment and a thread that publishes
+// StatsSample every 250 ms; recordFrame() is wait-free (no syscall, no
+// lock) and does nothing until open() succeeded.
+class TelemetryWriter {
+public:
+    ~TelemetryWriter();
+
+    // Creates this process's segment unless OMNIFORGE_TELEMETRY=0. Safe to
+    // call again; false if there is no segment.
+    bool open();
+    // Stops publishing and removes the segment name (readers keep theirs).
+    // Only once nothing can call recordFrame() any more.
+    void close();
+
+    void recordFrame(const FrameSample &sample);
+
+    static TelemetryWriter &shared();
+
+private:
+    TelemetryWriter() = default;
+    TelemetryWriter(const TelemetryWriter &) = delete;
+    TelemetryWriter &operator=(const TelemetryWriter &) = delete;
+
+    struct Impl;
+    std::atomic<Impl *> p{nullptr};
+    std::mutex openMutex_;
+};
+
+// Reader side: maps another process's segment read-only.
+class TelemetryReader {
+public:
+    TelemetryReader() = default;
+    ~TelemetryReader() { close(); }
+    TelemetryReader(const TelemetryReader &) = delete;
+    TelemetryReader &operator=(const TelemetryReader &) = delete;
+
+    // False if process `pid` has no segment (yet).
+    bool open(uint32_t pid);
+    void close();
+    bool isOpen() const { return block_ != nullptr; }
+
+    // Presents recorded by the writer so far.
+    uint64_t frameCount() const;
+    // Copies up to `max` frames with frame >= `first`, oldest first, and
+    // returns how many. Frames already overwritten are skipped; it stops
+    // before one that is still being written.
+    size_t readFrames(uint64_t first, FrameSample *out, size_t max) const;
+    // False until the writer has published once.
+    bool readStats(StatsSample &out) const;
+
+private:
+    const void *block_ = nullptr;
+#ifdef _WIN32
+    void *mapping_ = nullptr;
+#endif
+};
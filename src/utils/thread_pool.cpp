@@ -0,0 +1,208 @@
+// thread_pool.cpp - work-stealing pool used by the tiled CPU pipeline
+#include "thread_pool.h"
+#include "cpu_features.h"
+#include "trace.h"
+
+namespace {
+// Pool and queue index of the worker running on this thread; outside
+// callers share the last queue.
+thread_local const void *t_pool = nullptr;
+thread_local size_t t_worker = 0;
+// Pool and slot of the caller slot this thread holds inside run().
+thread_local const void *t_callerPool = nullptr;
+thread_local size_t t_callerSlot = 0;
+}
+
+struct ThreadPool::Batch {
+    TaskFn fn;
+    void *ctx;
+    std::atomic<size_t> remaining;
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+};
+
+// Bounded ring used as a deque: the owner pushes/pops at the tail, thieves
+// take from the head. Contention is limited to steals, so a plain mutex is
+// cheaper here than a lock-free deque would be to get right.
+struct alignas(64) ThreadPool::Queue {
+    static constexpr size_t kCapacity = 4096;
+    std::mutex m;
+    size_t head = 0;
+    size_t tail = 0;
+    Task tasks[kCapacity];
+
+    bool pushBack(const Task &t) {
+        if (tail - head == kCapacity) return false;
+        tasks[tail++ % kCapacity] = t;
+        return true;
+    }
+    bool popBack(Task &t) {
+        std::lock_guard<std::mutex> lk(m);
+        if (tail == head) return false;
+        t = tasks[--tail % kCapacity];
+        return true;
+    }
+    bool popFront(Task &t) {
+        std::lock_guard<std::mutex> lk(m);
+        if (tail == head) return false;
+        t = tasks[head++ % kCapacity];
+        return true;
+    }
+};
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = cpuFeatures().logicalCores;
+    const unsigned workers = threads > 1 ? threads - 1 : 0;
+    for (unsigned i = 0; i <= workers; ++i)
+        queues_.emplace_back(new Queue);
+    workers_.reserve(workers);
+    for (unsigned i = 0; i < workers; ++i)
+        workers_.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(sleepMutex_);
+        stop_ = true;
+    }
+    sleepCv_.notify_all();
+    for (auto &t : workers_) t.join();
+}
+
+unsigned ThreadPool::slot() const {
+    if (t_pool == this) return static_cast<unsigned>(t_worker);
+    if (t_callerPool == this) return static_cast<unsigned>(t_callerSlot);
+    return static_cast<unsigned>(workers_.size());
+}
+
+size_t ThreadPool::claimCallerSlot() {
+    std::unique_lock<std::mutex> lk(callerMutex_);
+    constexpr unsigned kAll = (1u << kCallerSlots) - 1;
+    callerCv_.wait(lk, [this] { return callersBusy_ != kAll; });
+    size_t i = 0;
+    while (callersBusy_ >> i & 1) ++i;
+    callersBusy_ |= 1u << i;
+    return workers_.size() + i;
+}
+
+void ThreadPool::releaseCallerSlot(size_t slot) {
+    {
+        std::lock_guard<std::mutex> lk(callerMutex_);
+        callersBusy_ &= ~(1u << (slot - workers_.size()));
+    }
+    callerCv_.notify_one();
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::run(size_t count, TaskFn fn, void *ctx) {
+    if (count == 0) return;
+
+    // A thread outside the pool holds a caller slot of its own until it
+    // returns, so slot() scratch is never shared between two callers. A
+    // nested call keeps the slot it has; one from inside another pool's
+    // task gets the outer slot back afterwards.
+    struct CallerSlot {
+        ThreadPool *pool = nullptr;
+        const void *outerPool = nullptr;
+        size_t outerSlot = 0;
+        ~CallerSlot() {
+            if (!pool) return;
+            pool->releaseCallerSlot(t_callerSlot);
+            t_callerPool = outerPool;
+            t_callerSlot = outerSlot;
+        }
+    } caller;
+    if (t_pool != this && t_callerPool != this) {
+        caller.outerPool = t_callerPool;
+        caller.outerSlot = t_callerSlot;
+        t_callerSlot = claimCallerSlot();
+        t_callerPool = this;
+        caller.pool = this;
+    }
+
+    if (workers_.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) fn(ctx, i);
+        return;
+    }
+
+    Batch batch;
+    batch.fn = fn;
+    batch.ctx = ctx;
+    // Held at count + 1 until everything is queued, so workers cannot
+    // complete the batch while the caller still touches it.
+    batch.remaining.store(count + 1, std::memory_order_relaxed);
+
+    const size_t home = t_pool == this ? t_worker : workers_.size();
+    const size_t nq = queues_.size();
+    // Contiguous blocks per queue, starting with our own so the caller
+    // begins on the first tiles.
+    for (size_t k = 0; k < nq; ++k) {
+        Queue &q = *queues_[(home + k) % nq];
+        const size_t begin = count * k / nq;
+        const size_t end = count * (k + 1) / nq;
+        size_t i = end;
+        {
+            std::lock_guard<std::mutex> lk(q.m);
+            // Reversed so LIFO pops by the owner walk the block forwards.
+            for (; i > begin && q.pushBack({&batch, i - 1}); --i) {}
+            queued_.fetch_add(end - i, std::memory_order_release);
+        }
+        // A full queue only happens with thousands of pending tiles; run
+        // what did not fit right here.
+        for (size_t j = begin; j < i; ++j) {
+            fn(ctx, j);
+            batch.remaining.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    {
+        // Pairs with the predicate check in workerLoop so a worker that is
+        // about to sleep cannot miss this wake-up.
+        std::lock_guard<std::mutex> lk(sleepMutex_);
+    }
+    sleepCv_.notify_all();
+
+    finish(&batch);
+    while (runOne(home)) {}
+    std::unique_lock<std::mutex> lk(batch.m);
+    batch.cv.wait(lk, [&] { return batch.done; });
+}
+
+bool ThreadPool::runOne(size_t home) {
+    Task t;
+    bool found = queues_[home]->popBack(t);
+    for (size_t k = 1; !found && k < queues_.size(); ++k)
+        found = queues_[(home + k) % queues_.size()]->popFront(t);
+    if (!found) return false;
+
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    t.batch->fn(t.batch->ctx, t.index);
+    finish(t.batch);
+    return true;
+}
+
+void ThreadPool::finish(Batch *b) {
+    if (b->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lk(b->m);
+        b->done = true;
+        b->cv.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    t_pool = this;
+    t_worker = index;
+    Tracer::setThreadName("pool");
+    for (;;) {
+        if (runOne(index)) continue;
+        std::unique_lock<std::mutex> lk(sleepMutex_);
+        sleepCv_.wait(lk, [this] {
+            return stop_ || queued_.load(std::memory_order_acquire) > 0;
+        });
+        if (stop_) return;
+    }
+}
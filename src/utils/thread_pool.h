@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing pool for data-parallel frame work (tiles, rows).
+// Every worker owns a bounded deque: it pops its own tasks LIFO and steals
+// FIFO from the others once it runs dry. parallelFor() hands each worker a
+// contiguous block of indices, so neighbouring tiles share a core until the
+// load evens out, and the calling thread helps until its batch is done.
+// Nothing on the submit/run path allocates.
+class ThreadPool {
+public:
+    // `threads` is the total concurrency including the calling thread;
+    // 0 means one per logical core.
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Threads outside the pool that can be inside parallelFor() at once
+    // without waiting for each other.
+    static constexpr unsigned kCallerSlots = 4;
+
+    unsigned concurrency() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+    // Number of distinct slot() values; size per-thread scratch by this.
+    unsigned slots() const { return static_cast<unsigned>(workers_.size()) + kCallerSlots; }
+
+    // Index of the calling thread in [0, slots()): workers get the low
+    // slots, and a thread outside the pool holds one of the caller slots
+    // above them for as long as it is inside parallelFor(), so concurrent
+    // callers never share one (a caller beyond kCallerSlots waits for a
+    // free slot). Lets callers keep per-thread scratch in a flat array
+    // instead of thread_locals. Outside parallelFor() a non-pool thread
+    // gets the first caller slot, which it must not use for scratch.
+    unsigned slot() const;
+
+    // Runs fn(i) for every i in [0, count) and returns when all have finished.
+    template<typename Fn>
+    void parallelFor(size_t count, Fn &&fn) {
+        using F = std::remove_reference_t<Fn>;
+        run(count, [](void *ctx, size_t i) { (*static_cast<F *>(ctx))(i); },
+            const_cast<void *>(static_cast<const void *>(&fn)));
+    }
+
+    // Process-wide pool sized to the machine, created on first use.
+    static ThreadPool &shared();
+
+private:
+    using TaskFn = void (*)(void *, size_t);
+    struct Batch;
+    struct Task {
+        Batch *batch;
+        size_t index;
+    };
+    struct Queue;
+
+    void run(size_t count, TaskFn fn, void *ctx);
+    size_t claimCallerSlot();
+    void releaseCallerSlot(size_t slot);
+    bool runOne(size_t home);
+    static void finish(Batch *b);
+    void workerLoop(size_t index);
+
+    std::vector<std::unique_ptr<Queue>> queues_;  // one per worker + one for outside callers
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> queued_{0};
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCv_;
+    bool stop_ = false;
+
+    std::mutex callerMutex_;
+    std::condition_variable callerCv_;
+    unsigned callersBusy_ = 0;  // bit i: caller slot workers + i is taken
+};
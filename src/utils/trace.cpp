@@ -0,0 +1,256 @@
+// trace.cpp - per-thread span rings and Chrome trace JSON export
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+static_assert((Tracer::kRingEvents & (Tracer::kRingEvents - 1)) == 0,
+              "ring index is masked");
+
+// Fields are relaxed atomics so a flush can read a slot the owner is
+// overwriting; the ring's counters tell it which copies to throw away.
+struct Event {
+    std::atomic<const char *> name;
+    std::atomic<uint64_t> begin;
+    std::atomic<uint64_t> end;
+};
+
+// One thread's spans. Only the owning thread writes; `claimed` moves before
+// a slot is touched and `written` after, like a seqlock.
+struct Ring {
+    std::atomic<uint64_t> claimed{0};
+    std::atomic<uint64_t> written{0};
+    Event events[Tracer::kRingEvents];
+    // Guarded by the registry mutex.
+    uint32_t tid = 0;
+    const char *threadName = nullptr;
+    bool inUse = false;
+};
+
+struct Span {
+    uint32_t tid;
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+struct Snapshot {
+    std::vector<Span> spans;
+    std::vector<std::pair<uint32_t, const char *>> threads;
+    uint64_t origin = 0;       // ticks at tracer start
+    double ticksPerUs = 1.0;
+};
+
+// The calling thread's ring, handed back for reuse when the thread exits.
+struct RingOwner {
+    Ring *ring = nullptr;
+    const char *name = nullptr;
+    ~RingOwner();
+};
+
+thread_local RingOwner t_owner;
+
+// Finished threads keep their ring, and so their spans, until this many
+// rings exist; after that a new thread takes one over.
+constexpr size_t kMaxRings = 64;
+
+// Every ring ever handed out. Never freed: pool threads may still finish a
+// span during static destruction.
+struct Registry {
+    std::mutex mutex;
+    std::vector<Ring *> rings;
+    uint32_t nextTid = 1;
+
+    Ring *acquire();
+    void collect(Snapshot &snap);
+};
+
+Registry &registry() {
+    static Registry *r = new Registry();
+    return *r;
+}
+
+RingOwner::~RingOwner() {
+    if (!ring) return;
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring->inUse = false;
+}
+
+Ring *Registry::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Ring *ring = nullptr;
+    if (rings.size() >= kMaxRings) {
+        for (Ring *r : rings) {
+            if (!r->inUse) {
+                ring = r;
+                break;
+            }
+        }
+    }
+    if (ring) {
+        // Its old spans would show up under the new thread id.
+        ring->claimed.store(0, std::memory_order_relaxed);
+        ring->written.store(0, std::memory_order_relaxed);
+    } else {
+        ring = new Ring();
+        rings.push_back(ring);
+    }
+    ring->tid = nextTid++;
+    ring->threadName = t_owner.name;
+    ring->inUse = true;
+    return ring;
+}
+
+void Registry::collect(Snapshot &snap) {
+    constexpr uint64_t kEvents = Tracer::kRingEvents;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Ring *r : rings) {
+        const uint64_t end = r->written.load(std::memory_order_acquire);
+        const uint64_t begin = end > kEvents ? end - kEvents : 0;
+        const size_t first = snap.spans.size();
+        for (uint64_t i = begin; i < end; ++i) {
+            const Event &e = r->events[i & (kEvents - 1)];
+            snap.spans.push_back({r->tid, e.name.load(std::memory_order_relaxed),
+                                  e.begin.load(std::memory_order_relaxed),
+                                  e.end.load(std::memory_order_relaxed)});
+        }
+        // Slots the owner started to reuse while we copied are torn.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t claimed = r->claimed.load(std::memory_order_relaxed);
+        const uint64_t stale = claimed > kEvents ? claimed - kEvents : 0;
+        if (stale > begin) {
+            const size_t torn = static_cast<size_t>(std::min(stale, end) - begin);
+            snap.spans.erase(snap.spans.begin() + first,
+                             snap.spans.begin() + first + torn);
+        }
+        if (end > 0 || r->threadName)
+            snap.threads.emplace_back(r->tid, r->threadName ? r->threadName : "thread");
+    }
+}
+
+void writeEscaped(std::FILE *f, const char *s) {
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') std::fputc('\\', f);
+        if (static_cast<unsigned char>(*s) >= 0x20) std::fputc(*s, f);
+    }
+}
+
+bool writeChromeJson(const std::string &path, const Snapshot &snap) {
+    std::FILE *f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    std::fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"args\":{\"name\":\"omniforge\"}}", f);
+    for (const auto &t : snap.threads) {
+        std::fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                        "\"tid\":%u,\"args\":{\"name\":\"", t.first);
+        writeEscaped(f, t.second);
+        std::fputs("\"}}", f);
+    }
+    for (const Span &s : snap.spans) {
+        const double ts = static_cast<double>(s.begin - snap.origin) / snap.ticksPerUs;
+        const double dur = static_cast<double>(s.end - s.begin) / snap.ticksPerUs;
+        std::fputs(",\n{\"name\":\"", f);
+        writeEscaped(f, s.name);
+        std::fprintf(f, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                        "\"ts\":%.3f,\"dur\":%.3f}", s.tid, ts, dur);
+    }
+    std::fputs("\n]}\n", f);
+    const bool ok = std::ferror(f) == 0;
+    return std::fclose(f) == 0 && ok;
+}
+
+} // namespace
+
+struct Tracer::Impl {
+    std::mutex flushMutex;
+    std::thread writer;
+    std::string defaultPath;
+
+    // Reference points for turning ticks into microseconds.
+    uint64_t originTicks = Tracer::now();
+    steady_clock::time_point originTime = steady_clock::now();
+
+    Snapshot snapshot();
+};
+
+Snapshot Tracer::Impl::snapshot() {
+    Snapshot snap;
+    registry().collect(snap);
+
+    // Tick rate over the whole run; a very short one is stretched so the
+    // estimate is not dominated by the clock reads themselves.
+    steady_clock::time_point nowTime = steady_clock::now();
+    if (nowTime - originTime < milliseconds(10)) {
+        std::this_thread::sleep_until(originTime + milliseconds(10));
+        nowTime = steady_clock::now();
+    }
+    const uint64_t nowTicks = Tracer::now();
+    const double us = duration<double, std::micro>(nowTime - originTime).count();
+    snap.origin = originTicks;
+    snap.ticksPerUs = static_cast<double>(nowTicks - originTicks) / us;
+    return snap;
+}
+
+Tracer::Tracer() : p(new Impl) {
+    if (const char *env = std::getenv("OMNIFORGE_TRACE")) {
+        p->defaultPath = env;
+        enabled_.store(!p->defaultPath.empty(), std::memory_order_relaxed);
+    }
+    // A flush still writing at exit gets to finish its file.
+    std::atexit([] { Tracer::shared().waitFlushed(); });
+}
+
+// Never destroyed, like the Registry: pool threads may still finish a span
+// during static destruction, and every TraceScope asks enabled().
+Tracer &Tracer::shared() {
+    static Tracer *tracer = new Tracer();
+    return *tracer;
+}
+
+void Tracer::span(const char *name, uint64_t begin, uint64_t end) {
+    Ring *ring = t_owner.ring;
+    if (!ring) ring = t_owner.ring = registry().acquire();
+    const uint64_t i = ring->written.load(std::memory_order_relaxed);
+    ring->claimed.store(i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Event &e = ring->events[i & (kRingEvents - 1)];
+    e.name.store(name, std::memory_order_relaxed);
+    e.begin.store(begin, std::memory_order_relaxed);
+    e.end.store(end, std::memory_order_relaxed);
+    ring->written.store(i + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char *name) {
+    t_owner.name = name;
+    if (t_owner.ring) {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        t_owner.ring->threadName = name;
+    }
+}
+
+bool Tracer::flushAsync(const std::string &path) {
+    std::lock_guard<std::mutex> lock(p->flushMutex);
+    const std::string target = path.empty() ? p->defaultPath : path;
+    if (target.empty()) return false;
+    if (p->writer.joinable()) p->writer.join();
+    p->writer = std::thread([target, snap = p->snapshot()] {
+        if (!writeChromeJson(target, snap))
+            std::fprintf(stderr, "trace: cannot write %s\n", target.c_str());
+    });
+    return true;
+}
+
+void Tracer::waitFlushed() {
+    std::lock_guard<std::mutex> lock(p->flushMutex);
+    if (p->writer.joinable()) p->writer.join();
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define OMNIFORGE_TRACE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define OMNIFORGE_TRACE_TSC 1
+#else
+#include <chrono>
+#endif
+
+// In-process span tracer for finding where a frame's time went. Each thread
+// appends finished spans to its own fixed ring (the last kRingEvents per
+// thread survive), so recording a span costs two timestamp reads and a few
+// plain stores: no locks, no allocation after the thread's first span.
+// flushAsync() snapshots the rings and writes them as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev) on a background thread.
+//
+// Off unless OMNIFORGE_TRACE names an output file or setEnabled(true) is
+// called; while off a scope costs one relaxed load. Defining
+// OMNIFORGE_NO_TRACE compiles the scopes out entirely.
+class Tracer {
+public:
+    static constexpr size_t kRingEvents = 16384;
+
+    // Timestamps are raw TSC ticks on x86 (assumed invariant, as on every
+    // CPU this runs on) and steady_clock nanoseconds elsewhere.
+    static uint64_t now() {
+#ifdef OMNIFORGE_TRACE_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(
+            std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void setEnabled(bool on) { enabled_.store(on, std::memory_order_relaxed); }
+
+    // Records a span on the calling thread. `name` must outlive the tracer
+    // (a string literal or stageName()).
+    void span(const char *name, uint64_t begin, uint64_t end);
+
+    // Label for the calling thread in the trace; same lifetime as `name`.
+    static void setThreadName(const char *name);
+
+    // Snapshots every thread's spans and writes them to `path` (default:
+    // OMNIFORGE_TRACE) without waiting for the file. A flush still writing
+    // is finished first. False if there is nowhere to write.
+    bool flushAsync(const std::string &path = std::string());
+    // Waits for the last flushAsync() to finish writing.
+    void waitFlushed();
+
+    // Process-wide tracer the scopes record into.
+    static Tracer &shared();
+
+private:
+    Tracer();
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    struct Impl;
+    Impl *p;
+    std::atomic<bool> enabled_{false};
+};
+
+// Records the lifetime of the scope as a span named `name`.
+class TraceScope {
+public:
+    explicit TraceScope(const char *name)
+        : name_(Tracer::shared().enabled() ? name : nullptr),
+          begin_(name_ ? Tracer::now() : 0) {}
+    ~TraceScope() {
+        if (name_) Tracer::shared().span(name_, begin_, Tracer::now());
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name_;
+    uint64_t begin_;
+};
+
+#define OMNIFORGE_TRACE_CONCAT2(a, b) a##b
+#define OMNIFORGE_TRACE_CONCAT(a, b) OMNIFORGE_TRACE_CONCAT2(a, b)
+#ifdef OMNIFORGE_NO_TRACE
+#define OMNIFORGE_TRACE_SCOPE(name) ((void)0)
+#else
+#define OMNIFORGE_TRACE_SCOPE(name)                                           \
+    TraceScope OMNIFORGE_TRACE_CONCAT(traceScope_, __LINE__)(name)
+#endif
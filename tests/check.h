@@ -0,0 +1,27 @@
+#pragma once
+// check.h
+// Minimal assertions for the unit tests. Each test is a plain executable:
+// failed checks are printed and make main() return nonzero.
+
+#include <cstdio>
+
+inline int &checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,    \
+                         __LINE__, #cond);                                 \
+            ++checkFailures();                                             \
+        }                                                                  \
+    } while (0)
+
+// main()'s return value.
+inline int checkResult() {
+    if (checkFailures())
+        std::fprintf(stderr, "%d check(s) failed\n", checkFailures());
+    return checkFailures() ? 1 : 0;
+}
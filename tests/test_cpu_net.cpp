@@ -0,0 +1,338 @@
+// test_cpu_net.cpp
+// CpuNet against a double-precision reference: a small cunet-shaped model
+// (strided and 1x1 convolutions, fused activations, a squeeze-excitation
+// block, deconvolutions, Split/Crop/Eltwise/BinaryOp) with weights in each
+// encoding the loader reads. Registered once per OMNIFORGE_CPU_ISA level,
+// so every kernel build the host runs is covered.
+
+#include "check.h"
+#include "engines/cpu_net.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Planar c x h x w.
+struct Tensor {
+    std::vector<double> d;
+    int w = 0, h = 0, c = 0;
+
+    Tensor(int w_, int h_, int c_, double fill = 0.0)
+        : d(size_t(w_) * h_ * c_, fill), w(w_), h(h_), c(c_) {}
+    double &at(int ch, int y, int x) {
+        return d[(size_t(ch) * h + y) * w + x];
+    }
+    double at(int ch, int y, int x) const {
+        return d[(size_t(ch) * h + y) * w + x];
+    }
+};
+
+enum class Encoding { Float, Half, TaggedFloat, Table };
+enum class Act { None, ReLU, Leaky, Sigmoid };
+
+struct Weights {
+    std::vector<float> w, b;
+};
+
+double activate(double v, Act act) {
+    switch (act) {
+    case Act::ReLU:
+        return std::max(v, 0.0);
+    case Act::Leaky:
+        return v < 0 ? v * 0.1 : v;
+    case Act::Sigmoid:
+        return 1.0 / (1.0 + std::exp(-v));
+    case Act::None:
+        break;
+    }
+    return v;
+}
+
+// Exact for the multiples of 2^-10 the Half encoding writes.
+uint16_t toHalf(float v) {
+    uint32_t bits;
+    std::memcpy(&bits, &v, 4);
+    const uint16_t sign = static_cast<uint16_t>(bits >> 16 & 0x8000);
+    if (v == 0.0f)
+        return sign;
+    const int exponent = int(bits >> 23 & 0xff) - 112;
+    const uint32_t mantissa = bits & 0x7fffff;
+    if (exponent <= 0)
+        return static_cast<uint16_t>(sign |
+                                     ((mantissa | 0x800000) >> (14 - exponent)));
+    return static_cast<uint16_t>(sign | exponent << 10 | mantissa >> 13);
+}
+
+class ModelWriter {
+public:
+    explicit ModelWriter(const char *bin) : bin_(std::fopen(bin, "wb")) {}
+    ~ModelWriter() { close(); }
+    explicit operator bool() const { return bin_ != nullptr; }
+
+    void close() {
+        if (bin_)
+            std::fclose(bin_);
+        bin_ = nullptr;
+    }
+
+    // Writes nw weights and nb biases as ncnn stores them, and returns the
+    // values the loader should end up with.
+    Weights write(size_t nw, size_t nb, Encoding enc, float scale) {
+        std::uniform_real_distribution<float> uniform(-scale, scale);
+        Weights r;
+        r.w.resize(nw);
+        r.b.resize(nb);
+        const uint32_t tag = enc == Encoding::Half          ? 0x01306B47u
+                             : enc == Encoding::TaggedFloat ? 0x0002C056u
+                             : enc == Encoding::Table       ? 0x11223344u
+                                                            : 0u;
+        std::fwrite(&tag, 4, 1, bin_);
+        switch (enc) {
+        case Encoding::Half:
+            for (float &v : r.w) {
+                v = std::round(uniform(rng_) * 1024.0f) / 1024.0f;
+                const uint16_t h = toHalf(v);
+                std::fwrite(&h, 2, 1, bin_);
+            }
+            pad(nw * 2);
+            break;
+        case Encoding::Table: {
+            float table[256];
+            for (int i = 0; i < 256; ++i)
+                table[i] = float(i - 128) * scale / 128.0f;
+            std::fwrite(table, 4, 256, bin_);
+            for (float &v : r.w) {
+                const uint8_t i = static_cast<uint8_t>(rng_() & 0xff);
+                v = table[i];
+                std::fwrite(&i, 1, 1, bin_);
+            }
+            pad(nw);
+            break;
+        }
+        case Encoding::Float:
+        case Encoding::TaggedFloat:
+            for (float &v : r.w)
+                v = uniform(rng_);
+            std::fwrite(r.w.data(), 4, nw, bin_);
+            break;
+        }
+        for (float &v : r.b)
+            v = uniform(rng_) * 0.5f;
+        std::fwrite(r.b.data(), 4, nb, bin_);
+        return r;
+    }
+
+private:
+    // Quantised weights are padded to 4 bytes.
+    void pad(size_t bytes) {
+        const uint8_t zero[4] = {};
+        std::fwrite(zero, 1, (4 - bytes % 4) % 4, bin_);
+    }
+
+    std::FILE *bin_;
+    std::mt19937 rng_{7};
+};
+
+Tensor conv(const Tensor &in, const Weights &wt, int outC, int k, int stride,
+            int pad, Act act) {
+    Tensor p(in.w + 2 * pad, in.h + 2 * pad, in.c);
+    for (int c = 0; c < in.c; ++c)
+        for (int y = 0; y < in.h; ++y)
+            for (int x = 0; x < in.w; ++x)
+                p.at(c, y + pad, x + pad) = in.at(c, y, x);
+    Tensor o((p.w - k) / stride + 1, (p.h - k) / stride + 1, outC);
+    for (int m = 0; m < outC; ++m) {
+        for (int y = 0; y < o.h; ++y) {
+            for (int x = 0; x < o.w; ++x) {
+                double acc = wt.b[m];
+                for (int c = 0; c < in.c; ++c)
+                    for (int ky = 0; ky < k; ++ky)
+                        for (int kx = 0; kx < k; ++kx)
+                            acc += p.at(c, y * stride + ky, x * stride + kx) *
+                                   wt.w[((size_t(m) * in.c + c) * k + ky) * k +
+                                        kx];
+                o.at(m, y, x) = activate(acc, act);
+            }
+        }
+    }
+    return o;
+}
+
+// Full transposed convolution, then `pad` cropped from every side.
+Tensor deconv(const Tensor &in, const Weights &wt, int outC, int k,
+              int stride, int pad, Act act) {
+    Tensor full((in.w - 1) * stride + k, (in.h - 1) * stride + k, outC);
+    for (int m = 0; m < outC; ++m) {
+        std::fill(full.d.begin() + ptrdiff_t(m) * full.w * full.h,
+                  full.d.begin() + ptrdiff_t(m + 1) * full.w * full.h,
+                  double(wt.b[m]));
+        for (int c = 0; c < in.c; ++c)
+            for (int y = 0; y < in.h; ++y)
+                for (int x = 0; x < in.w; ++x)
+                    for (int ky = 0; ky < k; ++ky)
+                        for (int kx = 0; kx < k; ++kx)
+                            full.at(m, y * stride + ky, x * stride + kx) +=
+                                in.at(c, y, x) *
+                                wt.w[((size_t(m) * in.c + c) * k + ky) * k +
+                                     kx];
+    }
+    Tensor o(full.w - 2 * pad, full.h - 2 * pad, outC);
+    for (int m = 0; m < outC; ++m)
+        for (int y = 0; y < o.h; ++y)
+            for (int x = 0; x < o.w; ++x)
+                o.at(m, y, x) = activate(full.at(m, y + pad, x + pad), act);
+    return o;
+}
+
+Tensor crop(const Tensor &in, int x0, int y0, int w, int h) {
+    Tensor o(w, h, in.c);
+    for (int c = 0; c < in.c; ++c)
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                o.at(c, y, x) = in.at(c, y + y0, x + x0);
+    return o;
+}
+
+// Largest difference between `blob` and `ref`, relative to max(1, |ref|).
+double maxError(const BlobView &blob, const Tensor &ref) {
+    double worst = 0.0, peak = 1.0;
+    for (int c = 0; c < ref.c; ++c) {
+        for (int y = 0; y < ref.h; ++y) {
+            for (int x = 0; x < ref.w; ++x) {
+                const double r = ref.at(c, y, x);
+                const float v =
+                    blob.at(c / blob.lanes, y, x)[c % blob.lanes];
+                worst = std::max(worst, std::fabs(v - r));
+                peak = std::max(peak, std::fabs(r));
+            }
+        }
+    }
+    return worst / peak;
+}
+
+} // namespace
+
+int main() {
+    constexpr int S = 40;
+    // Per ISA level, as ctest may run the variants side by side.
+    const char *isa = std::getenv("OMNIFORGE_CPU_ISA");
+    const std::string base =
+        std::string("test_cpu_net_") + (isa ? isa : "native");
+    const std::string paramPath = base + ".param", binPath = base + ".bin";
+
+    std::FILE *param = std::fopen(paramPath.c_str(), "w");
+    ModelWriter bin(binPath.c_str());
+    CHECK(param && bin);
+    if (!param || !bin)
+        return checkResult();
+
+    std::fprintf(param, "7767517\n19 21\n");
+    std::fprintf(param, "Input in 0 1 in 0=%d 1=%d 2=3\n", S, S);
+    std::fprintf(param, "Convolution conv1 1 1 in c1 0=32 1=3 5=1 6=864 "
+                        "9=2 -23310=1,1.000000e-01\n");
+    const Weights w1 = bin.write(864, 32, Encoding::Half, 0.5f);
+    std::fprintf(param,
+                 "Convolution conv2 1 1 c1 c2 0=64 1=3 5=1 6=18432\n");
+    const Weights w2 = bin.write(18432, 64, Encoding::Float, 0.1f);
+    std::fprintf(param, "ReLU relu2 1 1 c2 r2 0=1.000000e-01\n");
+    std::fprintf(param, "Split split1 1 2 r2 s1 s2\n");
+    std::fprintf(param, "Convolution down 1 1 s1 d 0=64 1=2 3=2 5=1 "
+                        "6=16384 9=2 -23310=1,0.1\n");
+    const Weights wd = bin.write(16384, 64, Encoding::TaggedFloat, 0.1f);
+    std::fprintf(param, "Convolution conv3 1 1 d c3 0=128 1=3 5=1 6=73728 "
+                        "9=2 -23310=1,0.1\n");
+    const Weights w3 = bin.write(73728, 128, Encoding::Table, 0.05f);
+    std::fprintf(param, "Split split2 1 2 c3 c3a c3b\n");
+    std::fprintf(param, "Pooling gap 1 1 c3a g 0=1 4=1\n");
+    std::fprintf(param,
+                 "Convolution se1 1 1 g e1 0=16 1=1 5=1 6=2048 9=1\n");
+    const Weights we1 = bin.write(2048, 16, Encoding::Float, 0.2f);
+    std::fprintf(param, "Convolution se2 1 1 e1 e2 0=128 1=1 5=1 6=2048\n");
+    const Weights we2 = bin.write(2048, 128, Encoding::Float, 0.2f);
+    std::fprintf(param, "Sigmoid sig 1 1 e2 sg\n");
+    std::fprintf(param, "BinaryOp mul 2 1 c3b sg m 0=2\n");
+    std::fprintf(param, "Deconvolution up 1 1 m u 0=64 1=2 3=2 5=1 "
+                        "6=32768 9=2 -23310=1,0.1\n");
+    const Weights wu = bin.write(32768, 64, Encoding::Float, 0.05f);
+    std::fprintf(param, "Crop crop1 2 1 s2 u cr 0=2 1=2\n");
+    std::fprintf(param, "Eltwise add 2 1 cr u a 0=1\n");
+    std::fprintf(param, "Convolution conv4 1 1 a c4 0=64 1=3 4=1 5=1 "
+                        "6=36864 9=2 -23310=1,0.1\n");
+    const Weights w4 = bin.write(36864, 64, Encoding::Float, 0.05f);
+    std::fprintf(param, "Deconvolution out 1 1 c4 o 0=3 1=4 3=2 4=3 5=1 "
+                        "6=3072\n");
+    const Weights wo = bin.write(3072, 3, Encoding::Float, 0.05f);
+    std::fprintf(param, "Crop crop2 1 1 o out 0=5 1=5 6=5 7=5\n");
+    std::fclose(param);
+    bin.close();
+
+    // The same graph in doubles.
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    Tensor in(S, S, 3);
+    for (double &v : in.d)
+        v = uniform(rng);
+    const Tensor c1 = conv(in, w1, 32, 3, 1, 0, Act::Leaky);
+    const Tensor r2 = conv(c1, w2, 64, 3, 1, 0, Act::Leaky);
+    const Tensor d = conv(r2, wd, 64, 2, 2, 0, Act::Leaky);
+    const Tensor c3 = conv(d, w3, 128, 3, 1, 0, Act::Leaky);
+    Tensor g(1, 1, 128);
+    for (int c = 0; c < 128; ++c) {
+        double sum = 0.0;
+        for (int y = 0; y < c3.h; ++y)
+            for (int x = 0; x < c3.w; ++x)
+                sum += c3.at(c, y, x);
+        g.at(c, 0, 0) = sum / (c3.w * c3.h);
+    }
+    const Tensor e1 = conv(g, we1, 16, 1, 1, 0, Act::ReLU);
+    const Tensor e2 = conv(e1, we2, 128, 1, 1, 0, Act::Sigmoid);
+    Tensor m = c3;
+    for (int c = 0; c < 128; ++c)
+        for (int y = 0; y < m.h; ++y)
+            for (int x = 0; x < m.w; ++x)
+                m.at(c, y, x) *= e2.at(c, 0, 0);
+    const Tensor u = deconv(m, wu, 64, 2, 2, 0, Act::Leaky);
+    Tensor a = crop(r2, 2, 2, u.w, u.h);
+    for (size_t i = 0; i < a.d.size(); ++i)
+        a.d[i] += u.d[i];
+    const Tensor c4 = conv(a, w4, 64, 3, 1, 1, Act::Leaky);
+    const Tensor o = deconv(c4, wo, 3, 4, 2, 3, Act::None);
+    const Tensor ref = crop(o, 5, 5, o.w - 10, o.h - 10);
+
+    CpuNet net;
+    CHECK(net.load(paramPath, binPath));
+    std::remove(paramPath.c_str());
+    std::remove(binPath.c_str());
+
+    NetBlob input;
+    CHECK(input.create(S, S, 3));
+    const BlobView &iv = input.view();
+    for (int y = 0; y < S; ++y)
+        for (int x = 0; x < S; ++x)
+            for (int l = 0; l < iv.lanes; ++l)
+                iv.at(0, y, x)[l] = l < 3 ? float(in.at(l, y, x)) : 0.0f;
+
+    std::printf("kernels: %s\n", convIsa().name);
+    NetBlob output;
+    CHECK(net.run("in", iv, "out", output));
+    const BlobView &ov = output.view();
+    CHECK(ov.w == ref.w && ov.h == ref.h && ov.c == 3);
+    if (ov.w == ref.w && ov.h == ref.h && ov.c == 3)
+        CHECK(maxError(ov, ref) < 1e-4);
+
+    // An intermediate blob, which a fused activation also publishes.
+    NetBlob mid;
+    CHECK(net.run("in", iv, "c3", mid));
+    CHECK(mid.view().w == c3.w && mid.view().c == 128);
+    if (mid.view().w == c3.w && mid.view().c == 128)
+        CHECK(maxError(mid.view(), c3) < 1e-4);
+
+    CHECK(!net.run("in", iv, "no_such_blob", output));
+    return checkResult();
+}
@@ -0,0 +1,141 @@
+// test_frame_pool.cpp
+// FramePool: alignment, recycling by shape, the cache budget and trim(),
+// eviction under contention, and a shared-pool buffer released during
+// static destruction.
+
+#include "check.h"
+#include "utils/frame_pool.h"
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Like the swapchain table: a file-scope static that still holds a shared
+// pool buffer when static destructors run.
+struct Parked {
+    FramePool::Handle frame;
+} g_parked;
+
+bool aligned(const void *p) {
+    return reinterpret_cast<uintptr_t>(p) % 64 == 0;
+}
+
+FramePool::Shape shape(int w, int h, int bpp, uint32_t format) {
+    FramePool::Shape s;
+    s.width = w;
+    s.height = h;
+    s.bytesPerPixel = bpp;
+    s.format = format;
+    return s;
+}
+
+void testAlignment() {
+    FramePool pool;
+    FramePool::Handle h = pool.acquire(shape(33, 7, 3, 0));
+    CHECK(h);
+    CHECK(aligned(h.data()));
+    CHECK(h.stride() % 64 == 0);
+    CHECK(h.stride() >= 33 * 3);
+    CHECK(h.bytes() == h.stride() * 7);
+
+    FramePool::Handle raw = pool.acquireBytes(100);
+    CHECK(raw);
+    CHECK(aligned(raw.data()));
+    CHECK(raw.bytes() >= 100);
+
+    CHECK(!pool.acquire(shape(0, 7, 4, 0)));
+    CHECK(!pool.acquire(shape(7, -1, 4, 0)));
+}
+
+void testRecycling() {
+    FramePool pool;
+    FramePool::Handle h = pool.acquire(shape(64, 64, 4, 1));
+    uint8_t *first = h.data();
+    h.reset();
+    CHECK(pool.cachedBytes() == 64 * 64 * 4);
+
+    // Same shape: the cached buffer comes back.
+    h = pool.acquire(shape(64, 64, 4, 1));
+    CHECK(h.data() == first);
+    CHECK(pool.cachedBytes() == 0);
+    h.reset();
+
+    // Another format tag never gets it.
+    FramePool::Handle other = pool.acquire(shape(64, 64, 4, 2));
+    CHECK(other.data() != first);
+    CHECK(pool.cachedBytes() == 64 * 64 * 4);
+
+    // Moving a handle moves ownership; the source is empty afterwards.
+    FramePool::Handle moved = std::move(other);
+    CHECK(moved);
+    CHECK(!other);
+}
+
+void testBudget() {
+    const size_t block = 64 * 64 * 4;
+    FramePool pool(2 * block);
+    FramePool::Handle a = pool.acquire(shape(64, 64, 4, 1));
+    FramePool::Handle b = pool.acquire(shape(64, 64, 4, 2));
+    FramePool::Handle c = pool.acquire(shape(64, 64, 4, 3));
+    a.reset();
+    b.reset();
+    c.reset();
+    // The least recently released one went.
+    CHECK(pool.cachedBytes() == 2 * block);
+    pool.trim();
+    CHECK(pool.cachedBytes() == 0);
+}
+
+// 2 MB and up is mapped; the whole mapping counts against the budget.
+void testMapped() {
+    FramePool pool;
+    FramePool::Handle h = pool.acquireBytes(size_t(3) << 20);
+    CHECK(h);
+    CHECK(aligned(h.data()));
+    std::memset(h.data(), 0x5a, h.bytes());
+    h.reset();
+    CHECK(pool.cachedBytes() >= size_t(3) << 20);
+    pool.trim();
+    CHECK(pool.cachedBytes() == 0);
+}
+
+// Threads cycling through more shapes than the budget holds, so release()
+// keeps evicting while others acquire.
+void testConcurrentEviction() {
+    FramePool pool(3 * 64 * 64 * 4);
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool, &failures, t] {
+            for (int i = 0; i < 2000; ++i) {
+                FramePool::Handle h =
+                    pool.acquire(shape(64, 64, 4, uint32_t((i + t) % 7)));
+                if (!h) {
+                    ++failures[t];
+                    continue;
+                }
+                h.data()[0] = uint8_t(i);
+            }
+        });
+    }
+    for (std::thread &t : threads)
+        t.join();
+    CHECK(failures == std::vector<int>(4, 0));
+    CHECK(pool.cachedBytes() <= 3 * 64 * 64 * 4);
+}
+
+} // namespace
+
+int main() {
+    testAlignment();
+    testRecycling();
+    testBudget();
+    testMapped();
+    testConcurrentEviction();
+    // Released only after main() returns.
+    g_parked.frame = FramePool::shared().acquire(shape(64, 64, 4, 9));
+    CHECK(g_parked.frame);
+    return checkResult();
+}
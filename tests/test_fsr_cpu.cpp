@@ -0,0 +1,222 @@
+// test_fsr_cpu.cpp
+// The SSE4.1 and AVX2 FSR builds against the scalar one, fused EASU+RCAS
+// tiles against two full-frame passes, and BGRA8 against RGBA8. Sets
+// OMNIFORGE_CPU_ISA=scalar first, so fsrEasu()/fsrRcas() are the reference.
+// Everything is bit-exact except AVX2 EASU, whose FMAs round differently:
+// that is allowed one step of an integer channel, or ~1/512 of a half.
+
+#include "check.h"
+#include "pipeline/fsr_cpu.h"
+#include "utils/frame_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#ifdef OMNIFORGE_HAVE_X86_SIMD
+void fsrEasuSse41(const FsrConstants &consts, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1,
+                  int ox, int oy);
+void fsrEasuAvx2(const FsrConstants &consts, const FrameView &input,
+                 const FrameView &output, int x0, int y0, int x1, int y1,
+                 int ox, int oy);
+void fsrRcasSse41(const FsrConstants &consts, const FrameView &input,
+                  const FrameView &output, int x0, int y0, int x1, int y1);
+void fsrRcasAvx2(const FsrConstants &consts, const FrameView &input,
+                 const FrameView &output, int x0, int y0, int x1, int y1);
+#endif
+
+namespace {
+
+// Rows padded past the pixels, so nothing relies on packed rows.
+struct Image {
+    std::vector<uint8_t> bytes;
+    FrameView view;
+
+    Image(int w, int h, PixelFormat format) {
+        const size_t stride = size_t(w) * pixelBytes(format) + 24;
+        bytes.assign(stride * size_t(h), 0);
+        view = {bytes.data(), w, h, stride, format};
+    }
+};
+
+// Noise over gradients, so both flat and edge-heavy areas are covered.
+// RGBA16F gets half floats in [0, 2), i.e. some past SDR white.
+void fill(const FrameView &v, uint32_t seed) {
+    std::mt19937 rng(seed);
+    for (int y = 0; y < v.height; ++y) {
+        uint8_t *row = v.data + size_t(y) * v.stride;
+        if (v.format == PixelFormat::RGBA16F) {
+            for (int i = 0; i < 4 * v.width; ++i) {
+                const uint16_t h = static_cast<uint16_t>(rng() & 0x3fff);
+                std::memcpy(row + 2 * i, &h, 2);
+            }
+            continue;
+        }
+        for (int x = 0; x < v.width; ++x) {
+            uint32_t px = static_cast<uint32_t>(rng());
+            if ((x / 8 + y / 8) % 2)
+                px = (px & 0x0f0f0f0fu) + uint32_t(x * 3 + y) * 0x00010101u;
+            std::memcpy(row + 4 * size_t(x), &px, 4);
+        }
+    }
+}
+
+bool same(const FrameView &a, const FrameView &b) {
+    const size_t bytes = size_t(a.width) * pixelBytes(a.format);
+    for (int y = 0; y < a.height; ++y) {
+        if (std::memcmp(a.data + size_t(y) * a.stride,
+                        b.data + size_t(y) * b.stride, bytes) != 0)
+            return false;
+    }
+    return true;
+}
+
+float halfToFloat(uint16_t h) {
+    const int exponent = h >> 10 & 0x1f;
+    const float mantissa = float(h & 0x3ff);
+    const float magnitude =
+        exponent ? std::ldexp(1024.0f + mantissa, exponent - 25)
+                 : std::ldexp(mantissa, -24);
+    return h & 0x8000 ? -magnitude : magnitude;
+}
+
+// Within rounding of each other, channel by channel.
+bool nearlySame(const FrameView &a, const FrameView &b) {
+    for (int y = 0; y < a.height; ++y) {
+        for (int x = 0; x < a.width; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                if (a.format == PixelFormat::RGBA16F) {
+                    uint16_t ha, hb;
+                    std::memcpy(&ha, a.data + y * a.stride + 8 * x + 2 * c, 2);
+                    std::memcpy(&hb, b.data + y * b.stride + 8 * x + 2 * c, 2);
+                    const float fa = halfToFloat(ha), fb = halfToFloat(hb);
+                    if (std::fabs(fa - fb) >
+                        std::max(1.0f, std::fabs(fa)) / 512.0f)
+                        return false;
+                    continue;
+                }
+                int va, vb;
+                if (a.format == PixelFormat::RGB10A2) {
+                    const uint32_t mask = c == 3 ? 0x3u : 0x3ffu;
+                    va = int(a.row(y)[x] >> (10 * c) & mask);
+                    vb = int(b.row(y)[x] >> (10 * c) & mask);
+                } else {
+                    va = a.data[y * a.stride + 4 * x + c];
+                    vb = b.data[y * b.stride + 4 * x + c];
+                }
+                if (std::abs(va - vb) > 1)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// EASU + RCAS through the fused tile path, over tiles of w x h.
+void fusedTiles(const FsrConstants &consts, const FrameView &in,
+                const FrameView &out, int w, int h) {
+    FramePool::Handle scratch = FramePool::shared().acquireBytes(
+        fsrFusedScratchBytes(w, h, out.format));
+    CHECK(scratch);
+    for (int y = 0; y < out.height; y += h) {
+        for (int x = 0; x < out.width; x += w)
+            fsrEasuRcasTile(consts, in, out, x, y, std::min(out.width, x + w),
+                            std::min(out.height, y + h), scratch.data());
+    }
+}
+
+void swapRedBlue(const FrameView &src, const FrameView &dst) {
+    for (int y = 0; y < src.height; ++y) {
+        for (int x = 0; x < src.width; ++x) {
+            const uint32_t p = src.row(y)[x];
+            dst.row(y)[x] = (p & 0xff00ff00u) | (p >> 16 & 0xffu) |
+                            (p & 0xffu) << 16;
+        }
+    }
+}
+
+struct Case {
+    int inW, inH;
+    int viewW, viewH;
+    int outW, outH;
+};
+
+const Case kCases[] = {
+    {64, 48, 64, 48, 128, 96},  // X2
+    {64, 48, 64, 48, 96, 72},   // X1_5
+    {40, 30, 40, 30, 120, 90},  // X3
+    {50, 37, 50, 37, 123, 81},  // any ratio
+    {64, 48, 48, 36, 128, 96},  // reduced viewport
+};
+
+const PixelFormat kFormats[] = {PixelFormat::RGBA8, PixelFormat::BGRA8,
+                                PixelFormat::RGB10A2, PixelFormat::RGBA16F};
+
+} // namespace
+
+int main() {
+    setenv("OMNIFORGE_CPU_ISA", "scalar", 1);
+#if defined(OMNIFORGE_HAVE_X86_SIMD) && defined(__GNUC__)
+    const bool sse41 = __builtin_cpu_supports("sse4.1");
+    const bool avx2 =
+        __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    const bool f16c = __builtin_cpu_supports("f16c");
+#endif
+
+    uint32_t seed = 1;
+    for (const Case &c : kCases) {
+        FsrConstants consts;
+        setupFSR(consts, c.viewW, c.viewH, c.inW, c.inH, c.outW, c.outH);
+        for (PixelFormat format : kFormats) {
+            Image in(c.inW, c.inH, format);
+            fill(in.view, seed++);
+            Image easu(c.outW, c.outH, format), rcas(c.outW, c.outH, format);
+            fsrEasu(consts, in.view, easu.view);
+            fsrRcas(consts, easu.view, rcas.view, 0, 0, c.outW, c.outH);
+
+            // Fused tiles, including ragged ones at the right and bottom.
+            Image fused(c.outW, c.outH, format);
+            fusedTiles(consts, in.view, fused.view, 32, 24);
+            CHECK(same(fused.view, rcas.view));
+            fusedTiles(consts, in.view, fused.view, 17, 11);
+            CHECK(same(fused.view, rcas.view));
+
+#if defined(OMNIFORGE_HAVE_X86_SIMD) && defined(__GNUC__)
+            Image simd(c.outW, c.outH, format);
+            if (sse41) {
+                fsrEasuSse41(consts, in.view, simd.view, 0, 0, c.outW,
+                             c.outH, 0, 0);
+                CHECK(same(simd.view, easu.view));
+                fsrRcasSse41(consts, easu.view, simd.view, 0, 0, c.outW,
+                             c.outH);
+                CHECK(same(simd.view, rcas.view));
+            }
+            if (avx2 && (f16c || format != PixelFormat::RGBA16F)) {
+                fsrEasuAvx2(consts, in.view, simd.view, 0, 0, c.outW,
+                            c.outH, 0, 0);
+                CHECK(nearlySame(simd.view, easu.view));
+                fsrRcasAvx2(consts, easu.view, simd.view, 0, 0, c.outW,
+                            c.outH);
+                CHECK(same(simd.view, rcas.view));
+            }
+#endif
+        }
+
+        // BGRA8 is RGBA8 with red and blue swapped, before and after.
+        Image rgba(c.inW, c.inH, PixelFormat::RGBA8);
+        Image bgra(c.inW, c.inH, PixelFormat::BGRA8);
+        fill(rgba.view, seed++);
+        swapRedBlue(rgba.view, bgra.view);
+        Image rgbaOut(c.outW, c.outH, PixelFormat::RGBA8);
+        Image bgraOut(c.outW, c.outH, PixelFormat::BGRA8);
+        Image swapped(c.outW, c.outH, PixelFormat::RGBA8);
+        fusedTiles(consts, rgba.view, rgbaOut.view, 32, 24);
+        fusedTiles(consts, bgra.view, bgraOut.view, 32, 24);
+        swapRedBlue(bgraOut.view, swapped.view);
+        CHECK(same(swapped.view, rgbaOut.view));
+    }
+    return checkResult();
+}
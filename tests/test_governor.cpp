@@ -0,0 +1,40 @@
+// test_governor.cpp
+// FrameGovernor: demotes when our own cost pushes frames over the target,
+// and leaves a game that is slow on its own at the best level.
+
+#include "check.h"
+#include "pipeline/governor.h"
+
+namespace {
+
+const double kTarget = 1000.0 / 60.0;
+
+// A game-bound title at 45 fps: our upscale costs next to nothing.
+void testGameBound() {
+    FrameGovernor governor(UpscaleMode::HYBRID, kTarget);
+    for (int frame = 0; frame < 2000; ++frame)
+        governor.onFrame(1000.0 / 45.0, 0.05);
+    CHECK(governor.level() == 0);
+    CHECK(governor.decision().mode == UpscaleMode::HYBRID);
+}
+
+// The game needs 14 ms; HYBRID adds 5 ms and FSR_ONLY 1 ms, so only the
+// cheaper level fits.
+void testPipelineBound() {
+    FrameGovernor governor(UpscaleMode::HYBRID, kTarget);
+    for (int frame = 0; frame < 200; ++frame) {
+        const double cost = governor.level() == 0 ? 5.0 : 1.0;
+        governor.onFrame(14.0 + cost, cost);
+    }
+    CHECK(governor.level() == 1);
+    CHECK(governor.decision().mode == UpscaleMode::FSR_ONLY);
+    CHECK(governor.decision().inputScale == 1.0f);
+}
+
+} // namespace
+
+int main() {
+    testGameBound();
+    testPipelineBound();
+    return checkResult();
+}
@@ -0,0 +1,130 @@
+// test_latency_queue.cpp
+// LatencyQueue: FIFO order, the three overflow policies, the exact
+// capacity bound, and several producers against one consumer without
+// losing or reordering items.
+
+#include "check.h"
+#include "utils/latency_queue.h"
+#include <thread>
+#include <vector>
+
+namespace {
+
+void testOrder() {
+    LatencyQueue<int> q(4);
+    for (int i = 1; i <= 4; ++i)
+        q.push(i);
+    CHECK(q.size() == 4);
+    int extra = 5;
+    CHECK(!q.try_push(extra));
+    for (int i = 1; i <= 4; ++i)
+        CHECK(q.pop() == i);
+    int v = 0;
+    CHECK(!q.try_pop(v));
+    CHECK(q.size() == 0);
+    CHECK(q.dropped() == 0);
+}
+
+void testDropOldest() {
+    LatencyQueue<int> q(4, OverflowPolicy::DropOldest);
+    for (int i = 1; i <= 6; ++i)
+        q.push(i);
+    CHECK(q.dropped() == 2);
+    for (int i = 3; i <= 6; ++i)
+        CHECK(q.pop() == i);
+    int v = 0;
+    CHECK(!q.try_pop(v));
+}
+
+void testLatestWins() {
+    LatencyQueue<int> q(4, OverflowPolicy::LatestWins);
+    for (int i = 1; i <= 5; ++i)
+        q.push(i);
+    CHECK(q.size() == 1);
+    CHECK(q.dropped() == 4);
+    CHECK(q.pop() == 5);
+    int v = 0;
+    CHECK(!q.try_pop(v));
+}
+
+// The bound is the requested capacity, not a power of two above it.
+void testCapacity() {
+    for (size_t capacity : {size_t(1), size_t(3), size_t(5)}) {
+        LatencyQueue<int> q(capacity);
+        CHECK(q.capacity() == capacity);
+        for (int round = 0; round < 3; ++round) {
+            size_t pushed = 0;
+            int v = 0;
+            while (q.try_push(v))
+                ++pushed;
+            CHECK(pushed == capacity);
+            while (q.try_pop(v))
+                --pushed;
+            CHECK(pushed == 0);
+        }
+    }
+    CHECK(LatencyQueue<int>(0).capacity() == 1);
+
+    LatencyQueue<int> one(1, OverflowPolicy::DropOldest);
+    one.push(1);
+    one.push(2);
+    CHECK(one.dropped() == 1);
+    CHECK(one.pop() == 2);
+}
+
+// A blocked push has to be woken by the consumer making room.
+void testBlockWakesProducer() {
+    LatencyQueue<int> q(2);
+    q.push(1);
+    q.push(2);
+    std::thread producer([&] { q.push(3); });
+    CHECK(q.pop() == 1);
+    producer.join();
+    CHECK(q.pop() == 2);
+    CHECK(q.pop() == 3);
+}
+
+// Every item arrives once, each producer's items arrive in order, and the
+// queue never holds more than its capacity.
+void testProducers(size_t capacity) {
+    constexpr int kProducers = 4;
+    constexpr int kItems = 20000;
+    LatencyQueue<int> q(capacity);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&q, p] {
+            for (int i = 0; i < kItems; ++i)
+                q.push(p * kItems + i);
+        });
+    }
+    std::vector<int> next(kProducers, 0);
+    bool ordered = true, bounded = true;
+    for (int n = 0; n < kProducers * kItems; ++n) {
+        bounded = bounded && q.size() <= capacity;
+        const int v = q.pop();
+        const int p = v / kItems;
+        ordered = ordered && v % kItems == next[p];
+        ++next[p];
+    }
+    for (std::thread &t : producers)
+        t.join();
+    CHECK(ordered);
+    CHECK(bounded);
+    for (int p = 0; p < kProducers; ++p)
+        CHECK(next[p] == kItems);
+    CHECK(q.size() == 0);
+}
+
+} // namespace
+
+int main() {
+    testOrder();
+    testDropOldest();
+    testLatestWins();
+    testCapacity();
+    testBlockWakesProducer();
+    testProducers(8);
+    testProducers(3);
+    testProducers(1);
+    return checkResult();
+}
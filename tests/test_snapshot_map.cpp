@@ -0,0 +1,109 @@
+// test_snapshot_map.cpp
+// SnapshotMap: insert/replace/erase, and that a removed value is handed
+// back only once no reader can still be inside it.
+
+#include "check.h"
+#include "utils/snapshot_map.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Value {
+    std::atomic<bool> alive{true};
+    int payload = 0;
+};
+
+std::unique_ptr<Value> makeValue(int payload) {
+    std::unique_ptr<Value> v(new Value());
+    v->payload = payload;
+    return v;
+}
+
+int lookup(const SnapshotMap<int, Value> &map, int key) {
+    int payload = -1;
+    map.with(key, [&](Value &v) { payload = v.payload; });
+    return payload;
+}
+
+void testBasics() {
+    SnapshotMap<int, Value> map;
+    CHECK(lookup(map, 1) == -1);
+    CHECK(!map.insert(1, makeValue(10)));
+    CHECK(!map.insert(2, makeValue(20)));
+    CHECK(map.size() == 2);
+    CHECK(lookup(map, 1) == 10);
+    CHECK(lookup(map, 2) == 20);
+
+    std::unique_ptr<Value> old = map.insert(1, makeValue(11));
+    CHECK(old && old->payload == 10);
+    CHECK(lookup(map, 1) == 11);
+
+    old = map.erase(2);
+    CHECK(old && old->payload == 20);
+    CHECK(!map.erase(2));
+    CHECK(lookup(map, 2) == -1);
+    CHECK(map.size() == 1);
+
+    // Enough keys to make the table grow a few times.
+    for (int k = 100; k < 300; ++k)
+        map.insert(k, makeValue(k));
+    bool found = true;
+    for (int k = 100; k < 300; ++k)
+        found = found && lookup(map, k) == k;
+    CHECK(found);
+    CHECK(lookup(map, 1) == 11);
+}
+
+// Readers hammer a few keys while a writer replaces and erases them and
+// marks each value dead as soon as the map hands it back. A reader that
+// ever sees a dead value was let into it after the grace period.
+void testGracePeriod() {
+    constexpr int kKeys = 4;
+    constexpr int kRounds = 2000;
+    SnapshotMap<int, Value> map;
+    for (int k = 0; k < kKeys; ++k)
+        map.insert(k, makeValue(k));
+
+    std::atomic<bool> done{false};
+    std::atomic<int> deadSeen{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&, r] {
+            for (int i = r; !done.load(std::memory_order_relaxed); ++i) {
+                map.with(i % kKeys, [&](Value &v) {
+                    for (int spin = 0; spin < 16; ++spin) {
+                        if (!v.alive.load(std::memory_order_relaxed))
+                            deadSeen.fetch_add(1);
+                    }
+                });
+            }
+        });
+    }
+
+    for (int round = 0; round < kRounds; ++round) {
+        const int key = round % kKeys;
+        std::unique_ptr<Value> old = round % 3 == 0
+                                         ? map.erase(key)
+                                         : map.insert(key, makeValue(round));
+        if (old)
+            old->alive.store(false, std::memory_order_relaxed);
+        if (round % 3 == 0)
+            map.insert(key, makeValue(round));
+    }
+    done = true;
+    for (std::thread &t : readers)
+        t.join();
+    CHECK(deadSeen.load() == 0);
+    CHECK(map.size() == kKeys);
+}
+
+} // namespace
+
+int main() {
+    testBasics();
+    testGracePeriod();
+    return checkResult();
+}
@@ -0,0 +1,113 @@
+// test_thread_pool.cpp
+// ThreadPool: every index runs once, and threads outside the pool that
+// call parallelFor() at the same time never share a slot() (and so never
+// share the per-slot scratch the pipeline keeps).
+
+#include "check.h"
+#include "pipeline/upscaler.h"
+#include "utils/thread_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void testCoverage(ThreadPool &pool) {
+    for (size_t count : {size_t(1), size_t(7), size_t(1000)}) {
+        std::vector<std::atomic<int>> hits(count);
+        pool.parallelFor(count, [&](size_t i) {
+            hits[i].fetch_add(1);
+            // Nested calls run too.
+            pool.parallelFor(3, [&](size_t) {});
+        });
+        bool once = true;
+        for (const std::atomic<int> &h : hits)
+            once = once && h.load() == 1;
+        CHECK(once);
+    }
+}
+
+// Each task marks its slot busy while it runs; finding it already busy
+// means two threads got the same slot.
+void testCallerSlots(ThreadPool &pool) {
+    std::unique_ptr<std::atomic<int>[]> busy(
+        new std::atomic<int>[pool.slots()]);
+    for (unsigned i = 0; i < pool.slots(); ++i)
+        busy[i] = 0;
+    std::atomic<int> shared{0}, outOfRange{0};
+    std::vector<std::thread> callers;
+    for (int t = 0; t < 3; ++t) {
+        callers.emplace_back([&] {
+            for (int round = 0; round < 300; ++round) {
+                pool.parallelFor(16, [&](size_t) {
+                    const unsigned s = pool.slot();
+                    if (s >= pool.slots()) {
+                        outOfRange.fetch_add(1);
+                        return;
+                    }
+                    if (busy[s].exchange(1))
+                        shared.fetch_add(1);
+                    for (volatile int spin = 0; spin < 5000; ++spin) {}
+                    busy[s] = 0;
+                });
+            }
+        });
+    }
+    for (std::thread &t : callers)
+        t.join();
+    CHECK(shared.load() == 0);
+    CHECK(outOfRange.load() == 0);
+}
+
+// The batch tool's pattern: one thread upscales while others run their
+// own parallelFor() on the same pool. Every frame must match one made
+// with the pool to itself.
+void testConcurrentFrames(ThreadPool &pool) {
+    const int w = 320, h = 180;
+    std::mt19937 rng(3);
+    std::vector<uint32_t> in(size_t(w) * h);
+    for (uint32_t &p : in)
+        p = rng();
+    const FrameView input{reinterpret_cast<uint8_t *>(in.data()), w, h,
+                          size_t(w) * 4};
+    std::vector<uint32_t> ref(size_t(4) * w * h), out(ref.size());
+    const FrameView refView{reinterpret_cast<uint8_t *>(ref.data()), 2 * w,
+                            2 * h, size_t(w) * 8};
+    const FrameView outView{reinterpret_cast<uint8_t *>(out.data()), 2 * w,
+                            2 * h, size_t(w) * 8};
+
+    UpscaleContext ctx(&pool);
+    ctx.setDirtyTracking(false);
+    CHECK(processFrame(ctx, input, refView, UpscaleMode::FSR_ONLY));
+
+    std::atomic<bool> done{false};
+    std::thread other([&] {
+        std::vector<uint32_t> junk(4096);
+        while (!done.load()) {
+            pool.parallelFor(junk.size(), [&](size_t i) {
+                junk[i] = uint32_t(i) * 2654435761u;
+            });
+        }
+    });
+    int differing = 0;
+    for (int frame = 0; frame < 100; ++frame) {
+        CHECK(processFrame(ctx, input, outView, UpscaleMode::FSR_ONLY));
+        differing += out != ref;
+    }
+    done = true;
+    other.join();
+    CHECK(differing == 0);
+}
+
+} // namespace
+
+int main() {
+    ThreadPool pool(4);
+    testCoverage(pool);
+    testCallerSlots(pool);
+    testConcurrentFrames(pool);
+    return checkResult();
+}